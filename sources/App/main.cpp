@@ -1,34 +1,85 @@
-#include "freefloatingapp.h"
-#include "huangapp.h"
-#include "vanekapp.h"
-
-std::vector<std::string> recipes = {
-	"FreeFloating",
-	"Huang",
-	"Vanek"
-};
-
-std::string ParseCLArgs(int argc, char** argv, std::vector<std::string>& recipes)
-{
-	if (argc < 2)
-		exit(EXIT_FAILURE);
-
-	std::string recipeName = argv[1];
-	auto it = std::find(recipes.begin(), recipes.end(), recipeName);
-	if (it == recipes.end())
-		exit(EXIT_FAILURE);
-
-	return recipeName;
-}
-
-int main(int argc, char* argv[])
-{
-	std::string recipe = ParseCLArgs(argc, argv, recipes);
-
-	if (recipe == "FreeFloating")
-		FreeFloatingApp::GetInstance().Run(argv[2]);
-	else if (recipe == "Huang")
-		HuangApp::GetInstance().Run(argv[2]);
-	else if (recipe == "Vanek")
-		VanekApp::GetInstance().Run(argv[2]);
+#include "freefloatingapp.h"
+#include "huangapp.h"
+#include "vanekapp.h"
+
+#include <params.h>
+#include <pipelinestage.h>
+
+std::vector<std::string> recipes = {
+	"FreeFloating",
+	"Huang",
+	"Vanek"
+};
+
+std::string ParseCLArgs(int argc, char** argv, std::vector<std::string>& recipes)
+{
+	if (argc < 3)
+		exit(EXIT_FAILURE);
+
+	std::string recipeName = argv[1];
+	auto it = std::find(recipes.begin(), recipes.end(), recipeName);
+	if (it == recipes.end())
+		exit(EXIT_FAILURE);
+
+	return recipeName;
+}
+
+void ParseOptions(int argc, char** argv, Params& params)
+{
+	for (int i = 3; i < argc; i++) {
+		std::string option = argv[i];
+		if (!ParseOption(option, params)) {
+			std::cerr << "Unknown option : " << option << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	PerfCounters::GetInstance().Enable(params.perfCounters);
+}
+
+int main(int argc, char* argv[])
+{
+	std::string recipe = ParseCLArgs(argc, argv, recipes);
+
+	Params params;
+	if (recipe == "FreeFloating")
+		params = FreeFloatingApp::DefaultParams();
+	else if (recipe == "Huang")
+		params = HuangApp::DefaultParams();
+	else if (recipe == "Vanek")
+		params = VanekApp::DefaultParams();
+	ParseOptions(argc, argv, params);
+	JobContext context(params);
+
+	StartPipelineStats();
+	Status status;
+	if (recipe == "FreeFloating") {
+		FreeFloatingApp app;
+		status = app.Run(context, argv[2]);
+	}
+	else if (recipe == "Huang") {
+		HuangApp app;
+		status = app.Run(context, argv[2]);
+	}
+	else if (recipe == "Vanek") {
+		VanekApp app;
+		status = app.Run(context, argv[2]);
+	}
+	if (!status.IsOk()) {
+		std::cerr << status.Message() << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	Profiler::GetInstance().PrintSummary(std::cout);
+	if (!params.tracePath.empty())
+		Profiler::GetInstance().WriteTrace(params.tracePath);
+	PerfCounters::GetInstance().PrintSummary(std::cout);
+
+	MemoryStats::GetInstance().PrintSummary(std::cout);
+	if (!params.memoryReportPath.empty())
+		MemoryStats::GetInstance().WriteReport(params.memoryReportPath);
+
+	Metrics::GetInstance().PrintSummary(std::cout);
+	if (!params.metricsPath.empty())
+		Metrics::GetInstance().WriteReport(params.metricsPath);
 }
\ No newline at end of file
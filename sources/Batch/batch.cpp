@@ -0,0 +1,71 @@
+#include "batchrunner.h"
+
+#include <params.h>
+#include <pipelinestage.h>
+#include <iostream>
+
+void ParseOptions(int argc, char** argv, BatchConfig& config)
+{
+	for (int i = 2; i < argc; i++) {
+		std::string option = argv[i];
+		std::string name, value;
+		SplitOption(option, name, value);
+
+		bool known = true;
+		if (name == "--recipe")
+			config.recipe = value;
+		else if (name == "--workers")
+			known = ParseNumber(value, config.workers);
+		else if (name == "--threads")
+			known = ParseNumber(value, config.threads);
+		else if (name == "--results")
+			config.resultsPath = value;
+		else
+			config.options.push_back(option);
+
+		if (!known) {
+			std::cerr << "Unknown option : " << option << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (config.workers < 1) {
+		std::cerr << "At least one worker is needed" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::cerr << "usage: batch <manifest|directory> [--recipe=name] "
+			"[--workers=n] [--threads=n] [--results=path] [recipe options]" <<
+			std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	BatchConfig config;
+	config.input = argv[1];
+	config.workers = 2;
+	config.threads = 0;
+	ParseOptions(argc, argv, config);
+
+	BatchRunner runner(config);
+	if (!runner.Load())
+		exit(EXIT_FAILURE);
+
+	// the stats cover the whole batch; stages of jobs on different workers
+	// overlap, so there is no per-stage memory report
+	const Params& params = runner.GlobalParams();
+	PerfCounters::GetInstance().Enable(params.perfCounters);
+	StartPipelineStats();
+
+	if (!runner.Run())
+		exit(EXIT_FAILURE);
+	runner.PrintSummary(std::cout);
+
+	if (!params.tracePath.empty())
+		Profiler::GetInstance().WriteTrace(params.tracePath);
+	if (!params.metricsPath.empty())
+		Metrics::GetInstance().WriteReport(params.metricsPath);
+}
\ No newline at end of file
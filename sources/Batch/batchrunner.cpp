@@ -0,0 +1,310 @@
+#include "batchrunner.h"
+#include "freefloatingapp.h"
+#include "huangapp.h"
+#include "vanekapp.h"
+
+#include <jobcontext.h>
+#include <workerpool.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <omp.h>
+namespace fs = std::filesystem;
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	double Seconds(Clock::time_point from, Clock::time_point to)
+	{
+		return std::chrono::duration<double>(to - from).count();
+	}
+
+	bool RecipeDefaults(const std::string& recipe, Params& params)
+	{
+		if (recipe == "FreeFloating")
+			params = FreeFloatingApp::DefaultParams();
+		else if (recipe == "Huang")
+			params = HuangApp::DefaultParams();
+		else if (recipe == "Vanek")
+			params = VanekApp::DefaultParams();
+		else
+			return false;
+		return true;
+	}
+
+	void WriteEscaped(std::ostream& out, const std::string& s)
+	{
+		for (char c : s) {
+			if (c == '"' || c == '\\')
+				out << '\\';
+			out << c;
+		}
+	}
+
+	bool IsMesh(const fs::path& path)
+	{
+		std::string ext = path.extension().string();
+		std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+		return ext == ".stl" || ext == ".ply" || ext == ".obj" || ext == ".off";
+	}
+}
+
+BatchRunner::BatchRunner(const BatchConfig& config_)
+	: config(config_), wallSeconds(0)
+{
+}
+
+BatchRunner::~BatchRunner()
+{
+}
+
+bool BatchRunner::Load()
+{
+	for (const std::string& option : config.options) {
+		if (!ParseOption(option, global)) {
+			std::cerr << "Unknown option : " << option << std::endl;
+			return false;
+		}
+	}
+
+	std::error_code error;
+	bool loaded = fs::is_directory(config.input, error) ?
+		LoadDirectory(config.input) : LoadManifest(config.input);
+	if (!loaded)
+		return false;
+	if (jobs.empty()) {
+		std::cerr << "No jobs in " << config.input << std::endl;
+		return false;
+	}
+
+	std::stable_sort(jobs.begin(), jobs.end(),
+		[](const BatchJob& a, const BatchJob& b) {
+			return a.bytes > b.bytes;
+		});
+	return true;
+}
+
+bool BatchRunner::LoadManifest(const std::string& path)
+{
+	std::ifstream in(path);
+	if (!in) {
+		std::cerr << "Unable to open manifest " << path << std::endl;
+		return false;
+	}
+
+	fs::path base = fs::path(path).parent_path();
+	std::string line;
+	for (int lineNo = 1; std::getline(in, line); lineNo++) {
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		size_t first = line.find_first_not_of(" \t");
+		if (first == std::string::npos || line[first] == '#')
+			continue;
+
+		std::stringstream stream(line);
+		std::string mesh, recipe, option;
+		std::vector<std::string> options;
+		stream >> std::quoted(mesh) >> recipe;
+		while (stream >> option)
+			options.push_back(option);
+
+		std::stringstream origin;
+		origin << path << ":" << lineNo;
+		if (recipe.empty()) {
+			std::cerr << origin.str() << " : expected a mesh and a recipe" <<
+				std::endl;
+			return false;
+		}
+
+		fs::path meshPath(mesh);
+		if (meshPath.is_relative())
+			meshPath = base / meshPath;
+		if (!AddJob(meshPath.string(), recipe, options, origin.str()))
+			return false;
+	}
+	return true;
+}
+
+bool BatchRunner::LoadDirectory(const std::string& path)
+{
+	if (config.recipe.empty()) {
+		std::cerr << "A directory needs --recipe" << std::endl;
+		return false;
+	}
+
+	std::vector<std::string> meshes;
+	for (const fs::directory_entry& entry : fs::directory_iterator(path)) {
+		if (entry.is_regular_file() && IsMesh(entry.path()))
+			meshes.push_back(entry.path().string());
+	}
+	std::sort(meshes.begin(), meshes.end());
+
+	for (const std::string& mesh : meshes) {
+		if (!AddJob(mesh, config.recipe, std::vector<std::string>(), path))
+			return false;
+	}
+	return true;
+}
+
+bool BatchRunner::AddJob(const std::string& mesh, const std::string& recipe,
+	const std::vector<std::string>& options, const std::string& origin)
+{
+	BatchJob job;
+	job.mesh = mesh;
+	job.recipe = recipe;
+	if (!RecipeDefaults(recipe, job.params)) {
+		std::cerr << origin << " : unknown recipe " << recipe << std::endl;
+		return false;
+	}
+
+	for (const std::string& option : config.options)
+		ParseOption(option, job.params);
+	for (const std::string& option : options) {
+		if (!ParseOption(option, job.params)) {
+			std::cerr << origin << " : unknown option " << option << std::endl;
+			return false;
+		}
+	}
+
+	std::error_code error;
+	job.bytes = fs::file_size(mesh, error);
+	if (error) {
+		std::cerr << origin << " : unable to open " << mesh << std::endl;
+		return false;
+	}
+
+	jobs.push_back(job);
+	return true;
+}
+
+bool BatchRunner::Run()
+{
+	int nWorkers = std::max(1, std::min<int>(config.workers, jobs.size()));
+	if (config.threads <= 0)
+		config.threads = std::max(1, omp_get_max_threads() / nWorkers);
+
+	// the GLFW fallback can only create windows on the main thread, so
+	// every context is set up here; the workers only make them current
+	auto uses = [this](const std::string& recipe) {
+		return std::any_of(jobs.begin(), jobs.end(),
+			[&](const BatchJob& job) { return job.recipe == recipe; });
+	};
+	setupPool.reset(new WorkerPool(std::max(2, nWorkers)));
+	workers.resize(nWorkers);
+	Status status;
+	for (Worker& worker : workers) {
+		if (uses("FreeFloating") && status.IsOk()) {
+			worker.freeFloating.reset(new FreeFloatingApp(setupPool.get()));
+			status = worker.freeFloating->Prepare();
+		}
+		if (uses("Huang") && status.IsOk()) {
+			worker.huang.reset(new HuangApp(setupPool.get()));
+			status = worker.huang->Prepare();
+		}
+		if (uses("Vanek"))
+			worker.vanek.reset(new VanekApp);
+	}
+	if (!status.IsOk()) {
+		std::cerr << status.Message() << std::endl;
+		return false;
+	}
+
+	if (!config.resultsPath.empty()) {
+		results.open(config.resultsPath);
+		if (!results)
+			std::cerr << "Unable to write batch results to " <<
+				config.resultsPath << std::endl;
+	}
+
+	Clock::time_point start = Clock::now();
+	{
+		WorkerPool pool(nWorkers);
+		for (size_t i = 0; i < jobs.size(); i++) {
+			pool.Submit([this, i, start](int worker) {
+				Record record;
+				record.job = i;
+				record.worker = worker;
+				Clock::time_point begin = Clock::now();
+				record.status = RunJob(worker, i);
+				record.start = Seconds(start, begin);
+				record.seconds = Seconds(begin, Clock::now());
+				Finish(record);
+				});
+		}
+		pool.Wait();
+	}
+	wallSeconds = Seconds(start, Clock::now());
+	return true;
+}
+
+Status BatchRunner::RunJob(int worker, size_t i)
+{
+	// the OpenMP thread count is a per-thread setting
+	omp_set_num_threads(config.threads);
+
+	const BatchJob& job = jobs[i];
+	JobContext context(job.params);
+	Worker& apps = workers[worker];
+	if (job.recipe == "FreeFloating")
+		return apps.freeFloating->Run(context, job.mesh);
+	else if (job.recipe == "Huang")
+		return apps.huang->Run(context, job.mesh);
+	return apps.vanek->Run(context, job.mesh);
+}
+
+void BatchRunner::Finish(const Record& record)
+{
+	const BatchJob& job = jobs[record.job];
+
+	std::lock_guard<std::mutex> lock(recordMutex);
+	records.push_back(record);
+
+	std::cout << "[" << records.size() << "/" << jobs.size() << "] " <<
+		job.recipe << " " << job.mesh << " " << std::fixed <<
+		std::setprecision(2) << record.seconds << " s on worker " <<
+		record.worker << std::defaultfloat << std::endl;
+	if (!record.status.IsOk())
+		std::cout << "  failed : " << record.status.Message() << std::endl;
+
+	if (results) {
+		results << "{\"mesh\":\"";
+		WriteEscaped(results, job.mesh);
+		results << "\",\"recipe\":\"" << job.recipe <<
+			"\",\"worker\":" << record.worker <<
+			",\"start_s\":" << record.start <<
+			",\"seconds\":" << record.seconds;
+		if (record.status.IsOk())
+			results << ",\"status\":\"ok\"}" << std::endl;
+		else {
+			results << ",\"status\":\"error\",\"message\":\"";
+			WriteEscaped(results, record.status.Message());
+			results << "\"}" << std::endl;
+		}
+	}
+}
+
+void BatchRunner::PrintSummary(std::ostream& out) const
+{
+	double busy = 0;
+	size_t failed = 0;
+	for (const Record& r : records) {
+		busy += r.seconds;
+		if (!r.status.IsOk())
+			failed++;
+	}
+
+	out << records.size() << " jobs on " << workers.size() << " workers x " <<
+		config.threads << " threads in " << std::fixed << std::setprecision(2) <<
+		wallSeconds << " s, " << std::setprecision(1) <<
+		(wallSeconds > 0 ? records.size() * 3600.0 / wallSeconds : 0) <<
+		" jobs/h, workers busy " <<
+		(wallSeconds > 0 ? busy * 100 / (wallSeconds * workers.size()) : 0) <<
+		"%" << std::defaultfloat << std::endl;
+	if (failed)
+		out << failed << " jobs failed" << std::endl;
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <ostream>
+#include <cstdint>
+#include <params.h>
+#include <status.h>
+
+class FreeFloatingApp;
+class HuangApp;
+class VanekApp;
+class WorkerPool;
+
+struct BatchConfig {
+	// manifest file, or a directory whose meshes all run with recipe
+	std::string input;
+	std::string recipe;
+	// applied to every job before the job's own options
+	std::vector<std::string> options;
+
+	int workers;
+	// OpenMP threads of each worker, zero splits the cores between them
+	int threads;
+
+	// one JSON record per finished job
+	std::string resultsPath;
+};
+
+struct BatchJob {
+	std::string mesh;
+	std::string recipe;
+	Params params;
+	// file size, the largest parts are started first
+	uintmax_t bytes;
+};
+
+// Runs many meshes in one process. Every worker owns warm app instances,
+// and with them GL contexts and compiled programs, for the recipes in the
+// manifest; the jobs are spread over the workers of a WorkerPool, so the
+// CPU stages of different parts overlap.
+//
+// A manifest has one job per line: the mesh path, relative to the
+// manifest, the recipe and any options of the recipe command line.
+// Paths with spaces are quoted and lines starting with # are skipped.
+class BatchRunner
+{
+public:
+	struct Record {
+		size_t job;
+		int worker;
+		double start, seconds;
+		Status status;
+	};
+
+	BatchRunner(const BatchConfig& config_);
+	~BatchRunner();
+
+	// reads the input and checks every recipe and option before any job
+	// starts; returns false on the first problem
+	bool Load();
+	// false if the apps cannot be set up; failed jobs do not count
+	bool Run();
+
+	// failed jobs are reported and counted, the batch goes on
+	void PrintSummary(std::ostream&) const;
+
+	// report paths and counters from the batch command line
+	const Params& GlobalParams() const {
+		return global;
+	}
+
+private:
+	struct Worker {
+		std::unique_ptr<FreeFloatingApp> freeFloating;
+		std::unique_ptr<HuangApp> huang;
+		std::unique_ptr<VanekApp> vanek;
+	};
+
+	bool LoadManifest(const std::string& path);
+	bool LoadDirectory(const std::string& path);
+	bool AddJob(const std::string& mesh, const std::string& recipe,
+		const std::vector<std::string>& options, const std::string& origin);
+
+	Status RunJob(int worker, size_t job);
+	void Finish(const Record&);
+
+private:
+	BatchConfig config;
+	Params global;
+	std::vector<BatchJob> jobs;
+	// reads the meshes and shaders of the apps of all workers
+	std::unique_ptr<WorkerPool> setupPool;
+	std::vector<Worker> workers;
+
+	std::mutex recordMutex;
+	std::ofstream results;
+	std::vector<Record> records;
+	double wallSeconds;
+};
@@ -0,0 +1,77 @@
+#include "benchmark.h"
+
+#include <params.h>
+#include <iostream>
+
+void ParseOptions(int argc, char** argv, BenchConfig& config)
+{
+	for (int i = 1; i < argc; i++) {
+		std::string option = argv[i];
+		std::string name, value;
+		SplitOption(option, name, value);
+
+		bool known = true;
+		if (name == "--recipes")
+			config.recipes = SplitList(value);
+		else if (name == "--shapes")
+			config.shapes = SplitList(value);
+		else if (name == "--dpi")
+			known = ParseList(value, config.dpis);
+		else if (name == "--scales")
+			known = ParseList(value, config.scales);
+		else if (name == "--triangles")
+			known = ParseList(value, config.triangles);
+		else if (name == "--layers")
+			known = ParseNumber(value, config.layers);
+		else if (name == "--footprint")
+			known = ParseNumber(value, config.footprint);
+		else if (name == "--warmup")
+			known = ParseNumber(value, config.warmup);
+		else if (name == "--reps")
+			known = ParseNumber(value, config.reps);
+		else if (name == "--seed")
+			known = ParseNumber(value, config.seed);
+		else if (name == "--csv")
+			config.csvPath = value;
+		else if (name == "--json")
+			config.jsonPath = value;
+		else
+			known = false;
+
+		if (!known) {
+			std::cerr << "Unknown option : " << option << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (config.reps < 1) {
+		std::cerr << "At least one repetition is needed" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	BenchConfig config;
+	config.recipes = { "FreeFloating", "Huang", "Vanek" };
+	config.shapes = { "sphere", "torus", "plates", "lattice", "shells" };
+	config.dpis = { 300, 600 };
+	config.scales = { 0.5f, 1.0f };
+	config.triangles = { 20000 };
+	config.layers = 3;
+	config.footprint = 40.0f;
+	config.warmup = 1;
+	config.reps = 3;
+	config.seed = 1;
+	ParseOptions(argc, argv, config);
+
+	Benchmark benchmark(config);
+	benchmark.Run();
+
+	if (!config.csvPath.empty())
+		benchmark.WriteCSV(config.csvPath);
+	if (!config.jsonPath.empty())
+		benchmark.WriteJSON(config.jsonPath);
+	if (config.csvPath.empty() && config.jsonPath.empty())
+		benchmark.WriteCSV("bench.csv");
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "benchmark.h"
+#include "meshgen.h"
+#include "freefloatingapp.h"
+#include "huangapp.h"
+#include "vanekapp.h"
+
+#include <jobcontext.h>
+#include <pipelinestage.h>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+Benchmark::Benchmark(const BenchConfig& config_)
+	: config(config_), setupPool(2)
+{
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+void Benchmark::Run()
+{
+	for (const std::string& recipe : config.recipes) {
+		for (const std::string& shape : config.shapes) {
+			for (int triangles : config.triangles) {
+				for (float scale : config.scales) {
+					for (int dpi : config.dpis)
+						RunCase(recipe, shape, triangles,
+							config.footprint * scale, dpi);
+				}
+			}
+		}
+	}
+}
+
+bool Benchmark::RunCase(const std::string& recipe, const std::string& shape,
+	int triangles, float footprint, int dpi)
+{
+	std::cout << recipe << " " << shape << " " << triangles << " tris " <<
+		footprint << " mm " << dpi << " dpi" << std::endl;
+
+	std::map<std::string, std::vector<double>> times;
+	for (int rep = 0; rep < config.warmup + config.reps; rep++) {
+		StartPipelineStats();
+		Status status = RunRecipe(recipe, shape, triangles, footprint, dpi);
+		if (!status.IsOk()) {
+			std::cout << "  skipped, " << status.Message() << std::endl;
+			return false;
+		}
+		if (rep >= config.warmup)
+			Accumulate(times);
+	}
+
+	for (auto& entry : times) {
+		std::vector<double>& t = entry.second;
+		std::sort(t.begin(), t.end());
+
+		Result result;
+		result.recipe = recipe;
+		result.shape = shape;
+		result.triangles = triangles;
+		result.footprint = footprint;
+		result.dpi = dpi;
+		result.stage = entry.first;
+		result.median = t.size() % 2 ? t[t.size() / 2] :
+			(t[t.size() / 2 - 1] + t[t.size() / 2]) / 2;
+		result.min = t.front();
+		result.max = t.back();
+		result.reps = t.size();
+		results.push_back(result);
+	}
+
+	return true;
+}
+
+Status Benchmark::RunRecipe(const std::string& recipe, const std::string& shape,
+	int triangles, float footprint, int dpi)
+{
+	ShapeSpec spec = { shape, triangles, footprint, config.layers, config.seed };
+	std::unique_ptr<Model3D> model3D = MeshGenerator::CreateModel(spec);
+
+	// checked up front so a case too big for the FBO costs no run
+	Status tooBig(Status::MODEL_TOO_BIG, "the images exceed maxFBOSize");
+	if (recipe == "FreeFloating") {
+		Params params = FreeFloatingApp::DefaultParams();
+		if (!SetResolution(params, dpi, footprint))
+			return tooBig;
+		if (!freeFloating)
+			freeFloating.reset(new FreeFloatingApp(&setupPool));
+		return freeFloating->Run(JobContext(params), std::move(model3D));
+	}
+	else if (recipe == "Huang") {
+		Params params = HuangApp::DefaultParams();
+		if (!SetResolution(params, dpi, footprint))
+			return tooBig;
+		if (!huang)
+			huang.reset(new HuangApp(&setupPool));
+		return huang->Run(JobContext(params), std::move(model3D));
+	}
+	else if (recipe == "Vanek") {
+		Params params = VanekApp::DefaultParams();
+		if (!SetResolution(params, dpi, footprint))
+			return tooBig;
+		if (!vanek)
+			vanek.reset(new VanekApp);
+		return vanek->Run(JobContext(params), std::move(model3D));
+	}
+
+	std::cerr << "Unknown recipe : " << recipe << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+bool Benchmark::SetResolution(Params& params, int dpi, float footprint)
+{
+	params.dpi = dpi;
+	params.pixelWidth = 25.4 / params.dpi;
+
+	// the recipes fail on images larger than maxFBOSize, the slicers add
+	// a margin of ten pixels around the model
+	return footprint / params.pixelWidth + 10 <= params.maxFBOSize;
+}
+
+void Benchmark::Accumulate(std::map<std::string, std::vector<double>>& times)
+{
+	// a zone entered several times in one run, e.g. once per layer block,
+	// counts with its total
+	std::vector<Profiler::Event> events;
+	Profiler::GetInstance().Collect(events);
+
+	std::map<std::string, double> run;
+	for (const Profiler::Event& e : events)
+		run[e.name] += (e.end - e.start) * 1e-6;
+
+	for (auto& entry : run)
+		times[entry.first].push_back(entry.second);
+}
+
+bool Benchmark::WriteCSV(const std::string& path) const
+{
+	std::ofstream out(path);
+	if (!out) {
+		std::cerr << "Unable to write benchmark results to " <<
+			path << std::endl;
+		return false;
+	}
+
+	out << "recipe,shape,triangles,footprint_mm,dpi,stage,"
+		"median_ms,min_ms,max_ms,reps\n";
+	for (const Result& r : results) {
+		out << r.recipe << "," << r.shape << "," << r.triangles << "," <<
+			r.footprint << "," << r.dpi << ",\"" << r.stage << "\"," <<
+			r.median << "," << r.min << "," << r.max << "," <<
+			r.reps << "\n";
+	}
+
+	return true;
+}
+
+bool Benchmark::WriteJSON(const std::string& path) const
+{
+	std::ofstream out(path);
+	if (!out) {
+		std::cerr << "Unable to write benchmark results to " <<
+			path << std::endl;
+		return false;
+	}
+
+	out << "[\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+		out << "{\"recipe\":\"" << r.recipe << "\",\"shape\":\"" << r.shape <<
+			"\",\"triangles\":" << r.triangles <<
+			",\"footprint_mm\":" << r.footprint << ",\"dpi\":" << r.dpi <<
+			",\"stage\":\"" << r.stage << "\",\"median_ms\":" << r.median <<
+			",\"min_ms\":" << r.min << ",\"max_ms\":" << r.max <<
+			",\"reps\":" << r.reps << "}" <<
+			(i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "]\n";
+
+	return true;
+}
\ No newline at end of file
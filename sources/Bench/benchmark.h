@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <status.h>
+#include <workerpool.h>
+
+struct Params;
+class FreeFloatingApp;
+class HuangApp;
+class VanekApp;
+
+struct BenchConfig {
+	std::vector<std::string> recipes;
+	std::vector<std::string> shapes;
+	std::vector<int> dpis;
+	// multiplies the footprint
+	std::vector<float> scales;
+	std::vector<int> triangles;
+	int layers;
+	float footprint;
+	int warmup;
+	int reps;
+	unsigned seed;
+
+	std::string csvPath;
+	std::string jsonPath;
+};
+
+// End-to-end scaling runs of the recipes on generated meshes. Every case
+// runs the whole pipeline in-process and reports the wall time of each
+// profiler zone over the measured repetitions.
+class Benchmark
+{
+public:
+	struct Result {
+		std::string recipe, shape;
+		int triangles;
+		float footprint;
+		int dpi;
+		std::string stage;
+		double median, min, max;
+		int reps;
+	};
+
+	Benchmark(const BenchConfig& config_);
+	~Benchmark();
+
+	void Run();
+
+	bool WriteCSV(const std::string& path) const;
+	bool WriteJSON(const std::string& path) const;
+
+private:
+	bool RunCase(const std::string& recipe, const std::string& shape,
+		int triangles, float footprint, int dpi);
+	Status RunRecipe(const std::string& recipe, const std::string& shape,
+		int triangles, float footprint, int dpi);
+	bool SetResolution(Params&, int dpi, float footprint);
+	void Accumulate(std::map<std::string, std::vector<double>>& times);
+
+private:
+	BenchConfig config;
+	std::vector<Result> results;
+
+	// created on first use and kept for the following cases, so only the
+	// first run of a recipe pays for its context and shaders; they share
+	// one setup pool
+	WorkerPool setupPool;
+	std::unique_ptr<FreeFloatingApp> freeFloating;
+	std::unique_ptr<HuangApp> huang;
+	std::unique_ptr<VanekApp> vanek;
+};
@@ -0,0 +1,397 @@
+#include "kernelbench.h"
+#include "meshgen.h"
+#include "freefloatingapp.h"
+#include "supportpoint.h"
+#include "zldni.h"
+#include "huangapp.h"
+#include "anchormap.h"
+#include "binaryimages.h"
+#include "vanekapp.h"
+#include "overhang.h"
+
+#include <jobcontext.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <regex>
+#include <map>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <omp.h>
+#include <pthread.h>
+#include <sched.h>
+using glm::vec3;
+using cv::Mat;
+
+namespace
+{
+	std::unique_ptr<Model3D> GenerateModel(const KernelConfig& config)
+	{
+		ShapeSpec spec = { config.shape, config.triangles, config.footprint,
+			config.layers, config.seed };
+		return MeshGenerator::CreateModel(spec);
+	}
+
+	// union of random disks, radii in pixels
+	Mat RandomDisks(std::mt19937& rng, int rows, int cols, int count,
+		float minRadius, float maxRadius)
+	{
+		std::uniform_real_distribution<float> x(0, cols), y(0, rows);
+		std::uniform_real_distribution<float> r(minRadius, maxRadius);
+
+		Mat mask = Mat::zeros(rows, cols, CV_8UC1);
+		for (int i = 0; i < count; i++) {
+			cv::Point center(x(rng), y(rng));
+			cv::circle(mask, center, (int)r(rng), cv::Scalar(255), cv::FILLED);
+		}
+		return mask;
+	}
+}
+
+void KernelBench::Run()
+{
+	PinThreads();
+
+	ContextScope current(gl);
+	FreeFloatingKernels();
+	HuangKernels();
+	VanekKernels();
+}
+
+bool KernelBench::Enabled(const std::string& kernel) const
+{
+	return config.kernels.empty() ||
+		std::find(config.kernels.begin(), config.kernels.end(), kernel) !=
+		config.kernels.end();
+}
+
+void KernelBench::PinThreads()
+{
+	if (config.threads > 0)
+		omp_set_num_threads(config.threads);
+
+	cpu_set_t available;
+	CPU_ZERO(&available);
+	if (sched_getaffinity(0, sizeof(available), &available) != 0)
+		return;
+	std::vector<int> cpus;
+	for (int c = 0; c < CPU_SETSIZE; c++) {
+		if (CPU_ISSET(c, &available))
+			cpus.push_back(c);
+	}
+	if (cpus.empty())
+		return;
+
+	// the OpenMP runtime keeps its pool alive between regions of the same
+	// size, so pinning the workers once holds for every kernel
+#pragma omp parallel
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpus[omp_get_thread_num() % cpus.size()], &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+
+	std::cout << "pinned " << omp_get_max_threads() << " threads to " <<
+		cpus.size() << " cpus" << std::endl;
+}
+
+void KernelBench::Measure(const std::string& kernel,
+	std::function<void()> setup, std::function<long long()> kernelFn)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	std::vector<double> seconds;
+	long long items = 0;
+	for (int rep = 0; rep < config.reps; rep++) {
+		setup();
+		Clock::time_point start = Clock::now();
+		items = kernelFn();
+		seconds.push_back(std::chrono::duration<double>(
+			Clock::now() - start).count());
+	}
+	std::sort(seconds.begin(), seconds.end());
+
+	Result result;
+	result.kernel = kernel;
+	result.items = items;
+	result.seconds = seconds[seconds.size() / 2];
+	result.itemsPerSecond = result.seconds > 0 ? items / result.seconds : 0;
+	results.push_back(result);
+
+	std::cout << std::left << std::setw(28) << kernel << std::right <<
+		std::setw(12) << items << " items " << std::fixed <<
+		std::setprecision(3) << std::setw(10) << result.seconds * 1e3 <<
+		" ms " << std::scientific << std::setprecision(3) <<
+		result.itemsPerSecond << " items/s" << std::defaultfloat << std::endl;
+}
+
+void KernelBench::FreeFloatingKernels()
+{
+	if (!Enabled("zldni sorted list") && !Enabled("graph edges") &&
+		!Enabled("bounded dijkstra") && !Enabled("column dijkstra"))
+		return;
+
+	JobContext context(FreeFloatingApp::DefaultParams());
+	std::unique_ptr<Model3D> model3D = GenerateModel(config);
+	zLDNIGenerator generator(context, model3D.get());
+	if (!generator.GetStatus().IsOk()) {
+		std::cerr << generator.GetStatus().Message() << std::endl;
+		return;
+	}
+	int cols, rows;
+	generator.GetImageSize(cols, rows);
+
+	if (Enabled("zldni sorted list")) {
+		std::vector<vec3> nodes;
+		Measure("zldni sorted list", [] {}, [&] {
+			long long count = 0;
+			for (int i = 0; i < rows; i++) {
+				for (int j = 0; j < cols; j++) {
+					nodes.clear();
+					generator.GetSortedList(nodes, i, j);
+					count += nodes.size();
+				}
+			}
+			return count;
+			});
+	}
+
+	std::unique_ptr<SupportPointFinder> finder;
+	if (Enabled("graph edges")) {
+		Measure("graph edges", [&] {
+			finder.reset(new SupportPointFinder(context));
+			finder->ReadIntersections(generator);
+			}, [&] {
+				finder->ConnectIntersections();
+				return (long long)boost::num_edges(finder->g);
+			});
+	}
+
+	if (Enabled("bounded dijkstra")) {
+		Measure("bounded dijkstra", [&] {
+			finder.reset(new SupportPointFinder(context));
+			finder->ReadIntersections(generator);
+			finder->ConnectIntersections();
+			}, [&] {
+				finder->FindSupportPoints();
+				return (long long)boost::num_vertices(finder->g);
+			});
+	}
+
+	if (Enabled("column dijkstra")) {
+		Params params = context.params;
+		params.graphEngine = GraphEngineType::COLUMN;
+		JobContext columnContext(params);
+		Measure("column dijkstra", [&] {
+			finder.reset(new SupportPointFinder(columnContext));
+			finder->ReadIntersections(generator);
+			finder->ConnectIntersections();
+			}, [&] {
+				finder->FindSupportPoints();
+				return (long long)boost::num_vertices(finder->g);
+			});
+	}
+}
+
+void KernelBench::HuangKernels()
+{
+	if (!Enabled("ldni slice") && !Enabled("ldni sort") &&
+		!Enabled("growing swallow") && !Enabled("frontier swallow") &&
+		!Enabled("anchor map"))
+		return;
+
+	JobContext context(HuangApp::DefaultParams());
+	const Params& params = context.params;
+
+	if (Enabled("ldni slice") || Enabled("ldni sort")) {
+		std::unique_ptr<Model3D> model3D = GenerateModel(config);
+		BinaryImageSampler sampler(context, model3D.get());
+		if (!sampler.GetStatus().IsOk()) {
+			std::cerr << sampler.GetStatus().Message() << std::endl;
+			return;
+		}
+		long long pixels = (long long)sampler.width * sampler.height;
+
+		if (Enabled("ldni slice")) {
+			float sizeZ = model3D->aabb.GetSize().z;
+			std::vector<float> heights;
+			for (float h = params.sliceThickness / 2; h < sizeZ;
+				h += params.sliceThickness)
+				heights.push_back(h - sizeZ / 2);
+
+			Measure("ldni slice", [] {}, [&] {
+				for (float h : heights)
+					sampler.Slice(h);
+				return pixels * (long long)heights.size();
+				});
+		}
+
+		if (Enabled("ldni sort")) {
+			// Sort works in place, so every repetition starts from the
+			// layers as they were read back
+			std::vector<Mat> layers;
+			for (const Mat& layer : sampler.ldni)
+				layers.push_back(layer.clone());
+
+			Measure("ldni sort", [&] {
+				for (int k = 0; k < layers.size(); k++)
+					layers[k].copyTo(sampler.ldni[k]);
+				}, [&] {
+					sampler.Sort();
+					return pixels;
+				});
+		}
+	}
+
+	int cols = round(config.footprint / params.pixelWidth);
+	int rows = cols;
+	float radius = params.effectiveRadius / params.pixelWidth;
+	std::mt19937 rng(config.seed);
+	AnchorMapGenerator generator(context);
+
+	if (Enabled("growing swallow") || Enabled("frontier swallow")) {
+		Mat currentPart = RandomDisks(rng, rows, cols, 16, radius * 0.5f, radius * 2);
+		Mat upperPart = generator.Union(currentPart,
+			RandomDisks(rng, rows, cols, 16, radius * 0.2f, radius));
+		Mat shadow = generator.Subtract(upperPart, currentPart);
+		AnchorMapGenerator* swallower = &generator;
+		auto swallow = [&] {
+			swallower->GrowingSwallow(shadow, currentPart, upperPart,
+				params.selfSupportThres);
+			return (long long)rows * cols;
+		};
+
+		if (Enabled("growing swallow"))
+			Measure("growing swallow", [] {}, swallow);
+		if (Enabled("frontier swallow")) {
+			Params frontierParams = params;
+			frontierParams.swallowEngine = SwallowEngineType::FRONTIER;
+			JobContext frontierContext(frontierParams);
+			AnchorMapGenerator frontier(frontierContext);
+			swallower = &frontier;
+			Measure("frontier swallow", [] {}, swallow);
+		}
+	}
+
+	if (Enabled("anchor map")) {
+		Mat supportRegion = RandomDisks(rng, rows, cols, 16, radius * 0.2f, radius);
+
+		Measure("anchor map", [] {}, [&] {
+			generator.GenAnchorMap(supportRegion, params.effectiveRadius);
+			return (long long)rows * cols;
+			});
+	}
+}
+
+void KernelBench::VanekKernels()
+{
+	if (!Enabled("point overhangs") && !Enabled("edge overhangs") &&
+		!Enabled("face overhangs"))
+		return;
+
+	JobContext context(VanekApp::DefaultParams());
+	std::unique_ptr<Model3D> model3D = GenerateModel(config);
+	const OpenMeshData& mesh = model3D->mesh.HalfedgeMesh();
+	model3D->mesh.FaceNormals();
+
+	std::unique_ptr<OverhangDetector> detector;
+	auto reset = [&] {
+		detector.reset(new OverhangDetector(context));
+		detector->target = model3D.get();
+	};
+
+	if (Enabled("point overhangs")) {
+		Measure("point overhangs", reset, [&] {
+			detector->DetectPointOverhangs();
+			return (long long)mesh.n_vertices();
+			});
+	}
+	if (Enabled("edge overhangs")) {
+		Measure("edge overhangs", reset, [&] {
+			detector->DetectEdgeOverhangs();
+			return (long long)mesh.n_edges();
+			});
+	}
+	if (Enabled("face overhangs")) {
+		Measure("face overhangs", reset, [&] {
+			detector->DetectFaceOverhangs();
+			return (long long)model3D->mesh.FaceCount();
+			});
+	}
+}
+
+bool KernelBench::WriteJSON(const std::string& path) const
+{
+	std::ofstream out(path);
+	if (!out) {
+		std::cerr << "Unable to write kernel results to " <<
+			path << std::endl;
+		return false;
+	}
+
+	out << "[\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+		out << "{\"kernel\":\"" << r.kernel << "\",\"items\":" << r.items <<
+			",\"seconds\":" << r.seconds <<
+			",\"items_per_s\":" << r.itemsPerSecond << "}" <<
+			(i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "]\n";
+
+	return true;
+}
+
+bool KernelBench::Compare(const std::string& baselinePath, double tolerance,
+	std::ostream& out) const
+{
+	std::ifstream in(baselinePath);
+	if (!in) {
+		std::cerr << "Unable to read the baseline " << baselinePath << std::endl;
+		return false;
+	}
+	std::stringstream text;
+	text << in.rdbuf();
+	std::string json = text.str();
+
+	std::map<std::string, double> baseline;
+	std::regex entry("\"kernel\":\"([^\"]*)\"[^}]*\"items_per_s\":([-+.eE0-9]+)");
+	for (std::sregex_iterator it(json.begin(), json.end(), entry), end;
+		it != end; it++) {
+		double rate;
+		if (!ParseNumber((*it)[2], rate)) {
+			std::cerr << "Malformed baseline rate of " << (*it)[1] << std::endl;
+			return false;
+		}
+		baseline[(*it)[1]] = rate;
+	}
+
+	bool passed = true;
+	out << std::left << std::setw(28) << "kernel" << std::right <<
+		std::setw(14) << "baseline/s" << std::setw(14) << "current/s" <<
+		std::setw(10) << "delta" << std::endl;
+	for (const Result& r : results) {
+		out << std::left << std::setw(28) << r.kernel << std::right;
+		auto it = baseline.find(r.kernel);
+		if (it == baseline.end() || it->second <= 0) {
+			out << std::setw(14) << "-" << std::scientific <<
+				std::setprecision(3) << std::setw(14) << r.itemsPerSecond <<
+				std::defaultfloat << std::setw(10) << "new" << std::endl;
+			continue;
+		}
+
+		double delta = r.itemsPerSecond / it->second - 1.0;
+		bool regressed = delta < -tolerance;
+		passed = passed && !regressed;
+		out << std::scientific << std::setprecision(3) <<
+			std::setw(14) << it->second << std::setw(14) << r.itemsPerSecond <<
+			std::fixed << std::setprecision(1) << std::setw(9) <<
+			std::showpos << delta * 100 << std::noshowpos << "%" <<
+			std::defaultfloat << (regressed ? "  REGRESSION" : "") << std::endl;
+	}
+
+	return passed;
+}
\ No newline at end of file
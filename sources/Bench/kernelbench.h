@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <functional>
+#include <glcontext.h>
+
+struct KernelConfig {
+	// empty runs every kernel
+	std::vector<std::string> kernels;
+	// generated mesh the GPU and mesh kernels start from
+	std::string shape;
+	int triangles;
+	float footprint;
+	int layers;
+	unsigned seed;
+
+	int reps;
+	int threads;
+};
+
+// Microbenchmarks of the hot CPU loops. Inputs are generated from the seed
+// and built outside the timed region; each kernel reports the median over
+// the repetitions as items per second. The recipe classes declare this one
+// a friend so the loops can be driven without running the whole recipe.
+class KernelBench
+{
+public:
+	struct Result {
+		std::string kernel;
+		long long items;
+		double seconds;
+		double itemsPerSecond;
+	};
+
+	KernelBench(const KernelConfig& config_)
+		: config(config_), gl("Kernel Bench") {}
+
+	void Run();
+
+	const std::vector<Result>& GetResults() const {
+		return results;
+	}
+
+	bool WriteJSON(const std::string& path) const;
+	// prints the change against a file written by WriteJSON and returns
+	// false if any kernel lost more than tolerance of its throughput
+	bool Compare(const std::string& baselinePath, double tolerance,
+		std::ostream&) const;
+
+private:
+	bool Enabled(const std::string& kernel) const;
+	void PinThreads();
+	// kernelFn returns the number of items it processed
+	void Measure(const std::string& kernel, std::function<void()> setup,
+		std::function<long long()> kernelFn);
+
+	void FreeFloatingKernels();
+	void HuangKernels();
+	void VanekKernels();
+
+private:
+	KernelConfig config;
+	std::vector<Result> results;
+	// the GPU kernels share one context for the whole run
+	GLContext gl;
+};
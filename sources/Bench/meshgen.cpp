@@ -0,0 +1,300 @@
+#include "meshgen.h"
+
+#include <iostream>
+#include <unordered_map>
+#include <random>
+#include <cmath>
+#include <cstring>
+using glm::vec3;
+
+namespace
+{
+	const float PI = 3.14159265f;
+
+	// Indexed mesh assembly; vertices with identical coordinates are merged
+	// so the result is closed wherever the generator emits shared corners.
+	class MeshBuilder
+	{
+	public:
+		MeshBuilder(MeshData& mesh_) : mesh(mesh_) {}
+
+		GLuint Vertex(const vec3& p) {
+			uint64_t key = Hash(p);
+			auto range = lookup.equal_range(key);
+			for (auto it = range.first; it != range.second; it++) {
+				if (mesh.Position(it->second) == p)
+					return it->second;
+			}
+
+			GLuint v = mesh.VertexCount();
+			mesh.points.push_back(p.x);
+			mesh.points.push_back(p.y);
+			mesh.points.push_back(p.z);
+			lookup.emplace(key, v);
+			return v;
+		}
+		void Triangle(GLuint a, GLuint b, GLuint c, bool flip = false) {
+			if (a == b || b == c || c == a)
+				return;
+			mesh.indices.push_back(a);
+			mesh.indices.push_back(flip ? c : b);
+			mesh.indices.push_back(flip ? b : c);
+		}
+
+	private:
+		static uint64_t Hash(const vec3& p) {
+			uint32_t bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			uint64_t h = bits[0];
+			h = h * 0x9E3779B97F4A7C15ull ^ bits[1];
+			h = h * 0x9E3779B97F4A7C15ull ^ bits[2];
+			return h;
+		}
+
+		MeshData& mesh;
+		std::unordered_multimap<uint64_t, GLuint> lookup;
+	};
+
+	// a rotation given by the images of the x, y and z axes
+	struct Frame {
+		vec3 axes[3];
+		vec3 origin;
+
+		vec3 Apply(const vec3& p) const {
+			return origin + axes[0] * p.x + axes[1] * p.y + axes[2] * p.z;
+		}
+	};
+
+	Frame Identity(const vec3& origin)
+	{
+		Frame frame;
+		frame.axes[0] = vec3(1, 0, 0);
+		frame.axes[1] = vec3(0, 1, 0);
+		frame.axes[2] = vec3(0, 0, 1);
+		frame.origin = origin;
+		return frame;
+	}
+
+	Frame RandomFrame(std::mt19937& rng, const vec3& origin)
+	{
+		// uniform random unit quaternion
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		float u1 = uniform(rng), u2 = uniform(rng), u3 = uniform(rng);
+		float a = sqrt(1 - u1), b = sqrt(u1);
+		float x = a * sin(2 * PI * u2), y = a * cos(2 * PI * u2);
+		float z = b * sin(2 * PI * u3), w = b * cos(2 * PI * u3);
+
+		Frame frame;
+		frame.axes[0] = vec3(1 - 2 * (y * y + z * z), 2 * (x * y + w * z),
+			2 * (x * z - w * y));
+		frame.axes[1] = vec3(2 * (x * y - w * z), 1 - 2 * (x * x + z * z),
+			2 * (y * z + w * x));
+		frame.axes[2] = vec3(2 * (x * z + w * y), 2 * (y * z - w * x),
+			1 - 2 * (x * x + y * y));
+		frame.origin = origin;
+		return frame;
+	}
+
+	// axis-aligned box in frame coordinates with k x k quads per face
+	void AddBox(MeshBuilder& builder, const Frame& frame,
+		const vec3& lo, const vec3& hi, int k, bool inward)
+	{
+		for (int axis = 0; axis < 3; axis++) {
+			int u = (axis + 1) % 3;
+			int v = (axis + 2) % 3;
+			for (int side = 0; side < 2; side++) {
+				std::vector<GLuint> grid((k + 1) * (k + 1));
+				for (int i = 0; i <= k; i++) {
+					for (int j = 0; j <= k; j++) {
+						vec3 p;
+						p[axis] = side ? hi[axis] : lo[axis];
+						p[u] = lo[u] + (hi[u] - lo[u]) * i / k;
+						p[v] = lo[v] + (hi[v] - lo[v]) * j / k;
+						grid[i * (k + 1) + j] = builder.Vertex(frame.Apply(p));
+					}
+				}
+
+				// (u, v, axis) is right handed, so u x v points along +axis
+				bool flip = (side == 0) != inward;
+				for (int i = 0; i < k; i++) {
+					for (int j = 0; j < k; j++) {
+						GLuint a = grid[i * (k + 1) + j];
+						GLuint b = grid[(i + 1) * (k + 1) + j];
+						GLuint c = grid[(i + 1) * (k + 1) + j + 1];
+						GLuint d = grid[i * (k + 1) + j + 1];
+						builder.Triangle(a, b, c, flip);
+						builder.Triangle(a, c, d, flip);
+					}
+				}
+			}
+		}
+	}
+
+	int BoxSubdivision(int triangles)
+	{
+		return std::max(1, (int)round(sqrt(triangles / 12.0)));
+	}
+}
+
+bool MeshGenerator::Generate(const ShapeSpec& spec, MeshData& mesh)
+{
+	mesh = MeshData();
+	int layers = std::max(1, spec.layers);
+	if (spec.shape == "sphere")
+		Spheres(spec.triangles, spec.footprint, layers, mesh);
+	else if (spec.shape == "torus")
+		Tori(spec.triangles, spec.footprint, layers, mesh);
+	else if (spec.shape == "plates")
+		Plates(spec.triangles, spec.footprint, layers, mesh);
+	else if (spec.shape == "lattice")
+		Lattice(spec.triangles, spec.footprint, layers, mesh);
+	else if (spec.shape == "shells")
+		Shells(spec.triangles, spec.footprint, layers, spec.seed, mesh);
+	else
+		return false;
+
+	return true;
+}
+
+std::unique_ptr<Model3D> MeshGenerator::CreateModel(const ShapeSpec& spec)
+{
+	MeshData mesh;
+	if (!Generate(spec, mesh)) {
+		std::cerr << "Unknown shape : " << spec.shape << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return Model3D::Create(std::move(mesh));
+}
+
+void MeshGenerator::Spheres(int triangles, float footprint, int layers,
+	MeshData& mesh)
+{
+	MeshBuilder builder(mesh);
+	int slices = std::max(8, (int)sqrt((double)triangles / layers));
+	int stacks = std::max(4, slices / 2);
+	float radius = footprint / 2;
+	vec3 center(radius, radius, radius);
+
+	for (int l = 0; l < layers; l++) {
+		float r = radius * (1.0f - 0.8f * l / layers);
+		std::vector<GLuint> ring((stacks + 1) * slices);
+		for (int i = 0; i <= stacks; i++) {
+			float theta = PI * i / stacks;
+			for (int j = 0; j < slices; j++) {
+				float phi = 2 * PI * j / slices;
+				// the poles are placed exactly so the rings collapse there
+				vec3 p = (i == 0 || i == stacks) ?
+					vec3(0, 0, i == 0 ? r : -r) :
+					vec3(r * sin(theta) * cos(phi), r * sin(theta) * sin(phi),
+						r * cos(theta));
+				ring[i * slices + j] = builder.Vertex(center + p);
+			}
+		}
+
+		for (int i = 0; i < stacks; i++) {
+			for (int j = 0; j < slices; j++) {
+				int jn = (j + 1) % slices;
+				GLuint a = ring[i * slices + j];
+				GLuint b = ring[(i + 1) * slices + j];
+				GLuint c = ring[(i + 1) * slices + jn];
+				GLuint d = ring[i * slices + jn];
+				builder.Triangle(a, b, c, l % 2 == 1);
+				builder.Triangle(a, c, d, l % 2 == 1);
+			}
+		}
+	}
+}
+
+void MeshGenerator::Tori(int triangles, float footprint, int layers,
+	MeshData& mesh)
+{
+	MeshBuilder builder(mesh);
+	int v = std::max(6, (int)sqrt(triangles / (4.0 * layers)));
+	int u = 2 * v;
+	float minor = footprint * 0.15f;
+	float major = footprint / 2 - minor;
+	vec3 center(footprint / 2, footprint / 2, 0);
+
+	for (int l = 0; l < layers; l++) {
+		// stacked with a gap of one tube radius
+		float z = minor + l * 3 * minor;
+		std::vector<GLuint> grid(u * v);
+		for (int i = 0; i < u; i++) {
+			float a = 2 * PI * i / u;
+			for (int j = 0; j < v; j++) {
+				float b = 2 * PI * j / v;
+				float r = major + minor * cos(b);
+				grid[i * v + j] = builder.Vertex(center +
+					vec3(r * cos(a), r * sin(a), z + minor * sin(b)));
+			}
+		}
+
+		for (int i = 0; i < u; i++) {
+			for (int j = 0; j < v; j++) {
+				GLuint p = grid[i * v + j];
+				GLuint q = grid[((i + 1) % u) * v + j];
+				GLuint r = grid[((i + 1) % u) * v + (j + 1) % v];
+				GLuint s = grid[i * v + (j + 1) % v];
+				builder.Triangle(p, q, r);
+				builder.Triangle(p, r, s);
+			}
+		}
+	}
+}
+
+void MeshGenerator::Plates(int triangles, float footprint, int layers,
+	MeshData& mesh)
+{
+	MeshBuilder builder(mesh);
+	int k = BoxSubdivision(triangles / layers);
+	float thickness = footprint * 0.05f;
+	float gap = footprint * 0.15f;
+	float shift = footprint * 0.1f;
+
+	for (int l = 0; l < layers; l++) {
+		float z = l * (thickness + gap);
+		float x = (l % 2) * shift;
+		AddBox(builder, Identity(vec3(0)),
+			vec3(x, 0, z), vec3(x + footprint - shift, footprint, z + thickness),
+			k, false);
+	}
+}
+
+void MeshGenerator::Lattice(int triangles, float footprint, int cells,
+	MeshData& mesh)
+{
+	MeshBuilder builder(mesh);
+	int k = BoxSubdivision(triangles / (cells * cells * cells));
+	float pitch = footprint / cells;
+	float size = pitch * 0.6f;
+
+	for (int i = 0; i < cells; i++) {
+		for (int j = 0; j < cells; j++) {
+			for (int l = 0; l < cells; l++) {
+				vec3 lo = vec3(i, j, l) * pitch;
+				AddBox(builder, Identity(vec3(0)), lo, lo + vec3(size), k, false);
+			}
+		}
+	}
+}
+
+void MeshGenerator::Shells(int triangles, float footprint, int count,
+	unsigned seed, MeshData& mesh)
+{
+	MeshBuilder builder(mesh);
+	std::mt19937 rng(seed);
+	int k = BoxSubdivision(triangles / (2 * count));
+	int side = (int)ceil(sqrt((double)count));
+	float cell = footprint / side;
+	// a rotated cube of this half size stays inside its cell
+	float half = cell * 0.28f;
+	float wall = half * 0.2f;
+
+	for (int n = 0; n < count; n++) {
+		vec3 center((n % side + 0.5f) * cell, (n / side + 0.5f) * cell,
+			cell * 0.5f);
+		Frame frame = RandomFrame(rng, center);
+		AddBox(builder, frame, vec3(-half), vec3(half), k, false);
+		AddBox(builder, frame, vec3(-half + wall), vec3(half - wall), k, true);
+	}
+}
\ No newline at end of file
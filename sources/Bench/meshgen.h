@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <model3d.h>
+
+struct ShapeSpec {
+	std::string shape;
+	// triangle budget for the whole mesh
+	int triangles;
+	// XY extent in mm
+	float footprint;
+	// nested shells, stacked plates, lattice cells per side or shell count;
+	// sets the depth complexity
+	int layers;
+	unsigned seed;
+};
+
+// Procedural closed meshes for benchmarking. Every generator fits its
+// output into a footprint x footprint square above z = 0.
+class MeshGenerator
+{
+public:
+	static bool Generate(const ShapeSpec&, MeshData&);
+	// exits on an unknown shape
+	static std::unique_ptr<Model3D> CreateModel(const ShapeSpec&);
+
+	// nested spheres, every other one inverted so they form hollow shells
+	static void Spheres(int triangles, float footprint, int layers, MeshData&);
+	// tori stacked along z
+	static void Tori(int triangles, float footprint, int layers, MeshData&);
+	// plates stacked with gaps, alternately shifted to make overhangs
+	static void Plates(int triangles, float footprint, int layers, MeshData&);
+	// cells^3 disjoint cubes
+	static void Lattice(int triangles, float footprint, int cells, MeshData&);
+	// hollow boxes with random orientation on a grid
+	static void Shells(int triangles, float footprint, int count,
+		unsigned seed, MeshData&);
+};
@@ -0,0 +1,74 @@
+#include "kernelbench.h"
+
+#include <params.h>
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+	KernelConfig config;
+	config.shape = "sphere";
+	config.triangles = 20000;
+	config.footprint = 20.0f;
+	config.layers = 3;
+	config.seed = 1;
+	config.reps = 5;
+	config.threads = 0;
+
+	std::string baselinePath, jsonPath;
+	double tolerance = 0.1;
+	for (int i = 1; i < argc; i++) {
+		std::string option = argv[i];
+		std::string name, value;
+		SplitOption(option, name, value);
+
+		bool known = true;
+		if (name == "--kernels") {
+			std::vector<std::string> kernels = SplitList(value);
+			config.kernels.insert(config.kernels.end(), kernels.begin(),
+				kernels.end());
+		}
+		else if (name == "--shape")
+			config.shape = value;
+		else if (name == "--triangles")
+			known = ParseNumber(value, config.triangles);
+		else if (name == "--footprint")
+			known = ParseNumber(value, config.footprint);
+		else if (name == "--layers")
+			known = ParseNumber(value, config.layers);
+		else if (name == "--seed")
+			known = ParseNumber(value, config.seed);
+		else if (name == "--reps")
+			known = ParseNumber(value, config.reps);
+		else if (name == "--threads")
+			known = ParseNumber(value, config.threads);
+		else if (name == "--baseline")
+			baselinePath = value;
+		else if (name == "--tolerance") {
+			known = ParseNumber(value, tolerance);
+			tolerance /= 100.0;
+		}
+		else if (name == "--json")
+			jsonPath = value;
+		else
+			known = false;
+
+		if (!known) {
+			std::cerr << "Unknown option : " << option << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (config.reps < 1) {
+		std::cerr << "At least one repetition is needed" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	KernelBench bench(config);
+	bench.Run();
+
+	if (!jsonPath.empty())
+		bench.WriteJSON(jsonPath);
+	if (!baselinePath.empty() &&
+		!bench.Compare(baselinePath, tolerance, std::cout))
+		return EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "validator.h"
+
+#include <params.h>
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+	ValidateConfig config;
+	config.shapes = { "sphere", "torus", "plates", "lattice", "shells" };
+	config.triangles = 20000;
+	config.footprint = 20.0f;
+	config.layers = 3;
+	config.seed = 1;
+	config.sliceTolerance = 0.01f;
+	config.sampleTolerance = 0.0f;
+
+	for (int i = 1; i < argc; i++) {
+		std::string option = argv[i];
+		std::string name, value;
+		SplitOption(option, name, value);
+
+		bool known = true;
+		if (name == "--checks")
+			config.checks = SplitList(value);
+		else if (name == "--shapes")
+			config.shapes = SplitList(value);
+		else if (name == "--triangles")
+			known = ParseNumber(value, config.triangles);
+		else if (name == "--footprint")
+			known = ParseNumber(value, config.footprint);
+		else if (name == "--layers")
+			known = ParseNumber(value, config.layers);
+		else if (name == "--seed")
+			known = ParseNumber(value, config.seed);
+		else if (name == "--slice-tolerance") {
+			known = ParseNumber(value, config.sliceTolerance);
+			config.sliceTolerance /= 100.0f;
+		}
+		else if (name == "--sample-tolerance")
+			known = ParseNumber(value, config.sampleTolerance);
+		else
+			known = false;
+
+		if (!known) {
+			std::cerr << "Unknown option : " << option << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	Validator validator(config);
+	bool passed = validator.Run();
+	validator.PrintReport(std::cout);
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,552 @@
+#include "validator.h"
+#include "meshgen.h"
+#include "freefloatingapp.h"
+#include "supportpoint.h"
+#include "incremental.h"
+#include "huangapp.h"
+#include "anchormap.h"
+#include "binaryimages.h"
+#include "contourslicer.h"
+#include "vanekapp.h"
+#include "overhang.h"
+
+#include <jobcontext.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <atomic>
+#include <unordered_map>
+#include <omp.h>
+using glm::vec3;
+using cv::Mat;
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	double Milliseconds(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(
+			Clock::now() - start).count();
+	}
+
+	// Counts the points of a with no point of b within tolerance and the
+	// largest such nearest distance, capped at the tolerance.
+	void Match(const std::vector<vec3>& a, const std::vector<vec3>& b,
+		float tolerance, size_t& unmatched, float& maxDistance)
+	{
+		auto key = [](int x, int y, int z) {
+			return ((int64_t)(x & 0x1fffff) << 42) |
+				((int64_t)(y & 0x1fffff) << 21) | (int64_t)(z & 0x1fffff);
+		};
+		auto cell = [tolerance](float v) {
+			return (int)floor(v / tolerance);
+		};
+
+		std::unordered_map<int64_t, std::vector<int>> grid;
+		for (int i = 0; i < b.size(); i++)
+			grid[key(cell(b[i].x), cell(b[i].y), cell(b[i].z))].push_back(i);
+
+		unmatched = 0;
+		maxDistance = 0;
+		for (const vec3& p : a) {
+			int cx = cell(p.x), cy = cell(p.y), cz = cell(p.z);
+			float best = tolerance;
+			bool found = false;
+			for (int dx = -1; dx <= 1; dx++) {
+				for (int dy = -1; dy <= 1; dy++) {
+					for (int dz = -1; dz <= 1; dz++) {
+						auto it = grid.find(key(cx + dx, cy + dy, cz + dz));
+						if (it == grid.end())
+							continue;
+						for (int i : it->second) {
+							float d = glm::length(b[i] - p);
+							if (d <= best) {
+								best = d;
+								found = true;
+							}
+						}
+					}
+				}
+			}
+			if (!found)
+				unmatched++;
+			maxDistance = std::max(maxDistance, best);
+		}
+	}
+
+	// A copy of the mesh with a slab hanging under the middle of it, and
+	// the corners of the slab's triangles.
+	std::unique_ptr<Model3D> AddSlab(const Model3D& model3D,
+		std::vector<vec3>& corners)
+	{
+		MeshData data;
+		data.points = model3D.mesh.points;
+		data.indices = model3D.mesh.indices;
+
+		vec3 lo = model3D.aabb.GetMin(), hi = model3D.aabb.GetMax();
+		vec3 center = (lo + hi) * 0.5f;
+		center.z = lo.z + (hi.z - lo.z) * 0.3f;
+		vec3 half(1.5f, 1.5f, 0.5f);
+		GLuint base = data.points.size() / 3;
+		for (int c = 0; c < 8; c++) {
+			data.points.push_back(center.x + (c & 1 ? half.x : -half.x));
+			data.points.push_back(center.y + (c & 2 ? half.y : -half.y));
+			data.points.push_back(center.z + (c & 4 ? half.z : -half.z));
+		}
+		const int faces[12][3] = {
+			{ 0, 2, 1 }, { 1, 2, 3 }, { 4, 5, 6 }, { 5, 7, 6 },
+			{ 0, 1, 4 }, { 1, 5, 4 }, { 2, 6, 3 }, { 3, 6, 7 },
+			{ 0, 4, 2 }, { 2, 4, 6 }, { 1, 3, 5 }, { 3, 7, 5 } };
+		for (const int* face : faces) {
+			for (int k = 0; k < 3; k++) {
+				GLuint v = base + face[k];
+				data.indices.push_back(v);
+				corners.push_back(vec3(data.points[v * 3],
+					data.points[v * 3 + 1], data.points[v * 3 + 2]));
+			}
+		}
+		return Model3D::Create(std::move(data));
+	}
+}
+
+bool Validator::Run()
+{
+	ContextScope current(gl);
+	for (const std::string& shape : config.shapes) {
+		if (Enabled("support points"))
+			CheckSupportPoints(shape);
+		if (Enabled("incremental"))
+			CheckIncremental(shape);
+		if (Enabled("progressive"))
+			CheckProgressive(shape);
+	}
+	for (const std::string& shape : config.shapes) {
+		if (Enabled("slices"))
+			CheckSlices(shape);
+		if (Enabled("anchor maps"))
+			CheckAnchorMaps(shape);
+	}
+	for (const std::string& shape : config.shapes) {
+		if (Enabled("overhang samples"))
+			CheckOverhangSamples(shape);
+	}
+
+	bool passed = true;
+	for (const Result& r : results)
+		passed = passed && r.passed;
+	return passed;
+}
+
+bool Validator::Enabled(const std::string& check) const
+{
+	return config.checks.empty() ||
+		std::find(config.checks.begin(), config.checks.end(), check) !=
+		config.checks.end();
+}
+
+std::unique_ptr<Model3D> Validator::GenerateModel(const std::string& shape) const
+{
+	ShapeSpec spec = { shape, config.triangles, config.footprint,
+		config.layers, config.seed };
+	return MeshGenerator::CreateModel(spec);
+}
+
+void Validator::CheckSupportPoints(const std::string& shape)
+{
+	Params params = FreeFloatingApp::DefaultParams();
+	params.graphEngine = GraphEngineType::BOOST;
+	JobContext referenceContext(params);
+	params.graphEngine = GraphEngineType::COLUMN;
+	JobContext alternativeContext(params);
+
+	std::unique_ptr<Model3D> model3D = GenerateModel(shape);
+	zLDNIGenerator generator(referenceContext, model3D.get());
+	if (!generator.GetStatus().IsOk()) {
+		Add("support points", shape, 0, 0, generator.GetStatus().Message(),
+			false);
+		return;
+	}
+
+	SupportPointFinder reference(referenceContext);
+	SupportPointFinder alternative(alternativeContext);
+	reference.ReadIntersections(generator);
+	reference.ConnectIntersections();
+	alternative.ReadIntersections(generator);
+	alternative.ConnectIntersections();
+
+	Clock::time_point start = Clock::now();
+	reference.FindSupportPoints();
+	double referenceMs = Milliseconds(start);
+
+	start = Clock::now();
+	alternative.FindSupportPoints();
+	double alternativeMs = Milliseconds(start);
+
+	const std::vector<vec3>& a = reference.supportPoints;
+	const std::vector<vec3>& b = alternative.supportPoints;
+	size_t first = 0;
+	while (first < a.size() && first < b.size() && a[first] == b[first])
+		first++;
+
+	std::stringstream diff;
+	bool passed = a.size() == b.size() && first == a.size();
+	if (passed)
+		diff << a.size() << " points, identical";
+	else
+		diff << a.size() << " vs " << b.size() <<
+			" points, first difference at " << first;
+	Add("support points", shape, referenceMs, alternativeMs, diff.str(), passed);
+}
+
+void Validator::CheckIncremental(const std::string& shape)
+{
+	JobContext context(FreeFloatingApp::DefaultParams());
+
+	std::unique_ptr<Model3D> model3D = GenerateModel(shape);
+	std::vector<vec3> changed;
+	std::unique_ptr<Model3D> edited = AddSlab(*model3D, changed);
+
+	// the reference renders the whole frame of the unedited mesh
+	zLDNIGenerator frame(context, model3D.get());
+	IncrementalSupport incremental(context.params);
+	Status status = frame.GetStatus();
+	if (status.IsOk())
+		status = incremental.Run(model3D.get());
+	if (!status.IsOk()) {
+		Add("incremental", shape, 0, 0, status.Message(), false);
+		return;
+	}
+	int width, height;
+	frame.GetImageSize(width, height);
+
+	// the slab is added, then taken away again
+	const char* steps[] = { "add", "remove" };
+	Model3D* meshes[] = { edited.get(), model3D.get() };
+	for (int step = 0; step < 2; step++) {
+		Clock::time_point start = Clock::now();
+		zLDNIGenerator generator(context, meshes[step], frame,
+			glm::ivec4(0, 0, width, height));
+		SupportPointFinder reference(context);
+		reference.Run(generator);
+		double referenceMs = Milliseconds(start);
+
+		start = Clock::now();
+		status = incremental.Update(meshes[step], changed);
+		double alternativeMs = Milliseconds(start);
+		if (!status.IsOk()) {
+			Add("incremental", shape, 0, 0, status.Message(), false);
+			return;
+		}
+
+		const std::vector<vec3>& a = reference.GetSupportPoints();
+		const std::vector<vec3>& b = incremental.GetSupportPoints();
+		size_t first = 0;
+		while (first < a.size() && first < b.size() && a[first] == b[first])
+			first++;
+
+		std::stringstream diff;
+		bool passed = a.size() == b.size() && first == a.size();
+		diff << steps[step] << ", ";
+		if (passed)
+			diff << a.size() << " points, identical";
+		else
+			diff << a.size() << " vs " << b.size() <<
+				" points, first difference at " << first;
+		Add("incremental", shape, referenceMs, alternativeMs, diff.str(),
+			passed);
+	}
+}
+
+void Validator::CheckProgressive(const std::string& shape)
+{
+	JobContext context(FreeFloatingApp::DefaultParams());
+
+	std::unique_ptr<Model3D> model3D = GenerateModel(shape);
+	zLDNIGenerator generator(context, model3D.get());
+	if (!generator.GetStatus().IsOk()) {
+		Add("progressive", shape, 0, 0, generator.GetStatus().Message(),
+			false);
+		return;
+	}
+
+	Clock::time_point start = Clock::now();
+	SupportPointFinder reference(context);
+	Status status = reference.Run(generator);
+	double referenceMs = Milliseconds(start);
+	if (!status.IsOk()) {
+		Add("progressive", shape, 0, 0, status.Message(), false);
+		return;
+	}
+	const std::vector<vec3>& a = reference.GetSupportPoints();
+
+	// no budget, cancelled before the first search, and a budget that
+	// runs out once half the points are emitted; a wall clock deadline
+	// mostly expires while the graph is still built
+	const char* cases[] = { "unbounded", "cancelled", "out of budget" };
+	size_t half = (a.size() + 1) / 2;
+	for (int c = 0; c < 3; c++) {
+		std::atomic<bool> cancel(c == 1);
+		std::vector<vec3> b;
+		float covered = 0;
+		SearchProgress progress;
+		progress.emit = [&](const vec3& point, float coverage) {
+			b.push_back(point);
+			covered = coverage;
+			if (c == 2 && b.size() == half)
+				progress.deadline = Clock::now();
+		};
+		progress.cancel = &cancel;
+
+		start = Clock::now();
+		SupportPointFinder alternative(context);
+		alternative.SetProgress(&progress);
+		status = alternative.Run(generator);
+		double alternativeMs = Milliseconds(start);
+		if (!status.IsOk()) {
+			Add("progressive", shape, 0, 0, status.Message(), false);
+			return;
+		}
+
+		size_t first = 0;
+		while (first < a.size() && first < b.size() && a[first] == b[first])
+			first++;
+		bool kept = b == alternative.GetSupportPoints();
+
+		std::stringstream diff;
+		bool passed;
+		diff << cases[c] << ", ";
+		if (c == 0) {
+			passed = kept && first == a.size() && b.size() == a.size() &&
+				alternative.IsComplete() && covered == 1.0f;
+			diff << b.size() << " of " << a.size() << " points, covered " <<
+				covered;
+		}
+		else if (c == 1) {
+			// with no floatable vertex there is nothing left to cover
+			passed = kept && b.empty() && (a.empty() ?
+				alternative.GetCoverage() == 1.0f :
+				alternative.GetCoverage() < 1.0f);
+			diff << b.size() << " points, covered " <<
+				alternative.GetCoverage();
+		}
+		else {
+			passed = kept && first == b.size() && b.size() == half &&
+				alternative.IsComplete() == (half == a.size());
+			diff << b.size() << " of " << a.size() << " points";
+			if (first < b.size())
+				diff << ", first difference at " << first;
+		}
+		Add("progressive", shape, referenceMs, alternativeMs, diff.str(),
+			passed);
+	}
+}
+
+void Validator::CheckSlices(const std::string& shape)
+{
+	JobContext context(HuangApp::DefaultParams());
+
+	std::unique_ptr<Model3D> model3D = GenerateModel(shape);
+	std::vector<float> heights =
+		AnchorMapGenerator(context).LayerHeights(model3D.get());
+
+	Clock::time_point start = Clock::now();
+	BinaryImageSampler sampler(context, model3D.get());
+	double referenceMs = Milliseconds(start);
+	if (!sampler.GetStatus().IsOk()) {
+		Add("slices", shape, 0, 0, sampler.GetStatus().Message(), false);
+		return;
+	}
+
+	start = Clock::now();
+	ContourSlicer slicer(context, model3D.get(), heights);
+	double alternativeMs = Milliseconds(start);
+
+	int w0, h0, w1, h1;
+	sampler.GetImageSize(w0, h0);
+	slicer.GetImageSize(w1, h1);
+	if (w0 != w1 || h0 != h1) {
+		std::stringstream diff;
+		diff << "image size " << w0 << "x" << h0 << " vs " << w1 << "x" << h1;
+		Add("slices", shape, referenceMs, alternativeMs, diff.str(), false);
+		return;
+	}
+
+	int batchSize = omp_get_max_threads();
+	long long mismatched = 0, foreground = 0;
+	std::vector<Mat> ldniSlices, contourSlices;
+	for (int first = 0; first < heights.size(); first += batchSize) {
+		int last = std::min<int>(heights.size(), first + batchSize);
+
+		start = Clock::now();
+		ldniSlices.clear();
+		for (int i = first; i < last; i++)
+			ldniSlices.push_back(sampler.Slice(heights[i]));
+		referenceMs += Milliseconds(start);
+
+		start = Clock::now();
+		slicer.Slice(first, last, contourSlices);
+		alternativeMs += Milliseconds(start);
+
+		for (int i = 0; i < ldniSlices.size(); i++) {
+			Mat diff;
+			cv::bitwise_xor(ldniSlices[i], contourSlices[i], diff);
+			mismatched += cv::countNonZero(diff);
+			cv::bitwise_or(ldniSlices[i], contourSlices[i], diff);
+			foreground += cv::countNonZero(diff);
+		}
+	}
+
+	double ratio = foreground > 0 ? (double)mismatched / foreground : 0;
+	std::stringstream diff;
+	diff << mismatched << " of " << foreground << " foreground pixels (" <<
+		std::setprecision(3) << ratio * 100 << "%, tolerance " <<
+		config.sliceTolerance * 100 << "%)";
+	Add("slices", shape, referenceMs, alternativeMs, diff.str(),
+		ratio <= config.sliceTolerance);
+}
+
+void Validator::CheckAnchorMaps(const std::string& shape)
+{
+	Params params = HuangApp::DefaultParams();
+	params.swallowEngine = SwallowEngineType::ITERATIVE;
+	JobContext referenceContext(params);
+	params.swallowEngine = SwallowEngineType::FRONTIER;
+	JobContext alternativeContext(params);
+
+	std::unique_ptr<Model3D> model3D = GenerateModel(shape);
+	AnchorMapGenerator reference(referenceContext);
+	AnchorMapGenerator alternative(alternativeContext);
+	std::vector<float> heights = reference.LayerHeights(model3D.get());
+
+	// both engines get the same slices, so only the map generation is timed
+	int cols, rows;
+	std::vector<Mat> slices;
+	{
+		BinaryImageSampler sampler(referenceContext, model3D.get());
+		if (!sampler.GetStatus().IsOk()) {
+			Add("anchor maps", shape, 0, 0, sampler.GetStatus().Message(),
+				false);
+			return;
+		}
+		sampler.GetImageSize(cols, rows);
+		for (float h : heights)
+			slices.push_back(sampler.Slice(h));
+	}
+	auto slice = [&](int i) {
+		return slices[i];
+	};
+	int top = heights.size() - 1;
+
+	std::vector<Mat> referenceMaps, alternativeMaps;
+	reference.anchorMapSink = &referenceMaps;
+	alternative.anchorMapSink = &alternativeMaps;
+
+	Clock::time_point start = Clock::now();
+	reference.GenerateAnchorMaps(rows, cols, top, slice);
+	double referenceMs = Milliseconds(start);
+
+	start = Clock::now();
+	alternative.GenerateAnchorMaps(rows, cols, top, slice);
+	double alternativeMs = Milliseconds(start);
+
+	int layers = 0;
+	long long pixels = 0;
+	for (int i = 0; i < referenceMaps.size() && i < alternativeMaps.size(); i++) {
+		Mat diff;
+		cv::bitwise_xor(referenceMaps[i], alternativeMaps[i], diff);
+		int n = cv::countNonZero(diff);
+		if (n > 0)
+			layers++;
+		pixels += n;
+	}
+
+	std::stringstream diff;
+	bool passed = referenceMaps.size() == alternativeMaps.size() && pixels == 0;
+	if (passed)
+		diff << referenceMaps.size() << " layers, identical";
+	else
+		diff << layers << " of " << referenceMaps.size() <<
+			" layers differ in " << pixels << " pixels";
+	Add("anchor maps", shape, referenceMs, alternativeMs, diff.str(), passed);
+}
+
+void Validator::CheckOverhangSamples(const std::string& shape)
+{
+	Params params = VanekApp::DefaultParams();
+	params.faceSampler = FaceSamplerType::RASTERIZER;
+	JobContext referenceContext(params);
+	params.faceSampler = FaceSamplerType::BARYCENTRIC;
+	JobContext alternativeContext(params);
+	float tolerance = config.sampleTolerance > 0 ?
+		config.sampleTolerance : params.samplingResolution;
+
+	std::unique_ptr<Model3D> model3D = GenerateModel(shape);
+	model3D->mesh.HalfedgeMesh();
+
+	OverhangDetector reference(referenceContext);
+	OverhangDetector alternative(alternativeContext);
+	Clock::time_point start = Clock::now();
+	Status status = reference.Run(model3D.get());
+	double referenceMs = Milliseconds(start);
+	if (!status.IsOk()) {
+		Add("overhang samples", shape, 0, 0, status.Message(), false);
+		return;
+	}
+
+	start = Clock::now();
+	alternative.Run(model3D.get());
+	double alternativeMs = Milliseconds(start);
+
+	auto allSamples = [](const OverhangDetector& detector) {
+		std::vector<vec3> samples(detector.pointOverhang);
+		samples.insert(samples.end(), detector.edgeOverhang.begin(),
+			detector.edgeOverhang.end());
+		samples.insert(samples.end(), detector.faceOverhang.begin(),
+			detector.faceOverhang.end());
+		return samples;
+	};
+	std::vector<vec3> a = allSamples(reference);
+	std::vector<vec3> b = allSamples(alternative);
+
+	size_t unmatchedA, unmatchedB;
+	float distanceA, distanceB;
+	Match(a, b, tolerance, unmatchedA, distanceA);
+	Match(b, a, tolerance, unmatchedB, distanceB);
+
+	std::stringstream diff;
+	diff << a.size() << " vs " << b.size() << " samples, " <<
+		unmatchedA + unmatchedB << " unmatched within " << tolerance <<
+		" mm, max distance " << std::setprecision(3) <<
+		std::max(distanceA, distanceB) << " mm";
+	Add("overhang samples", shape, referenceMs, alternativeMs, diff.str(),
+		unmatchedA + unmatchedB == 0);
+}
+
+void Validator::Add(const std::string& check, const std::string& shape,
+	double referenceMs, double alternativeMs,
+	const std::string& diff, bool passed)
+{
+	Result result = { check, shape, referenceMs, alternativeMs, diff, passed };
+	results.push_back(result);
+	std::cout << check << " " << shape << " : " <<
+		(passed ? "pass" : "FAIL") << ", " << diff << std::endl;
+}
+
+void Validator::PrintReport(std::ostream& out) const
+{
+	out << std::left << std::setw(18) << "check" << std::setw(10) << "shape" <<
+		std::right << std::setw(14) << "reference ms" <<
+		std::setw(16) << "alternative ms" << std::setw(10) << "speedup" <<
+		"  result" << std::endl;
+	for (const Result& r : results) {
+		out << std::left << std::setw(18) << r.check << std::setw(10) <<
+			r.shape << std::right << std::fixed << std::setprecision(2) <<
+			std::setw(14) << r.referenceMs << std::setw(16) << r.alternativeMs <<
+			std::setw(9) << (r.alternativeMs > 0 ?
+				r.referenceMs / r.alternativeMs : 0) << "x" <<
+			std::defaultfloat << "  " << (r.passed ? "pass" : "FAIL") <<
+			"  " << r.diff << std::endl;
+	}
+}
\ No newline at end of file
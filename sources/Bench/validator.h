@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <model3d.h>
+#include <glcontext.h>
+
+struct ValidateConfig {
+	// empty runs every check
+	std::vector<std::string> checks;
+	std::vector<std::string> shapes;
+	int triangles;
+	float footprint;
+	int layers;
+	unsigned seed;
+
+	// share of foreground pixels the contour slices may differ in
+	float sliceTolerance;
+	// largest distance between matched overhang samples, in mm; zero uses
+	// the sampling resolution
+	float sampleTolerance;
+};
+
+// Runs the reference paths next to the alternative engines on generated
+// meshes and diffs their outputs:
+//   support points   boost Dijkstra vs the column graph, exact
+//   incremental      full search vs IncrementalSupport after an edit, exact
+//   progressive      full search vs emitted points: unbounded, cancelled
+//                    and out of budget, exact prefix
+//   anchor maps      dilation loop vs frontier swallow, exact per layer
+//   slices           per-pixel LDNI Slice vs the contour slicer, tolerance
+//   overhang samples GL rasterizer vs barycentric sampler, tolerance
+class Validator
+{
+public:
+	struct Result {
+		std::string check, shape;
+		double referenceMs, alternativeMs;
+		std::string diff;
+		bool passed;
+	};
+
+	Validator(const ValidateConfig& config_)
+		: config(config_), gl("Validator") {}
+
+	// returns true if every check passed
+	bool Run();
+	void PrintReport(std::ostream&) const;
+
+private:
+	bool Enabled(const std::string& check) const;
+	std::unique_ptr<Model3D> GenerateModel(const std::string& shape) const;
+
+	void CheckSupportPoints(const std::string& shape);
+	void CheckIncremental(const std::string& shape);
+	void CheckProgressive(const std::string& shape);
+	void CheckSlices(const std::string& shape);
+	void CheckAnchorMaps(const std::string& shape);
+	void CheckOverhangSamples(const std::string& shape);
+
+	void Add(const std::string& check, const std::string& shape,
+		double referenceMs, double alternativeMs,
+		const std::string& diff, bool passed);
+
+private:
+	ValidateConfig config;
+	std::vector<Result> results;
+	GLContext gl;
+};
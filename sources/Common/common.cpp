@@ -1,2 +1,2 @@
-#include "aabb.h"
+#include "aabb.h"
 #include "model3d.h"
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+
+// Appends the per-thread outputs of a parallel loop to result in thread
+// order and frees them. Only after a schedule(static) loop is that the
+// order of the input; other schedules give a different order every run.
+template<typename T>
+void Concatenate(std::vector<std::vector<T>>& local, std::vector<T>& result)
+{
+	size_t total = result.size();
+	for (size_t i = 0; i < local.size(); i++)
+		total += local[i].size();
+
+	result.reserve(total);
+	for (size_t i = 0; i < local.size(); i++) {
+		result.insert(result.end(), local[i].begin(), local[i].end());
+		std::vector<T>().swap(local[i]);
+	}
+}
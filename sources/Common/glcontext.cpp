@@ -0,0 +1,294 @@
+#include "glcontext.h"
+#include "pipelinestage.h"
+
+#ifndef NO_EGL
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#include <GLFW/glfw3.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	thread_local GLContext* current = 0;
+
+#ifndef NO_EGL
+	bool HasExtension(const char* extensions, const char* name)
+	{
+		if (!extensions)
+			return false;
+
+		size_t length = strlen(name);
+		for (const char* p = strstr(extensions, name); p;
+			p = strstr(p + length, name)) {
+			if ((p == extensions || p[-1] == ' ') &&
+				(p[length] == ' ' || p[length] == '\0'))
+				return true;
+		}
+		return false;
+	}
+
+	// an initialized display of the platform, or EGL_NO_DISPLAY
+	EGLDisplay OpenDisplay(PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay,
+		EGLenum platform, void* native)
+	{
+		EGLDisplay display = getPlatformDisplay(platform, native, 0);
+		if (display == EGL_NO_DISPLAY)
+			return EGL_NO_DISPLAY;
+
+		EGLint major, minor;
+		if (!eglInitialize(display, &major, &minor))
+			return EGL_NO_DISPLAY;
+		return display;
+	}
+#endif
+}
+
+GLContext::GLContext(const char* title)
+	: GLContext()
+{
+	Status status = Init(title);
+	if (!status.IsOk()) {
+		std::cerr << status.Message() << std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+std::unique_ptr<GLContext> GLContext::Create(const char* title, Status& status)
+{
+	std::unique_ptr<GLContext> context(new GLContext);
+	status = context->Init(title);
+	if (!status.IsOk())
+		return 0;
+	return context;
+}
+
+Status GLContext::Init(const char* title)
+{
+	PIPELINE_STAGE("create GL context");
+
+	Status status = InitEGL();
+	if (status.IsOk())
+		return status;
+
+	Status fallback = InitGLFW(title);
+	if (!fallback.IsOk())
+		return Status(Status::GL_ERROR, status.Message() + ", " +
+			fallback.Message());
+	return fallback;
+}
+
+Status GLContext::InitEGL()
+{
+#ifdef NO_EGL
+	return Status(Status::UNSUPPORTED, "Built without EGL");
+#else
+	PROFILE_ZONE("EGL context");
+
+	const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+			"eglGetPlatformDisplayEXT");
+	if (!getPlatformDisplay ||
+		!HasExtension(clientExtensions, "EGL_EXT_platform_base"))
+		return Status(Status::GL_ERROR, "EGL has no platform displays");
+
+	// surfaceless is what Mesa offers, llvmpipe included; the device
+	// platform is what the proprietary drivers offer
+	EGLDisplay display = EGL_NO_DISPLAY;
+	if (HasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+		display = OpenDisplay(getPlatformDisplay, EGL_PLATFORM_SURFACELESS_MESA,
+			EGL_DEFAULT_DISPLAY);
+		backend = EGL_SURFACELESS;
+	}
+	PFNEGLQUERYDEVICESEXTPROC queryDevices =
+		(PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+	if (display == EGL_NO_DISPLAY && queryDevices &&
+		HasExtension(clientExtensions, "EGL_EXT_platform_device")) {
+		EGLDeviceEXT devices[16];
+		EGLint nDevices = 0;
+		if (!queryDevices(16, devices, &nDevices))
+			nDevices = 0;
+		for (int i = 0; i < nDevices && display == EGL_NO_DISPLAY; i++)
+			display = OpenDisplay(getPlatformDisplay, EGL_PLATFORM_DEVICE_EXT,
+				devices[i]);
+		backend = EGL_DEVICE;
+	}
+	if (display == EGL_NO_DISPLAY)
+		return Status(Status::GL_ERROR, "No EGL display without a window system");
+
+	// there is no surface at all, the framebuffers are the recipes' own
+	if (!HasExtension(eglQueryString(display, EGL_EXTENSIONS),
+		"EGL_KHR_surfaceless_context"))
+		return Status(Status::GL_ERROR, "EGL has no surfaceless contexts");
+
+	EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint nConfigs = 0;
+	if (!eglChooseConfig(display, configAttribs, &config, 1, &nConfigs) ||
+		nConfigs == 0)
+		return Status(Status::GL_ERROR, "No EGL config renders OpenGL");
+
+	EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	if (!eglBindAPI(EGL_OPENGL_API))
+		return Status(Status::GL_ERROR, "EGL does not support OpenGL");
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+		contextAttribs);
+	if (context == EGL_NO_CONTEXT)
+		return Status(Status::GL_ERROR,
+			"Unable to create an OpenGL 4.3 context on EGL");
+
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+	bool loaded = gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (!loaded) {
+		eglDestroyContext(display, context);
+		return Status(Status::GL_ERROR, "Unable to load the OpenGL functions");
+	}
+
+	eglDisplay = display;
+	eglContext = context;
+	return Status();
+#endif
+}
+
+Status GLContext::InitGLFW(const char* title)
+{
+	PROFILE_ZONE("GLFW window");
+
+	if (!glfwInit())
+		return Status(Status::GL_ERROR, "Unable to initialize GLFW");
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	window = glfwCreateWindow(100, 100, title, 0, 0);
+	if (!window)
+		return Status(Status::GL_ERROR, "Unable to create an OpenGL 4.3 context");
+
+	backend = GLFW_WINDOW;
+	glfwMakeContextCurrent(window);
+	bool loaded = gladLoadGL();
+	glfwMakeContextCurrent(0);
+	if (!loaded)
+		return Status(Status::GL_ERROR, "Unable to load the OpenGL functions");
+	return Status();
+}
+
+GLContext::~GLContext()
+{
+	// the programs are deleted in the context that created them
+	if (!programs.empty()) {
+		MakeCurrent();
+		programs.clear();
+		Release();
+	}
+	if (window)
+		glfwDestroyWindow(window);
+#ifndef NO_EGL
+	// the display stays initialized, every context of the process shares it
+	if (eglContext)
+		eglDestroyContext((EGLDisplay)eglDisplay, (EGLContext)eglContext);
+#endif
+}
+
+void GLContext::MakeCurrent()
+{
+	if (window)
+		glfwMakeContextCurrent(window);
+#ifndef NO_EGL
+	else {
+		// the bound API is per thread, and a job may run on any of them
+		eglBindAPI(EGL_OPENGL_API);
+		eglMakeCurrent((EGLDisplay)eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+			(EGLContext)eglContext);
+	}
+#endif
+	current = this;
+}
+
+void GLContext::Release()
+{
+	if (window)
+		glfwMakeContextCurrent(0);
+#ifndef NO_EGL
+	else {
+		eglBindAPI(EGL_OPENGL_API);
+		eglMakeCurrent((EGLDisplay)eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+			EGL_NO_CONTEXT);
+	}
+#endif
+	current = 0;
+}
+
+const char* GLContext::BackendName(Backend backend)
+{
+	switch (backend) {
+	case EGL_SURFACELESS:
+		return "EGL surfaceless";
+	case EGL_DEVICE:
+		return "EGL device";
+	default:
+		return "GLFW window";
+	}
+}
+
+GLContext* GLContext::Current()
+{
+	return current;
+}
+
+GLSLProgram* GLContext::LoadProgram(const std::string& vertexPath,
+	const std::string& fragmentPath)
+{
+	GLContext* context = Current();
+	if (!context) {
+		std::cerr << "No current context to load " << vertexPath << std::endl;
+		return 0;
+	}
+
+	auto cached = context->programs.find(std::make_pair(vertexPath, fragmentPath));
+	if (cached != context->programs.end() && cached->second)
+		return cached->second.get();
+
+	ProgramSource source;
+	if (!source.Read(vertexPath, fragmentPath))
+		return 0;
+	return LoadProgram(source);
+}
+
+GLSLProgram* GLContext::LoadProgram(const ProgramSource& source)
+{
+	GLContext* context = Current();
+	if (!context) {
+		std::cerr << "No current context to load " << source.vertexPath <<
+			std::endl;
+		return 0;
+	}
+
+	std::unique_ptr<GLSLProgram>& program = context->programs[
+		std::make_pair(source.vertexPath, source.fragmentPath)];
+	if (!program) {
+		std::unique_ptr<GLSLProgram> compiled(new GLSLProgram);
+		if (!compiled->CompileSource(source.vertex, GLSLShader::VERTEX) ||
+			!compiled->CompileSource(source.fragment, GLSLShader::FRAGMENT))
+			return 0;
+		compiled->Link();
+		program = std::move(compiled);
+	}
+	return program.get();
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include "glslprogram.h"
+#include "status.h"
+
+struct GLFWwindow;
+
+// OpenGL 4.3 core context without a window. EGL is tried first, on the
+// Mesa surfaceless platform and then on the devices of EGL_EXT_platform_device,
+// so render hosts need no display server; a hidden GLFW window is the
+// fallback, and the only backend when built with NO_EGL. A context is
+// current on at most one thread, so a job makes it current for as long as
+// it runs.
+class GLContext
+{
+public:
+	enum Backend {
+		EGL_SURFACELESS,
+		EGL_DEVICE,
+		GLFW_WINDOW
+	};
+
+	// exits if no context can be created, for the command line tools
+	GLContext(const char* title);
+	~GLContext();
+
+	// null and a failed status instead of exiting
+	static std::unique_ptr<GLContext> Create(const char* title, Status&);
+
+	void MakeCurrent();
+	void Release();
+
+	Backend GetBackend() const {
+		return backend;
+	}
+	static const char* BackendName(Backend);
+
+	// the context made current on the calling thread, or null
+	static GLContext* Current();
+
+	// Linked program of the current context. Programs are compiled on the
+	// first request and kept until the context is destroyed, so later
+	// jobs on the same context skip the shader compilation. Null if there
+	// is no current context or a shader cannot be read.
+	static GLSLProgram* LoadProgram(const std::string& vertexPath,
+		const std::string& fragmentPath);
+	// the same from sources read ahead, cached under their paths
+	static GLSLProgram* LoadProgram(const ProgramSource&);
+
+private:
+	GLContext() : backend(GLFW_WINDOW), window(0), eglDisplay(0),
+		eglContext(0) {}
+	GLContext(const GLContext&) = delete;
+	GLContext& operator=(const GLContext&) = delete;
+
+	Status Init(const char* title);
+	Status InitEGL();
+	Status InitGLFW(const char* title);
+
+	Backend backend;
+	GLFWwindow* window;
+	// EGLDisplay and EGLContext, kept opaque so users of the header do not
+	// pull in the EGL platform headers
+	void* eglDisplay;
+	void* eglContext;
+	std::map<std::pair<std::string, std::string>,
+		std::unique_ptr<GLSLProgram>> programs;
+};
+
+class ContextScope
+{
+public:
+	ContextScope(GLContext& context_) : context(&context_) {
+		context->MakeCurrent();
+	}
+	// does nothing for null, for jobs that may run without a context
+	ContextScope(GLContext* context_) : context(context_) {
+		if (context)
+			context->MakeCurrent();
+	}
+	~ContextScope() {
+		if (context)
+			context->Release();
+	}
+
+private:
+	GLContext* context;
+};
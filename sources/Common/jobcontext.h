@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cmath>
+#include "params.h"
+
+// Everything a job reads while it runs: its parameters, frozen when the
+// job starts, and the constants the kernels derive from them. Generators
+// keep a reference, so the context has to outlive them. Jobs with their
+// own contexts can run side by side.
+class JobContext
+{
+public:
+	JobContext(const Params& params_)
+		: params(params_),
+		halfSliceThickness(params_.sliceThickness * 0.5),
+		coverage(params_.effectiveRadius / params_.pixelWidth),
+		cosOverhangAngle(cos(params_.overhangAngle)),
+		overhangWeightScale(1.0f / (3.141592f / 2.0f - params_.overhangAngle)),
+		tanSupportConeAngle(tan(params_.supportConeAngle)) {}
+
+	// the machine layer a height is printed in
+	int MachineLayer(float z) const {
+		return ceil((z - halfSliceThickness) / params.sliceThickness);
+	}
+
+	const Params params;
+
+	const double halfSliceThickness;
+	// effective radius in pixels
+	const float coverage;
+	const float cosOverhangAngle;
+	// penalty per radian of an edge steeper than the overhang angle
+	const float overhangWeightScale;
+	const float tanSupportConeAngle;
+};
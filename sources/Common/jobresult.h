@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <opencv2/opencv.hpp>
+
+// Output of one job for callers that keep it. Each recipe fills in its
+// own part and leaves the rest empty.
+struct JobResult {
+	JobResult() : covered(1) {}
+
+	// FreeFloating; covered is the fraction of the floatable vertices the
+	// points cover, below 1 only when a progressive search stopped early
+	std::vector<glm::vec3> supportPoints;
+	float covered;
+
+	// Huang, one map per layer from the top down
+	std::vector<cv::Mat> anchorMaps;
+
+	// Vanek; the segments of the support tree are stored as point pairs
+	std::vector<glm::vec3> overhangSamples;
+	std::vector<glm::vec3> supportSegments;
+};
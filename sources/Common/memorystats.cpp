@@ -0,0 +1,289 @@
+#include "memorystats.h"
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+
+std::unique_ptr<MemoryStats> MemoryStats::instance;
+std::once_flag MemoryStats::flag;
+
+namespace
+{
+	std::atomic<long long> liveBytes(0);
+	std::atomic<long long> peakBytes(0);
+	std::atomic<long long> allocationCount(0);
+
+	double Megabytes(double bytes)
+	{
+		return bytes / (1024.0 * 1024.0);
+	}
+}
+
+#ifdef COUNT_ALLOCATIONS
+namespace
+{
+	// the size is kept in front of the block so that delete can subtract
+	// it; over-aligned allocations bypass these and are not counted
+	const size_t header = alignof(std::max_align_t);
+
+	void* CountedAlloc(size_t size)
+	{
+		char* p = (char*)std::malloc(size + header);
+		if (!p)
+			return 0;
+		*(size_t*)p = size;
+
+		long long live = liveBytes.fetch_add(size,
+			std::memory_order_relaxed) + size;
+		long long peak = peakBytes.load(std::memory_order_relaxed);
+		while (live > peak && !peakBytes.compare_exchange_weak(peak, live,
+			std::memory_order_relaxed));
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		return p + header;
+	}
+
+	void CountedFree(void* ptr)
+	{
+		if (!ptr)
+			return;
+		char* p = (char*)ptr - header;
+		liveBytes.fetch_sub(*(size_t*)p, std::memory_order_relaxed);
+		std::free(p);
+	}
+}
+
+void* operator new(size_t size)
+{
+	void* p = CountedAlloc(size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+void* operator new[](size_t size)
+{
+	void* p = CountedAlloc(size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAlloc(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAlloc(size);
+}
+void operator delete(void* p) noexcept
+{
+	CountedFree(p);
+}
+void operator delete[](void* p) noexcept
+{
+	CountedFree(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+	CountedFree(p);
+}
+void operator delete[](void* p, size_t) noexcept
+{
+	CountedFree(p);
+}
+#endif
+
+MemoryStats& MemoryStats::GetInstance()
+{
+	std::call_once(flag, [] {instance.reset(new MemoryStats); });
+	return *instance;
+}
+
+void MemoryStats::Start()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	stages.clear();
+	open.clear();
+	counters.clear();
+	exactPeaks = true;
+	processPeak = 0;
+}
+
+void MemoryStats::BeginStage(const char* name)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	FoldPeaks();
+
+	Stage stage;
+	stage.name = name;
+	stage.depth = open.size();
+	stage.rssBegin = CurrentRSS();
+	stage.rssEnd = 0;
+	stage.allocBegin = GetAllocations().live;
+	stage.allocEnd = 0;
+	stage.peakRSS = stage.rssBegin;
+	stage.peakAlloc = stage.allocBegin;
+	stages.push_back(stage);
+	open.push_back(stages.size() - 1);
+
+	if (!ResetPeak())
+		exactPeaks = false;
+	ResetAllocationPeak();
+}
+
+void MemoryStats::EndStage()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (open.empty())
+		return;
+
+	FoldPeaks();
+	Stage& stage = stages[open.back()];
+	stage.rssEnd = CurrentRSS();
+	stage.allocEnd = GetAllocations().live;
+	open.pop_back();
+}
+
+void MemoryStats::Track(const char* name, size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t& counter = counters[name];
+	counter = std::max(counter, bytes);
+}
+
+size_t MemoryStats::CurrentRSS()
+{
+	return ReadStatus("VmRSS:");
+}
+
+size_t MemoryStats::PeakRSS()
+{
+	return ReadStatus("VmHWM:");
+}
+
+MemoryStats::Allocations MemoryStats::GetAllocations()
+{
+	Allocations allocations;
+	allocations.live = liveBytes.load(std::memory_order_relaxed);
+	allocations.peak = peakBytes.load(std::memory_order_relaxed);
+	allocations.count = allocationCount.load(std::memory_order_relaxed);
+	return allocations;
+}
+
+bool MemoryStats::WriteReport(const std::string& path)
+{
+	std::ofstream out(path);
+	if (!out) {
+		std::cerr << "Unable to write memory report to " << path << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	out << "{\n";
+	out << "\"peakRSS\":" << std::max(processPeak, PeakRSS()) << ",\n";
+	out << "\"exactStagePeaks\":" << (exactPeaks ? "true" : "false") << ",\n";
+#ifdef COUNT_ALLOCATIONS
+	Allocations allocations = GetAllocations();
+	out << "\"allocations\":{\"live\":" << allocations.live <<
+		",\"peak\":" << allocations.peak <<
+		",\"count\":" << allocations.count << "},\n";
+#endif
+	out << "\"stages\":[";
+	for (size_t i = 0; i < stages.size(); i++) {
+		const Stage& s = stages[i];
+		out << (i ? ",\n" : "\n") << "{\"name\":\"" << s.name <<
+			"\",\"depth\":" << s.depth <<
+			",\"rssBegin\":" << s.rssBegin <<
+			",\"rssEnd\":" << s.rssEnd <<
+			",\"peakRSS\":" << s.peakRSS;
+#ifdef COUNT_ALLOCATIONS
+		out << ",\"allocBegin\":" << s.allocBegin <<
+			",\"allocEnd\":" << s.allocEnd <<
+			",\"peakAlloc\":" << s.peakAlloc;
+#endif
+		out << "}";
+	}
+	out << "\n],\n";
+	out << "\"counters\":{";
+	bool first = true;
+	for (const auto& counter : counters) {
+		out << (first ? "\n" : ",\n") << "\"" << counter.first << "\":" <<
+			counter.second;
+		first = false;
+	}
+	out << "\n}\n}\n";
+
+	return true;
+}
+
+void MemoryStats::PrintSummary(std::ostream& out)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::ios::fmtflags flags = out.flags();
+	out << std::left << std::setw(44) << "stage" << std::right <<
+		std::setw(12) << "begin MB" << std::setw(12) << "end MB" <<
+		std::setw(12) << "peak MB" << "\n";
+	out << std::fixed << std::setprecision(1);
+	for (const Stage& s : stages) {
+		std::string name = std::string(2 * s.depth, ' ') + s.name;
+		out << std::left << std::setw(44) << name << std::right <<
+			std::setw(12) << Megabytes(s.rssBegin) <<
+			std::setw(12) << Megabytes(s.rssEnd) <<
+			std::setw(12) << Megabytes(s.peakRSS) << "\n";
+	}
+	if (!exactPeaks)
+		out << "(stage peaks are process wide, clear_refs is not writable)\n";
+
+	for (const auto& counter : counters)
+		out << std::left << std::setw(44) << counter.first << std::right <<
+			std::setw(12) << Megabytes(counter.second) << "\n";
+	out << std::left << std::setw(44) << "peak RSS" << std::right <<
+		std::setw(12) << Megabytes(std::max(processPeak, PeakRSS())) << "\n";
+	out.flags(flags);
+}
+
+size_t MemoryStats::ReadStatus(const char* key)
+{
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	size_t len = strlen(key);
+	while (std::getline(status, line)) {
+		if (line.compare(0, len, key) == 0)
+			return std::strtoull(line.c_str() + len, 0, 10) * 1024;
+	}
+	return 0;
+}
+
+bool MemoryStats::ResetPeak()
+{
+	// writing 5 resets VmHWM to the current RSS
+	std::ofstream clearRefs("/proc/self/clear_refs");
+	if (!clearRefs)
+		return false;
+	clearRefs << "5";
+	clearRefs.flush();
+	return clearRefs.good();
+}
+
+void MemoryStats::ResetAllocationPeak()
+{
+	peakBytes.store(liveBytes.load(std::memory_order_relaxed),
+		std::memory_order_relaxed);
+}
+
+void MemoryStats::FoldPeaks()
+{
+	// the peak since the last reset belongs to every stage still open
+	size_t peakRSS = PeakRSS();
+	long long peakAlloc = GetAllocations().peak;
+	processPeak = std::max(processPeak, peakRSS);
+	for (int i : open) {
+		stages[i].peakRSS = std::max(stages[i].peakRSS, peakRSS);
+		stages[i].peakAlloc = std::max(stages[i].peakAlloc, peakAlloc);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <map>
+#include <string>
+#include <ostream>
+#include <cstddef>
+
+// Per-stage resident memory and byte counters for the large containers.
+// Stage peaks come from VmHWM, which is reset at every stage boundary
+// through /proc/self/clear_refs; when the kernel does not allow that the
+// peaks are process wide and the report says so. Building with
+// COUNT_ALLOCATIONS also counts the bytes that go through operator new.
+class MemoryStats
+{
+public:
+	struct Allocations {
+		long long live, peak, count;
+	};
+
+	static MemoryStats& GetInstance();
+
+	// clears stages and counters
+	void Start();
+
+	void BeginStage(const char* name);
+	void EndStage();
+
+	// records the size of a named container, keeping the largest value
+	void Track(const char* name, size_t bytes);
+
+	static size_t CurrentRSS();
+	static size_t PeakRSS();
+	static Allocations GetAllocations();
+
+	bool WriteReport(const std::string& path);
+	void PrintSummary(std::ostream&);
+
+private:
+	struct Stage {
+		std::string name;
+		int depth;
+		size_t rssBegin, rssEnd, peakRSS;
+		long long allocBegin, allocEnd, peakAlloc;
+	};
+
+	static size_t ReadStatus(const char* key);
+	static bool ResetPeak();
+	static void ResetAllocationPeak();
+	void FoldPeaks();
+
+private:
+	MemoryStats() : exactPeaks(true), processPeak(0) {}
+
+	static std::unique_ptr<MemoryStats> instance;
+	static std::once_flag flag;
+
+	std::mutex mutex;
+	std::vector<Stage> stages;
+	std::vector<int> open;
+	std::map<std::string, size_t> counters;
+	bool exactPeaks;
+	// VmHWM only covers the time since the last reset
+	size_t processPeak;
+};
+
+class MemoryStage
+{
+public:
+	MemoryStage(const char* name) {
+		MemoryStats::GetInstance().BeginStage(name);
+	}
+	~MemoryStage() {
+		MemoryStats::GetInstance().EndStage();
+	}
+
+private:
+	MemoryStage(const MemoryStage&) {}
+	MemoryStage& operator=(const MemoryStage&) {
+		return *this;
+	}
+};
+
+#define MEMORY_CONCAT_(a, b) a##b
+#define MEMORY_CONCAT(a, b) MEMORY_CONCAT_(a, b)
+
+#ifdef NO_MEMORY_STATS
+#define MEMORY_STAGE(name)
+#define MEMORY_TRACK(name, bytes)
+#else
+#define MEMORY_STAGE(name) \
+	MemoryStage MEMORY_CONCAT(memoryStage, __LINE__)(name)
+#define MEMORY_TRACK(name, bytes) \
+	MemoryStats::GetInstance().Track(name, bytes)
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <utility>
+#include <algorithm>
+
+// Least recently used meshes of a warm app, together with whatever the
+// recipe derived from them. Entries own GL objects, so the owner clears
+// the cache while its context is current. A capacity of zero, the
+// default, keeps nothing.
+template<typename Entry>
+class MeshCache
+{
+public:
+	MeshCache() : capacity(0), hits(0), misses(0) {}
+
+	void SetCapacity(size_t capacity_) {
+		capacity = capacity_;
+		Trim(capacity);
+	}
+
+	// the entry moves to the front; null on a miss
+	Entry* Find(const std::string& key) {
+		for (auto it = entries.begin(); it != entries.end(); it++) {
+			if (it->first == key) {
+				entries.splice(entries.begin(), entries, it);
+				hits++;
+				return &entries.front().second;
+			}
+		}
+		misses++;
+		return 0;
+	}
+
+	// evicts the least recently used entries beyond the capacity, but
+	// never the new one, which stays valid until the next Insert
+	Entry& Insert(const std::string& key, Entry entry) {
+		entries.emplace_front(key, std::move(entry));
+		Trim(std::max<size_t>(capacity, 1));
+		return entries.front().second;
+	}
+
+	void Clear() {
+		entries.clear();
+	}
+
+	size_t Capacity() const {
+		return capacity;
+	}
+	size_t Hits() const {
+		return hits;
+	}
+	size_t Misses() const {
+		return misses;
+	}
+
+private:
+	void Trim(size_t keep) {
+		while (entries.size() > keep)
+			entries.pop_back();
+	}
+
+private:
+	std::list<std::pair<std::string, Entry>> entries;
+	size_t capacity;
+	size_t hits, misses;
+};
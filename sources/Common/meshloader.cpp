@@ -0,0 +1,455 @@
+#include "meshloader.h"
+#include "model3d.h"
+#include "shardsort.h"
+
+#include <omp.h>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using glm::vec3;
+using glm::uvec3;
+
+namespace {
+	const GLuint EMPTY_SLOT = 0xffffffff;
+
+	inline uint32_t FloatBits(float f)
+	{
+		if (f == 0.0f)
+			f = 0.0f;
+		uint32_t bits;
+		memcpy(&bits, &f, sizeof(bits));
+		return bits;
+	}
+
+	inline uint64_t HashPosition(const vec3& p)
+	{
+		uint64_t h = FloatBits(p.x);
+		h = h * 0x9E3779B97F4A7C15ull ^ FloatBits(p.y);
+		h = h * 0x9E3779B97F4A7C15ull ^ FloatBits(p.z);
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	inline bool SamePosition(const vec3& a, const vec3& b)
+	{
+		return FloatBits(a.x) == FloatBits(b.x) &&
+			FloatBits(a.y) == FloatBits(b.y) &&
+			FloatBits(a.z) == FloatBits(b.z);
+	}
+
+	inline vec3 ReadVec3(const char* p)
+	{
+		float v[3];
+		memcpy(v, p, sizeof(v));
+		return vec3(v[0], v[1], v[2]);
+	}
+
+	struct Shard {
+		std::vector<vec3> positions;
+		AABB aabb;
+	};
+
+	enum PLYType {
+		PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16,
+		PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64, PLY_INVALID
+	};
+
+	struct PLYProperty {
+		std::string name;
+		PLYType type;
+		PLYType countType;
+		bool list;
+	};
+
+	struct PLYElement {
+		std::string name;
+		size_t count;
+		std::vector<PLYProperty> props;
+	};
+
+	PLYType ParsePLYType(const std::string& name)
+	{
+		if (name == "char" || name == "int8") return PLY_INT8;
+		if (name == "uchar" || name == "uint8") return PLY_UINT8;
+		if (name == "short" || name == "int16") return PLY_INT16;
+		if (name == "ushort" || name == "uint16") return PLY_UINT16;
+		if (name == "int" || name == "int32") return PLY_INT32;
+		if (name == "uint" || name == "uint32") return PLY_UINT32;
+		if (name == "float" || name == "float32") return PLY_FLOAT32;
+		if (name == "double" || name == "float64") return PLY_FLOAT64;
+		return PLY_INVALID;
+	}
+
+	int PLYTypeSize(PLYType type)
+	{
+		static const int sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+		return sizes[type];
+	}
+
+	double ReadPLYValue(const char* p, PLYType type)
+	{
+		switch (type) {
+		case PLY_INT8: { int8_t v; memcpy(&v, p, 1); return v; }
+		case PLY_UINT8: { uint8_t v; memcpy(&v, p, 1); return v; }
+		case PLY_INT16: { int16_t v; memcpy(&v, p, 2); return v; }
+		case PLY_UINT16: { uint16_t v; memcpy(&v, p, 2); return v; }
+		case PLY_INT32: { int32_t v; memcpy(&v, p, 4); return v; }
+		case PLY_UINT32: { uint32_t v; memcpy(&v, p, 4); return v; }
+		case PLY_FLOAT32: { float v; memcpy(&v, p, 4); return v; }
+		case PLY_FLOAT64: { double v; memcpy(&v, p, 8); return v; }
+		default: return 0;
+		}
+	}
+
+	class PLYReader
+	{
+	public:
+		PLYReader(const char* begin_, const char* end_, bool ascii_)
+			: cur(begin_), end(end_), ascii(ascii_) {}
+
+		bool Read(PLYType type, double& val) {
+			if (ascii)
+				return ReadToken(val);
+
+			int size = PLYTypeSize(type);
+			if (end - cur < size)
+				return false;
+			val = ReadPLYValue(cur, type);
+			cur += size;
+			return true;
+		}
+
+		const char* Position() const {
+			return cur;
+		}
+		size_t Remaining() const {
+			return end - cur;
+		}
+		void Advance(size_t n) {
+			cur += n;
+		}
+
+	private:
+		bool ReadToken(double& val) {
+			while (cur < end && isspace((unsigned char)*cur))
+				cur++;
+			const char* first = cur;
+			while (cur < end && !isspace((unsigned char)*cur))
+				cur++;
+			if (cur == first || cur - first > 63)
+				return false;
+
+			char token[64];
+			memcpy(token, first, cur - first);
+			token[cur - first] = '\0';
+			val = strtod(token, 0);
+			return true;
+		}
+
+		const char* cur;
+		const char* end;
+		bool ascii;
+	};
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	void* mapped = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED)
+		return false;
+
+	madvise(mapped, st.st_size, MADV_WILLNEED);
+	data = static_cast<const char*>(mapped);
+	size = st.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data) {
+		munmap(const_cast<char*>(data), size);
+		data = 0;
+		size = 0;
+	}
+}
+
+bool MeshLoader::Load(const std::string& path, MeshData& meshData,
+	AABB& aabb)
+{
+	std::string ext = path.substr(path.find_last_of('.') + 1);
+	for (char& c : ext)
+		c = tolower(c);
+	if (ext != "stl" && ext != "ply")
+		return false;
+
+	MappedFile file;
+	if (!file.Open(path))
+		return false;
+
+	if (ext == "stl")
+		return LoadSTL(file.Data(), file.Size(), meshData, aabb);
+	else
+		return LoadPLY(file.Data(), file.Size(), meshData, aabb);
+}
+
+bool MeshLoader::Load(const char* data, size_t size, MeshData& meshData,
+	AABB& aabb)
+{
+	static const char magic[] = "ply";
+	if (size >= 4 && std::equal(magic, magic + 3, data) &&
+		(data[3] == '\n' || data[3] == '\r'))
+		return LoadPLY(data, size, meshData, aabb);
+	return LoadSTL(data, size, meshData, aabb);
+}
+
+bool MeshLoader::LoadSTL(const char* data, size_t size, MeshData& meshData,
+	AABB& aabb)
+{
+	const size_t headerSize = 80 + sizeof(uint32_t);
+	const size_t recordSize = 50;
+	if (size < headerSize)
+		return false;
+
+	uint32_t nTriangles;
+	memcpy(&nTriangles, data + 80, sizeof(nTriangles));
+	if (size != headerSize + recordSize * nTriangles)
+		return false;
+
+	const char* records = data + headerSize;
+	Weld(nTriangles, [records](size_t c) {
+		return ReadVec3(records + (c / 3) * 50 + 12 + (c % 3) * 12);
+		}, meshData, aabb);
+
+	return true;
+}
+
+bool MeshLoader::LoadPLY(const char* data, size_t size, MeshData& meshData,
+	AABB& aabb)
+{
+	const char* end = data + size;
+
+	static const char endHeader[] = "end_header";
+	const char* headerEnd = std::search(data, end,
+		endHeader, endHeader + sizeof(endHeader) - 1);
+	if (headerEnd == end)
+		return false;
+	const char* body = std::find(headerEnd, end, '\n');
+	if (body == end)
+		return false;
+	body++;
+
+	std::istringstream header(std::string(data, headerEnd));
+	std::string line, format;
+	std::vector<PLYElement> elements;
+	while (std::getline(header, line)) {
+		std::istringstream tokens(line);
+		std::string keyword;
+		tokens >> keyword;
+		if (keyword == "format")
+			tokens >> format;
+		else if (keyword == "element") {
+			PLYElement element;
+			tokens >> element.name >> element.count;
+			elements.push_back(element);
+		}
+		else if (keyword == "property" && !elements.empty()) {
+			PLYProperty prop;
+			std::string type;
+			tokens >> type;
+			prop.list = type == "list";
+			if (prop.list) {
+				std::string countType;
+				tokens >> countType >> type;
+				prop.countType = ParsePLYType(countType);
+				if (prop.countType == PLY_INVALID)
+					return false;
+			}
+			prop.type = ParsePLYType(type);
+			if (prop.type == PLY_INVALID)
+				return false;
+			tokens >> prop.name;
+			elements.back().props.push_back(prop);
+		}
+	}
+
+	bool ascii = format == "ascii";
+	if (!ascii && format != "binary_little_endian")
+		return false;
+
+	std::vector<vec3> positions;
+	std::vector<uvec3> triangles;
+	PLYReader reader(body, end, ascii);
+	for (const PLYElement& element : elements) {
+		int stride = 0;
+		bool fixedSize = true;
+		int coord[3] = { -1, -1, -1 };
+		for (int i = 0; i < element.props.size(); i++) {
+			const PLYProperty& prop = element.props[i];
+			fixedSize = fixedSize && !prop.list;
+			if (prop.name == "x") coord[0] = stride;
+			else if (prop.name == "y") coord[1] = stride;
+			else if (prop.name == "z") coord[2] = stride;
+			stride += PLYTypeSize(prop.type);
+		}
+
+		if (element.name == "vertex" && !ascii && fixedSize) {
+			if (coord[0] < 0 || coord[1] < 0 || coord[2] < 0 ||
+				reader.Remaining() < element.count * stride)
+				return false;
+
+			positions.resize(element.count);
+			const char* vertices = reader.Position();
+			PLYType types[3] = { PLY_FLOAT32, PLY_FLOAT32, PLY_FLOAT32 };
+			for (const PLYProperty& prop : element.props) {
+				if (prop.name == "x") types[0] = prop.type;
+				else if (prop.name == "y") types[1] = prop.type;
+				else if (prop.name == "z") types[2] = prop.type;
+			}
+#pragma omp parallel for
+			for (long long v = 0; v < (long long)element.count; v++) {
+				const char* p = vertices + v * stride;
+				for (int k = 0; k < 3; k++)
+					positions[v][k] = ReadPLYValue(p + coord[k], types[k]);
+			}
+			reader.Advance(element.count * stride);
+			continue;
+		}
+
+		for (size_t e = 0; e < element.count; e++) {
+			vec3 pos;
+			std::vector<GLuint> polygon;
+			for (const PLYProperty& prop : element.props) {
+				double val;
+				if (prop.list) {
+					double count;
+					if (!reader.Read(prop.countType, count))
+						return false;
+					for (int k = 0; k < (int)count; k++) {
+						if (!reader.Read(prop.type, val))
+							return false;
+						if (element.name == "face")
+							polygon.push_back((GLuint)val);
+					}
+					continue;
+				}
+
+				if (!reader.Read(prop.type, val))
+					return false;
+				if (prop.name == "x") pos.x = val;
+				else if (prop.name == "y") pos.y = val;
+				else if (prop.name == "z") pos.z = val;
+			}
+
+			if (element.name == "vertex")
+				positions.push_back(pos);
+			else if (element.name == "face") {
+				for (int k = 1; k + 1 < polygon.size(); k++)
+					triangles.push_back(
+						uvec3(polygon[0], polygon[k], polygon[k + 1]));
+			}
+		}
+	}
+
+	for (const uvec3& tri : triangles) {
+		if (tri[0] >= positions.size() || tri[1] >= positions.size() ||
+			tri[2] >= positions.size())
+			return false;
+	}
+
+	Weld(triangles.size(), [&](size_t c) {
+		return positions[triangles[c / 3][c % 3]];
+		}, meshData, aabb);
+
+	return true;
+}
+
+template<typename CornerFn>
+void MeshLoader::Weld(size_t nTriangles, CornerFn corner,
+	MeshData& meshData, AABB& aabb)
+{
+	size_t nCorners = nTriangles * 3;
+	int nShards = omp_get_max_threads() * 4;
+
+	// bucket the corners by the shard their position hashes to, so that
+	// every shard can be welded by one thread without locking
+	std::vector<GLuint> order;
+	std::vector<size_t> shardBegin;
+	ShardSort(nCorners, nShards, [&](size_t c) {
+		return HashPosition(corner(c)) % nShards;
+		}, order, shardBegin);
+
+	std::vector<GLuint>& indices = meshData.indices;
+	indices.resize(nCorners);
+	std::vector<Shard> shards(nShards);
+#pragma omp parallel for schedule(dynamic)
+	for (int s = 0; s < nShards; s++) {
+		Shard& shard = shards[s];
+		size_t begin = shardBegin[s];
+		size_t end = shardBegin[s + 1];
+
+		size_t capacity = 16;
+		while (capacity < 2 * (end - begin))
+			capacity <<= 1;
+		std::vector<GLuint> table(capacity, EMPTY_SLOT);
+
+		for (size_t k = begin; k < end; k++) {
+			GLuint c = order[k];
+			vec3 p = corner(c);
+			size_t slot = (HashPosition(p) >> 32) & (capacity - 1);
+			while (table[slot] != EMPTY_SLOT &&
+				!SamePosition(shard.positions[table[slot]], p))
+				slot = (slot + 1) & (capacity - 1);
+
+			if (table[slot] == EMPTY_SLOT) {
+				table[slot] = shard.positions.size();
+				shard.positions.push_back(p);
+				shard.aabb.Add(p);
+			}
+			indices[c] = table[slot];
+		}
+	}
+
+	std::vector<size_t> shardBase(nShards + 1, 0);
+	for (int s = 0; s < nShards; s++) {
+		shardBase[s + 1] = shardBase[s] + shards[s].positions.size();
+		aabb.Add(shards[s].aabb);
+	}
+
+	size_t nVertices = shardBase[nShards];
+	meshData.points.resize(nVertices * 3);
+#pragma omp parallel for schedule(dynamic)
+	for (int s = 0; s < nShards; s++) {
+		Shard& shard = shards[s];
+		size_t base = shardBase[s];
+		for (size_t v = 0; v < shard.positions.size(); v++) {
+			for (int k = 0; k < 3; k++)
+				meshData.points[(base + v) * 3 + k] = shard.positions[v][k];
+		}
+
+		for (size_t k = shardBegin[s]; k < shardBegin[s + 1]; k++)
+			indices[order[k]] += base;
+
+		std::vector<vec3>().swap(shard.positions);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "aabb.h"
+
+class MeshData;
+
+class MappedFile
+{
+public:
+	MappedFile() : data(0), size(0) {}
+	~MappedFile() {
+		Close();
+	}
+
+	bool Open(const std::string& path);
+	void Close();
+
+	const char* Data() const {
+		return data;
+	}
+	size_t Size() const {
+		return size;
+	}
+
+private:
+	MappedFile(const MappedFile&) {}
+	MappedFile& operator=(const MappedFile&) {
+		return *this;
+	}
+
+	const char* data;
+	size_t size;
+};
+
+// Native reader for binary STL and PLY. Returns false for anything else
+// so the caller can fall back to OpenMesh.
+class MeshLoader
+{
+public:
+	static bool Load(const std::string& path, MeshData& meshData, AABB& aabb);
+	// a file image already in memory; PLY is told apart by its magic
+	static bool Load(const char* data, size_t size, MeshData& meshData,
+		AABB& aabb);
+
+private:
+	static bool LoadSTL(const char* data, size_t size, MeshData&, AABB&);
+	static bool LoadPLY(const char* data, size_t size, MeshData&, AABB&);
+
+	template<typename CornerFn>
+	static void Weld(size_t nTriangles, CornerFn corner,
+		MeshData& meshData, AABB& aabb);
+};
@@ -0,0 +1,185 @@
+#include "metrics.h"
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+std::unique_ptr<Metrics> Metrics::instance;
+std::once_flag Metrics::flag;
+
+void Histogram::Record(long long v, long long n)
+{
+	if (v < 0)
+		v = 0;
+	buckets[Bucket(v)].fetch_add(n, std::memory_order_relaxed);
+	count.fetch_add(n, std::memory_order_relaxed);
+	sum.fetch_add(v * n, std::memory_order_relaxed);
+
+	long long current = max.load(std::memory_order_relaxed);
+	while (v > current && !max.compare_exchange_weak(current, v,
+		std::memory_order_relaxed));
+}
+
+void Histogram::RecordCounts(const std::vector<long long>& counts)
+{
+	for (size_t v = 0; v < counts.size(); v++) {
+		if (counts[v] > 0)
+			Record(v, counts[v]);
+	}
+}
+
+void Histogram::Reset()
+{
+	for (int b = 0; b < bucketCount; b++)
+		buckets[b].store(0, std::memory_order_relaxed);
+	count.store(0, std::memory_order_relaxed);
+	sum.store(0, std::memory_order_relaxed);
+	max.store(0, std::memory_order_relaxed);
+}
+
+long long Histogram::Percentile(double p) const
+{
+	long long total = Count();
+	if (total == 0)
+		return 0;
+
+	long long rank = (long long)(p * (total - 1));
+	long long seen = 0;
+	for (int b = 0; b < bucketCount; b++) {
+		seen += buckets[b].load(std::memory_order_relaxed);
+		if (seen > rank)
+			return std::min(BucketHigh(b), Max());
+	}
+	return Max();
+}
+
+void Histogram::WriteJSON(std::ostream& out) const
+{
+	out << "{\"count\":" << Count() << ",\"sum\":" << Sum() <<
+		",\"max\":" << Max() << ",\"buckets\":[";
+	bool first = true;
+	for (int b = 0; b < bucketCount; b++) {
+		long long n = buckets[b].load(std::memory_order_relaxed);
+		if (n == 0)
+			continue;
+		out << (first ? "" : ",") << "[" << BucketLow(b) << "," <<
+			BucketHigh(b) << "," << n << "]";
+		first = false;
+	}
+	out << "]}";
+}
+
+int Histogram::Bucket(long long v)
+{
+	if (v < linearBuckets)
+		return v;
+
+	int log = 6;
+	while (v >> (log + 1))
+		log++;
+	return linearBuckets + log - 6;
+}
+
+long long Histogram::BucketLow(int b)
+{
+	if (b < linearBuckets)
+		return b;
+	return 1ll << (b - linearBuckets + 6);
+}
+
+long long Histogram::BucketHigh(int b)
+{
+	if (b < linearBuckets)
+		return b;
+	return BucketLow(b) * 2 - 1;
+}
+
+Metrics& Metrics::GetInstance()
+{
+	std::call_once(flag, [] {instance.reset(new Metrics); });
+	return *instance;
+}
+
+void Metrics::Start()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& counter : counters)
+		counter.second->Reset();
+	for (auto& histogram : histograms)
+		histogram.second->Reset();
+}
+
+Counter& Metrics::GetCounter(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_ptr<Counter>& counter = counters[name];
+	if (!counter)
+		counter.reset(new Counter);
+	return *counter;
+}
+
+Histogram& Metrics::GetHistogram(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_ptr<Histogram>& histogram = histograms[name];
+	if (!histogram)
+		histogram.reset(new Histogram);
+	return *histogram;
+}
+
+void Metrics::PrintSummary(std::ostream& out)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::ios::fmtflags flags = out.flags();
+	out << std::left << std::setw(44) << "metric" << std::right <<
+		std::setw(14) << "value" << "\n";
+	for (const auto& counter : counters)
+		out << std::left << std::setw(44) << counter.first << std::right <<
+			std::setw(14) << counter.second->Value() << "\n";
+
+	if (!histograms.empty())
+		out << std::left << std::setw(44) << "histogram" << std::right <<
+			std::setw(14) << "count" << std::setw(12) << "mean" <<
+			std::setw(10) << "p50" << std::setw(10) << "p99" <<
+			std::setw(10) << "max" << "\n";
+	out << std::fixed << std::setprecision(2);
+	for (const auto& entry : histograms) {
+		const Histogram& h = *entry.second;
+		double mean = h.Count() ? (double)h.Sum() / h.Count() : 0.0;
+		out << std::left << std::setw(44) << entry.first << std::right <<
+			std::setw(14) << h.Count() << std::setw(12) << mean <<
+			std::setw(10) << h.Percentile(0.5) <<
+			std::setw(10) << h.Percentile(0.99) <<
+			std::setw(10) << h.Max() << "\n";
+	}
+	out.flags(flags);
+}
+
+bool Metrics::WriteReport(const std::string& path)
+{
+	std::ofstream out(path);
+	if (!out) {
+		std::cerr << "Unable to write metrics to " << path << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	out << "{\n\"counters\":{";
+	bool first = true;
+	for (const auto& counter : counters) {
+		out << (first ? "\n" : ",\n") << "\"" << counter.first << "\":" <<
+			counter.second->Value();
+		first = false;
+	}
+	out << "\n},\n\"histograms\":{";
+	first = true;
+	for (const auto& histogram : histograms) {
+		out << (first ? "\n" : ",\n") << "\"" << histogram.first << "\":";
+		histogram.second->WriteJSON(out);
+		first = false;
+	}
+	out << "\n}\n}\n";
+
+	return true;
+}
\ No newline at end of file
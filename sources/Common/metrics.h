@@ -0,0 +1,98 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+#include <ostream>
+
+// Counters and histograms filled by the pipeline stages. Updates are
+// relaxed atomics, so stages may record from parallel regions; look a
+// metric up once outside hot loops, since the lookup takes a lock.
+class Counter
+{
+public:
+	Counter() : value(0) {}
+
+	void Add(long long n) {
+		value.fetch_add(n, std::memory_order_relaxed);
+	}
+	void Max(long long n) {
+		long long current = value.load(std::memory_order_relaxed);
+		while (n > current && !value.compare_exchange_weak(current, n,
+			std::memory_order_relaxed));
+	}
+	void Reset() {
+		value.store(0, std::memory_order_relaxed);
+	}
+	long long Value() const {
+		return value.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<long long> value;
+};
+
+// Values below linearBuckets get a bucket of their own, larger ones share
+// power-of-two buckets.
+class Histogram
+{
+public:
+	static const int linearBuckets = 64;
+	static const int bucketCount = linearBuckets + 58;
+
+	Histogram() {
+		Reset();
+	}
+
+	void Record(long long v, long long count = 1);
+	// counts[v] is the number of occurrences of v
+	void RecordCounts(const std::vector<long long>& counts);
+	void Reset();
+
+	long long Count() const {
+		return count.load(std::memory_order_relaxed);
+	}
+	long long Sum() const {
+		return sum.load(std::memory_order_relaxed);
+	}
+	long long Max() const {
+		return max.load(std::memory_order_relaxed);
+	}
+	long long Percentile(double p) const;
+
+	void WriteJSON(std::ostream&) const;
+
+private:
+	static int Bucket(long long v);
+	static long long BucketLow(int b);
+	static long long BucketHigh(int b);
+
+	std::atomic<long long> buckets[bucketCount];
+	std::atomic<long long> count, sum, max;
+};
+
+class Metrics
+{
+public:
+	static Metrics& GetInstance();
+
+	// zeroes every metric; references handed out stay valid
+	void Start();
+
+	Counter& GetCounter(const std::string& name);
+	Histogram& GetHistogram(const std::string& name);
+
+	void PrintSummary(std::ostream&);
+	bool WriteReport(const std::string& path);
+
+private:
+	static std::unique_ptr<Metrics> instance;
+	static std::once_flag flag;
+
+	std::mutex mutex;
+	std::map<std::string, std::unique_ptr<Counter>> counters;
+	std::map<std::string, std::unique_ptr<Histogram>> histograms;
+};
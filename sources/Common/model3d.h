@@ -1,191 +1,311 @@
-#pragma once
-
-#include <glad/glad.h>
-#include <vector>
-#include <memory>
-#include <OpenMesh/Core/IO/MeshIO.hh>
-#include <OpenMesh/Core/Mesh/TriMesh_ArrayKernelT.hh>
-#include <OpenMesh/Core/Mesh/TriConnectivity.hh>
-
-#include "aabb.h"
-
-class OpenMeshData : public
-	OpenMesh::TriMesh_ArrayKernelT<OpenMesh::DefaultTraits>
-{
-public:
-	OpenMeshData() {
-		request_face_normals();
-		request_vertex_normals();
-		request_halfedge_normals();
-	}
-
-	bool Read(const std::string& path) {
-		OpenMesh::IO::Options ropt;
-		if (!OpenMesh::IO::read_mesh(*this, path, ropt)) {
-			std::cerr << "Error loading mesh from " <<
-				path << std::endl;
-			return false;
-		}
-
-		if (!ropt.check(OpenMesh::IO::Options::VertexNormal))
-			update_normals();
-	}
-	bool Write(const std::string& path) {
-		OpenMesh::IO::Options wopt;
-		if (!OpenMesh::IO::write_mesh(*this, path, wopt)) {
-			std::cerr << "Unable to write mesh to " <<
-				path << std::endl;
-			return false;
-		}
-
-		return true;
-	}
-};
-
-class GLMeshData
-{
-public:
-	GLMeshData() {}
-	GLMeshData(OpenMeshData& arg) {
-		for (OpenMeshData::VIter vit = arg.vertices_begin();
-			vit != arg.vertices_end();
-			vit++) {
-			OpenMeshData::Point p = arg.point(*vit);
-			OpenMeshData::Normal n = arg.normal(*vit);
-
-			for (int i = 0; i < 3; i++) {
-				points.push_back(p[i]);
-				normals.push_back(n[i]);
-			}
-		}
-
-		for (OpenMeshData::FIter fit = arg.faces_begin();
-			fit != arg.faces_end();
-			fit++) {
-			for (OpenMeshData::FVIter fvit = arg.fv_begin(*fit);
-				fvit != arg.fv_end(*fit);
-				fvit++)
-				indices.push_back(fvit->idx());
-		}
-	}
-	~GLMeshData() {}
-
-	void Clear() {
-		points.clear();
-		normals.clear();
-		indices.clear();
-	}
-
-	std::vector<GLfloat> points, normals;
-	std::vector<GLuint> indices;
-};
-
-class TriMesh
-{
-protected:
-	GLuint nElements;
-	GLuint vao;
-
-	std::vector<GLuint> buffers;
-
-	virtual void InitBuffers(
-		std::vector<GLuint>& indices,
-		std::vector<GLfloat>& points,
-		std::vector<GLfloat>& normals
-	) {
-		nElements = indices.size();
-
-		GLuint indexBuf = 0, posBuf = 0, normBuf = 0;
-
-		glGenBuffers(1, &indexBuf);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuf);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
-			indices.data(), GL_STATIC_DRAW);
-
-		glGenBuffers(1, &posBuf);
-		glBindBuffer(GL_ARRAY_BUFFER, posBuf);
-		glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(GLfloat),
-			points.data(), GL_STATIC_DRAW);
-
-		glGenBuffers(1, &normBuf);
-		glBindBuffer(GL_ARRAY_BUFFER, normBuf);
-		glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(GLfloat),
-			normals.data(), GL_STATIC_DRAW);
-
-		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuf);
-
-		glBindBuffer(GL_ARRAY_BUFFER, posBuf);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(0);
-
-		glBindBuffer(GL_ARRAY_BUFFER, normBuf);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(1);
-
-		glBindVertexArray(0);
-
-		buffers.push_back(indexBuf);
-		buffers.push_back(posBuf);
-		buffers.push_back(normBuf);
-	}
-
-	void DeleteBuffers() {
-		if (!buffers.empty()) {
-			glDeleteBuffers(buffers.size(), buffers.data());
-			buffers.clear();
-		}
-
-		if (vao != 0) {
-			glDeleteVertexArrays(1, &vao);
-			vao = 0;
-		}
-	}
-
-public:
-	TriMesh() : vao(0), nElements(0) {}
-	virtual ~TriMesh() {
-		DeleteBuffers();
-	}
-
-	virtual void Render() const {
-		if (vao == 0)
-			return;
-
-		glBindVertexArray(vao);
-		glDrawElements(GL_TRIANGLES, nElements, GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-	}
-};
-
-class Model3D : public TriMesh
-{
-private:
-
-public:
-	AABB aabb;
-	OpenMeshData openMeshData;
-
-	static std::unique_ptr<Model3D> Load(const std::string& path) {
-		std::unique_ptr<Model3D> model3D(new Model3D);
-
-		model3D->openMeshData.Read(path);
-
-		GLMeshData glMeshData(model3D->openMeshData);
-
-		model3D->InitBuffers(glMeshData.indices,
-			glMeshData.points,
-			glMeshData.normals);
-
-		for (int i = 0; i < glMeshData.points.size(); i += 3) {
-			glm::vec3 pt(glMeshData.points[i],
-				glMeshData.points[i + 1],
-				glMeshData.points[i + 2]);
-			model3D->aabb.Add(pt);
-		}
-
-		return model3D;
-	}
-};
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include <memory>
+#include <omp.h>
+#include <OpenMesh/Core/IO/MeshIO.hh>
+#include <OpenMesh/Core/Mesh/TriMesh_ArrayKernelT.hh>
+#include <OpenMesh/Core/Mesh/TriConnectivity.hh>
+
+#include "aabb.h"
+#include "meshloader.h"
+
+class OpenMeshData : public
+	OpenMesh::TriMesh_ArrayKernelT<OpenMesh::DefaultTraits>
+{
+public:
+	OpenMeshData() {}
+
+	bool Read(const std::string& path) {
+		OpenMesh::IO::Options ropt;
+		if (!OpenMesh::IO::read_mesh(*this, path, ropt)) {
+			std::cerr << "Error loading mesh from " <<
+				path << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+	void Build(const std::vector<GLfloat>& points,
+		const std::vector<GLuint>& indices) {
+		reserve(points.size() / 3, indices.size(), indices.size() / 3);
+
+		std::vector<VHandle> handles(points.size() / 3);
+		for (int i = 0; i < handles.size(); i++)
+			handles[i] = add_vertex(Point(points[i * 3],
+				points[i * 3 + 1],
+				points[i * 3 + 2]));
+
+		for (int i = 0; i + 2 < indices.size(); i += 3)
+			add_face(handles[indices[i]],
+				handles[indices[i + 1]],
+				handles[indices[i + 2]]);
+
+		request_face_normals();
+		request_halfedge_normals();
+		update_normals();
+	}
+	bool Write(const std::string& path) {
+		OpenMesh::IO::Options wopt;
+		if (!OpenMesh::IO::write_mesh(*this, path, wopt)) {
+			std::cerr << "Unable to write mesh to " <<
+				path << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+};
+
+// Indexed triangle mesh with one position stream and one index stream.
+// Normals and halfedge connectivity are only built when first asked for.
+class MeshData
+{
+public:
+	MeshData() {}
+	MeshData(const OpenMeshData& arg) {
+		points.reserve(arg.n_vertices() * 3);
+		for (OpenMeshData::VIter vit = arg.vertices_begin();
+			vit != arg.vertices_end();
+			vit++) {
+			OpenMeshData::Point p = arg.point(*vit);
+			for (int i = 0; i < 3; i++)
+				points.push_back(p[i]);
+		}
+
+		indices.reserve(arg.n_faces() * 3);
+		for (OpenMeshData::FIter fit = arg.faces_begin();
+			fit != arg.faces_end();
+			fit++) {
+			for (OpenMeshData::FVIter fvit = arg.fv_begin(*fit);
+				fvit != arg.fv_end(*fit);
+				fvit++)
+				indices.push_back(fvit->idx());
+		}
+	}
+
+	size_t VertexCount() const {
+		return points.size() / 3;
+	}
+	size_t FaceCount() const {
+		return indices.size() / 3;
+	}
+	glm::vec3 Position(size_t v) const {
+		return glm::vec3(points[v * 3], points[v * 3 + 1], points[v * 3 + 2]);
+	}
+
+	AABB ComputeAABB() const {
+		AABB aabb;
+#pragma omp parallel
+		{
+			AABB local;
+#pragma omp for nowait
+			for (long long v = 0; v < (long long)VertexCount(); v++)
+				local.Add(Position(v));
+#pragma omp critical
+			aabb.Add(local);
+		}
+		return aabb;
+	}
+
+	const std::vector<GLfloat>& FaceNormals() {
+		if (!faceNormals.empty() || indices.empty())
+			return faceNormals;
+
+		faceNormals.resize(indices.size());
+#pragma omp parallel for
+		for (long long f = 0; f < (long long)FaceCount(); f++) {
+			glm::vec3 n = FaceArea(f);
+			float len = glm::length(n);
+			if (len > 0.0f)
+				n /= len;
+			for (int k = 0; k < 3; k++)
+				faceNormals[f * 3 + k] = n[k];
+		}
+		return faceNormals;
+	}
+	const std::vector<GLfloat>& VertexNormals() {
+		if (!vertexNormals.empty() || points.empty())
+			return vertexNormals;
+
+		vertexNormals.assign(points.size(), 0.0f);
+#pragma omp parallel for
+		for (long long f = 0; f < (long long)FaceCount(); f++) {
+			glm::vec3 n = FaceArea(f);
+			for (int c = 0; c < 3; c++) {
+				GLuint v = indices[f * 3 + c];
+				for (int k = 0; k < 3; k++) {
+#pragma omp atomic
+					vertexNormals[v * 3 + k] += n[k];
+				}
+			}
+		}
+#pragma omp parallel for
+		for (long long v = 0; v < (long long)VertexCount(); v++) {
+			glm::vec3 n(vertexNormals[v * 3],
+				vertexNormals[v * 3 + 1],
+				vertexNormals[v * 3 + 2]);
+			float len = glm::length(n);
+			if (len > 0.0f)
+				n /= len;
+			for (int k = 0; k < 3; k++)
+				vertexNormals[v * 3 + k] = n[k];
+		}
+		return vertexNormals;
+	}
+	OpenMeshData& HalfedgeMesh() {
+		if (!halfedgeMesh) {
+			halfedgeMesh.reset(new OpenMeshData);
+			halfedgeMesh->Build(points, indices);
+		}
+		return *halfedgeMesh;
+	}
+
+	void Clear() {
+		std::vector<GLfloat>().swap(points);
+		std::vector<GLuint>().swap(indices);
+		std::vector<GLfloat>().swap(faceNormals);
+		std::vector<GLfloat>().swap(vertexNormals);
+		halfedgeMesh.reset();
+	}
+
+	std::vector<GLfloat> points;
+	std::vector<GLuint> indices;
+
+private:
+	glm::vec3 FaceArea(size_t f) const {
+		glm::vec3 a = Position(indices[f * 3]);
+		glm::vec3 b = Position(indices[f * 3 + 1]);
+		glm::vec3 c = Position(indices[f * 3 + 2]);
+		return glm::cross(b - a, c - a);
+	}
+
+	std::vector<GLfloat> faceNormals, vertexNormals;
+	std::unique_ptr<OpenMeshData> halfedgeMesh;
+};
+
+class TriMesh
+{
+protected:
+	GLuint nElements;
+	GLuint vao;
+
+	std::vector<GLuint> buffers;
+
+	virtual void InitBuffers(
+		const std::vector<GLuint>& indices,
+		const std::vector<GLfloat>& points
+	) {
+		InitBuffers(indices.data(), indices.size(), points.data(), points.size());
+	}
+	// streams owned by someone else are uploaded from where they are
+	void InitBuffers(const GLuint* indices, size_t nIndices,
+		const GLfloat* points, size_t nPoints) {
+		nElements = nIndices;
+
+		GLuint indexBuf = 0, posBuf = 0;
+
+		glGenBuffers(1, &indexBuf);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuf);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, nIndices * sizeof(GLuint),
+			indices, GL_STATIC_DRAW);
+
+		glGenBuffers(1, &posBuf);
+		glBindBuffer(GL_ARRAY_BUFFER, posBuf);
+		glBufferData(GL_ARRAY_BUFFER, nPoints * sizeof(GLfloat),
+			points, GL_STATIC_DRAW);
+
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuf);
+
+		glBindBuffer(GL_ARRAY_BUFFER, posBuf);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(0);
+
+		glBindVertexArray(0);
+
+		buffers.push_back(indexBuf);
+		buffers.push_back(posBuf);
+	}
+
+	void DeleteBuffers() {
+		if (!buffers.empty()) {
+			glDeleteBuffers(buffers.size(), buffers.data());
+			buffers.clear();
+		}
+
+		if (vao != 0) {
+			glDeleteVertexArrays(1, &vao);
+			vao = 0;
+		}
+	}
+
+public:
+	AABB aabb;
+
+	TriMesh() : vao(0), nElements(0) {}
+	virtual ~TriMesh() {
+		DeleteBuffers();
+	}
+
+	virtual void Render() {
+		if (vao == 0)
+			return;
+
+		glBindVertexArray(vao);
+		glDrawElements(GL_TRIANGLES, nElements, GL_UNSIGNED_INT, 0);
+		glBindVertexArray(0);
+	}
+};
+
+class Model3D : public TriMesh
+{
+public:
+	MeshData mesh;
+
+	static std::unique_ptr<Model3D> Create(MeshData&& mesh) {
+		std::unique_ptr<Model3D> model3D(new Model3D);
+		model3D->mesh = std::move(mesh);
+		model3D->aabb = model3D->mesh.ComputeAABB();
+		return model3D;
+	}
+
+	// null if the file cannot be read
+	static std::unique_ptr<Model3D> Load(const std::string& path) {
+		std::unique_ptr<Model3D> model3D(new Model3D);
+		if (MeshLoader::Load(path, model3D->mesh, model3D->aabb))
+			return model3D;
+
+		OpenMeshData openMeshData;
+		if (!openMeshData.Read(path))
+			return 0;
+		return Create(MeshData(openMeshData));
+	}
+
+	// Binary STL or PLY image in memory; null if it is neither.
+	static std::unique_ptr<Model3D> Parse(const char* data, size_t size) {
+		std::unique_ptr<Model3D> model3D(new Model3D);
+		if (!MeshLoader::Load(data, size, model3D->mesh, model3D->aabb))
+			return 0;
+		return model3D;
+	}
+
+	// GPU buffers are uploaded on the first draw.
+	void Render() override {
+		if (vao == 0)
+			InitBuffers(mesh.indices, mesh.points);
+
+		TriMesh::Render();
+	}
+
+	// For GPU-only consumers: uploads the buffers and drops the host copy.
+	void ReleaseHostData() {
+		if (vao == 0)
+			InitBuffers(mesh.indices, mesh.points);
+
+		mesh.Clear();
+	}
+};
@@ -1,10 +1,187 @@
-#include "params.h"
-
-std::unique_ptr<Params> Params::instance;
-std::once_flag Params::flag;
-
-Params& Params::GetInstance()
-{
-	std::call_once(flag, [] {instance.reset(new Params); });
-	return *instance;
+#include "params.h"
+
+#include <cerrno>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+// values shared by all recipes; each recipe overrides what it uses
+Params::Params()
+{
+	sliceThickness = 0.1f;
+	dpi = 600;
+	pixelWidth = 25.4 / dpi;
+	maxFBOSize = 4000;
+	maxPlateListMB = 1024;
+
+	selfSupportThres = 0.1f;
+	effectiveRadius = 5.0f;
+	overhangAngle = 45 * 3.141592 / 180.0;
+	supportConeAngle = 45 * 3.141592 / 180.0;
+
+	samplingResolution = 5.0f;
+	faceSampler = FaceSamplerType::BARYCENTRIC;
+
+	slicer = SlicerType::LDNI;
+	compareSlicers = false;
+
+	graphEngine = GraphEngineType::BOOST;
+	swallowEngine = SwallowEngineType::ITERATIVE;
+
+	streamTriangles = false;
+	streamBatchSize = 1 << 16;
+
+	perfCounters = false;
+}
+
+bool ParseOption(const std::string& option, Params& params)
+{
+	if (option == "--slicer=ldni")
+		params.slicer = SlicerType::LDNI;
+	else if (option == "--slicer=contour")
+		params.slicer = SlicerType::CONTOUR;
+	else if (option == "--compare-slicers")
+		params.compareSlicers = true;
+	else if (option == "--face-sampler=gl")
+		params.faceSampler = FaceSamplerType::RASTERIZER;
+	else if (option == "--face-sampler=cpu")
+		params.faceSampler = FaceSamplerType::BARYCENTRIC;
+	else if (option == "--graph=boost")
+		params.graphEngine = GraphEngineType::BOOST;
+	else if (option == "--graph=column")
+		params.graphEngine = GraphEngineType::COLUMN;
+	else if (option == "--swallow=iterative")
+		params.swallowEngine = SwallowEngineType::ITERATIVE;
+	else if (option == "--swallow=frontier")
+		params.swallowEngine = SwallowEngineType::FRONTIER;
+	else if (option == "--stream")
+		params.streamTriangles = true;
+	else if (option.compare(0, 15, "--stream-batch=") == 0) {
+		int size;
+		if (!ParseNumber(option.substr(15), size) || size <= 0)
+			return false;
+		params.streamTriangles = true;
+		params.streamBatchSize = size;
+	}
+	else if (option.compare(0, 20, "--max-plate-list-mb=") == 0) {
+		int megabytes;
+		if (!ParseNumber(option.substr(20), megabytes) || megabytes <= 0)
+			return false;
+		params.maxPlateListMB = megabytes;
+	}
+	else if (option.compare(0, 8, "--trace=") == 0)
+		params.tracePath = option.substr(8);
+	else if (option.compare(0, 16, "--memory-report=") == 0)
+		params.memoryReportPath = option.substr(16);
+	else if (option.compare(0, 10, "--metrics=") == 0)
+		params.metricsPath = option.substr(10);
+	else if (option == "--perf-counters")
+		params.perfCounters = true;
+	else
+		return false;
+
+	return true;
+}
+
+void SplitOption(const std::string& option, std::string& name,
+	std::string& value)
+{
+	size_t eq = option.find('=');
+	name = option.substr(0, eq);
+	value = eq == std::string::npos ? "" : option.substr(eq + 1);
+}
+
+namespace
+{
+	// strto* skip leading spaces and take a sign even for unsigned types,
+	// so only a digit, a point or, where allowed, a minus starts a number
+	bool Starts(const std::string& text, bool sign)
+	{
+		if (text.empty())
+			return false;
+		char c = text[0];
+		return isdigit((unsigned char)c) || c == '.' || (sign && c == '-');
+	}
+
+	template<typename T, typename Parse>
+	bool ParseWhole(const std::string& text, bool sign, Parse parse, T& value)
+	{
+		if (!Starts(text, sign))
+			return false;
+		const char* begin = text.c_str();
+		char* end;
+		errno = 0;
+		T parsed = parse(begin, &end);
+		if (end == begin || *end != 0 || errno == ERANGE)
+			return false;
+		value = parsed;
+		return true;
+	}
+}
+
+bool ParseNumber(const std::string& text, int& value)
+{
+	long parsed;
+	if (!ParseWhole(text, true, [](const char* s, char** end) {
+		return std::strtol(s, end, 10);
+		}, parsed) || parsed < INT_MIN || parsed > INT_MAX)
+		return false;
+	value = parsed;
+	return true;
+}
+
+bool ParseNumber(const std::string& text, unsigned& value)
+{
+	unsigned long parsed;
+	if (!ParseWhole(text, false, [](const char* s, char** end) {
+		return std::strtoul(s, end, 10);
+		}, parsed) || parsed > UINT_MAX)
+		return false;
+	value = parsed;
+	return true;
+}
+
+bool ParseNumber(const std::string& text, size_t& value)
+{
+	unsigned long long parsed;
+	if (!ParseWhole(text, false, [](const char* s, char** end) {
+		return std::strtoull(s, end, 10);
+		}, parsed) || parsed > SIZE_MAX)
+		return false;
+	value = parsed;
+	return true;
+}
+
+bool ParseNumber(const std::string& text, float& value)
+{
+	float parsed;
+	if (!ParseWhole(text, true, [](const char* s, char** end) {
+		return std::strtof(s, end);
+		}, parsed) || !std::isfinite(parsed))
+		return false;
+	value = parsed;
+	return true;
+}
+
+bool ParseNumber(const std::string& text, double& value)
+{
+	double parsed;
+	if (!ParseWhole(text, true, [](const char* s, char** end) {
+		return std::strtod(s, end);
+		}, parsed) || !std::isfinite(parsed))
+		return false;
+	value = parsed;
+	return true;
+}
+
+std::vector<std::string> SplitList(const std::string& text)
+{
+	std::vector<std::string> items;
+	std::stringstream stream(text);
+	std::string item;
+	while (std::getline(stream, item, ','))
+		items.push_back(item);
+	return items;
 }
\ No newline at end of file
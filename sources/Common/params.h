@@ -1,25 +1,96 @@
-#pragma once
-
-#include <memory>
-#include <mutex>
-
-class Params
-{
-public:
-	static Params& GetInstance();
-
-	float sliceThickness;
-	int dpi;
-	float pixelWidth;
-	int maxFBOSize;
-
-	float selfSupportThres;
-	float effectiveRadius;
-	float overhangAngle;
-
-	float samplingResolution;
-
-private:
-	static std::unique_ptr<Params> instance;
-	static std::once_flag flag;
-};
+#pragma once
+
+#include <string>
+#include <vector>
+
+enum class SlicerType {
+	LDNI,
+	CONTOUR
+};
+
+enum class FaceSamplerType {
+	RASTERIZER,
+	BARYCENTRIC
+};
+
+enum class GraphEngineType {
+	BOOST,
+	COLUMN
+};
+
+enum class SwallowEngineType {
+	ITERATIVE,
+	FRONTIER
+};
+
+// Settings of one job. The recipes fill in their defaults and the command
+// line adjusts them before the job freezes them into a JobContext.
+struct Params
+{
+	Params();
+
+	float sliceThickness;
+	int dpi;
+	float pixelWidth;
+	int maxFBOSize;
+	// host copy of the fragment lists of one plate frame, in megabytes
+	int maxPlateListMB;
+
+	float selfSupportThres;
+	float effectiveRadius;
+	float overhangAngle;
+	float supportConeAngle;
+
+	float samplingResolution;
+	FaceSamplerType faceSampler;
+
+	SlicerType slicer;
+	bool compareSlicers;
+
+	GraphEngineType graphEngine;
+	SwallowEngineType swallowEngine;
+
+	bool streamTriangles;
+	int streamBatchSize;
+
+	std::string tracePath;
+	std::string memoryReportPath;
+	std::string metricsPath;
+	bool perfCounters;
+};
+
+// Applies one command line option such as --slicer=contour to params.
+// Returns false for an option it does not know.
+bool ParseOption(const std::string& option, Params& params);
+
+// Splits a command line option of the form --name=value at the first '='.
+// value is empty when there is none.
+void SplitOption(const std::string& option, std::string& name,
+	std::string& value);
+
+// Reads the whole text as one number. Returns false, leaving value as it
+// was, for an empty text, trailing characters or a value out of range;
+// the tools report that like an unknown option.
+bool ParseNumber(const std::string& text, int& value);
+bool ParseNumber(const std::string& text, unsigned& value);
+bool ParseNumber(const std::string& text, size_t& value);
+bool ParseNumber(const std::string& text, float& value);
+bool ParseNumber(const std::string& text, double& value);
+
+// the items of a comma separated list
+std::vector<std::string> SplitList(const std::string& text);
+
+// a comma separated list of numbers, all checked as ParseNumber does
+template<typename T>
+bool ParseList(const std::string& text, std::vector<T>& values)
+{
+	std::vector<T> parsed;
+	for (const std::string& item : SplitList(text)) {
+		T value;
+		if (!ParseNumber(item, value))
+			return false;
+		parsed.push_back(value);
+	}
+	values.swap(parsed);
+	return true;
+}
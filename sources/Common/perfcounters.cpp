@@ -0,0 +1,169 @@
+#include "perfcounters.h"
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+std::unique_ptr<PerfCounters> PerfCounters::instance;
+std::once_flag PerfCounters::flag;
+
+namespace
+{
+	const uint64_t configs[PerfCounters::EVENT_COUNT] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES
+	};
+	const char* names[PerfCounters::EVENT_COUNT] = {
+		"cycles", "instructions", "LLC misses", "branch misses"
+	};
+}
+
+PerfCounters& PerfCounters::GetInstance()
+{
+	std::call_once(flag, [] {instance.reset(new PerfCounters); });
+	return *instance;
+}
+
+void PerfCounters::Enable(bool enable)
+{
+	enabled = enable;
+	if (!enabled)
+		return;
+
+	// probe once so that a refusal is reported up front
+	Group group;
+	if (Open(group))
+		Close(group, 0);
+}
+
+void PerfCounters::Start()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	rows.clear();
+}
+
+bool PerfCounters::Open(Group& group)
+{
+	group.leader = -1;
+	for (int e = 0; e < EVENT_COUNT; e++) {
+		group.fds[e] = OpenEvent((Event)e, group.leader);
+		if (e == CYCLES && group.fds[e] < 0) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (available) {
+				available = false;
+				reason = strerror(errno);
+			}
+			return false;
+		}
+		if (e == CYCLES)
+			group.leader = group.fds[e];
+	}
+
+	ioctl(group.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(group.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	return true;
+}
+
+void PerfCounters::Close(Group& group, const char* name)
+{
+	ioctl(group.leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+	// with PERF_FORMAT_GROUP the leader returns the number of events, the
+	// enabled and running times, then one value per event in open order
+	uint64_t data[3 + EVENT_COUNT];
+	ssize_t size = read(group.leader, data, sizeof(data));
+
+	Row sample = {};
+	if (size >= (ssize_t)(3 * sizeof(uint64_t))) {
+		uint64_t n = data[0];
+		double scale = data[2] > 0 ? (double)data[1] / data[2] : 0.0;
+		uint64_t k = 0;
+		for (int e = 0; e < EVENT_COUNT && k < n; e++) {
+			if (group.fds[e] < 0)
+				continue;
+			sample.values[e] = (uint64_t)(data[3 + k] * scale);
+			sample.valid[e] = true;
+			k++;
+		}
+	}
+
+	for (int e = 0; e < EVENT_COUNT; e++) {
+		if (group.fds[e] >= 0)
+			close(group.fds[e]);
+	}
+
+	if (!name)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = rows.find(name);
+	if (it == rows.end())
+		it = rows.emplace(name, Row()).first;
+	Row& row = it->second;
+	row.scopes++;
+	for (int e = 0; e < EVENT_COUNT; e++) {
+		row.values[e] += sample.values[e];
+		row.valid[e] = row.valid[e] || sample.valid[e];
+	}
+}
+
+void PerfCounters::PrintSummary(std::ostream& out)
+{
+	if (!enabled)
+		return;
+	if (!available) {
+		out << "hardware counters unavailable : " << reason << "\n";
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::ios::fmtflags flags = out.flags();
+	out << std::left << std::setw(32) << "counters" << std::right <<
+		std::setw(8) << "scopes";
+	for (int e = 0; e < EVENT_COUNT; e++)
+		out << std::setw(16) << names[e];
+	out << std::setw(8) << "IPC" << "\n";
+
+	out << std::fixed << std::setprecision(2);
+	for (const auto& entry : rows) {
+		const Row& row = entry.second;
+		out << std::left << std::setw(32) << entry.first << std::right <<
+			std::setw(8) << row.scopes;
+		for (int e = 0; e < EVENT_COUNT; e++) {
+			if (row.valid[e])
+				out << std::setw(16) << row.values[e];
+			else
+				out << std::setw(16) << "-";
+		}
+		if (row.values[CYCLES] > 0)
+			out << std::setw(8) <<
+				(double)row.values[INSTRUCTIONS] / row.values[CYCLES];
+		out << "\n";
+	}
+	out.flags(flags);
+}
+
+int PerfCounters::OpenEvent(Event e, int leader)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = configs[e];
+	attr.disabled = leader < 0;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP |
+		PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	// this thread, any cpu
+	return syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+}
\ No newline at end of file
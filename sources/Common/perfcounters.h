@@ -0,0 +1,99 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <map>
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+// Hardware counters read through perf_event_open. A scope opens one
+// counter group for the calling thread, so stage scopes see the thread
+// that runs the stage and worker scopes inside parallel regions see
+// their own thread. Nothing is opened unless counting is enabled, and
+// when the kernel refuses access the scopes turn into no-ops.
+class PerfCounters
+{
+public:
+	enum Event {
+		CYCLES = 0,
+		INSTRUCTIONS,
+		LLC_MISSES,
+		BRANCH_MISSES,
+		EVENT_COUNT
+	};
+
+	struct Group {
+		int fds[EVENT_COUNT];
+		int leader;
+	};
+
+	static PerfCounters& GetInstance();
+
+	void Enable(bool enable);
+	bool IsEnabled() const {
+		return enabled && available;
+	}
+
+	// clears the recorded scopes
+	void Start();
+
+	bool Open(Group&);
+	void Close(Group&, const char* name);
+
+	void PrintSummary(std::ostream&);
+
+private:
+	struct Row {
+		long long scopes;
+		uint64_t values[EVENT_COUNT];
+		bool valid[EVENT_COUNT];
+	};
+
+	static int OpenEvent(Event, int leader);
+
+private:
+	PerfCounters() : enabled(false), available(true) {}
+
+	static std::unique_ptr<PerfCounters> instance;
+	static std::once_flag flag;
+
+	bool enabled, available;
+	std::string reason;
+
+	std::mutex mutex;
+	std::map<std::string, Row> rows;
+};
+
+class PerfScope
+{
+public:
+	PerfScope(const char* name_) : name(name_), open(false) {
+		PerfCounters& counters = PerfCounters::GetInstance();
+		if (counters.IsEnabled())
+			open = counters.Open(group);
+	}
+	~PerfScope() {
+		if (open)
+			PerfCounters::GetInstance().Close(group, name);
+	}
+
+private:
+	PerfScope(const PerfScope&) {}
+	PerfScope& operator=(const PerfScope&) {
+		return *this;
+	}
+
+	const char* name;
+	bool open;
+	PerfCounters::Group group;
+};
+
+#define PERF_CONCAT_(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_(a, b)
+
+#ifdef NO_PERF_COUNTERS
+#define PERF_SCOPE(name)
+#else
+#define PERF_SCOPE(name) PerfScope PERF_CONCAT(perfScope, __LINE__)(name)
+#endif
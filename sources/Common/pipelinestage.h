@@ -0,0 +1,27 @@
+#pragma once
+
+#include "profiler.h"
+#include "memorystats.h"
+#include "perfcounters.h"
+#include "metrics.h"
+
+// A pipeline stage is timed by the profiler, gets its own memory peak and
+// hardware counters for the thread running it.
+#define PIPELINE_STAGE(name) \
+	PROFILE_ZONE(name); \
+	MEMORY_STAGE(name); \
+	PERF_SCOPE(name)
+
+// Per-thread share of a stage, opened inside a parallel region.
+#define WORKER_ZONE(name) \
+	PROFILE_ZONE(name); \
+	PERF_SCOPE(name)
+
+// Clears everything recorded by a previous job.
+inline void StartPipelineStats()
+{
+	Profiler::GetInstance().Start();
+	MemoryStats::GetInstance().Start();
+	Metrics::GetInstance().Start();
+	PerfCounters::GetInstance().Start();
+}
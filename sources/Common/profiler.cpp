@@ -0,0 +1,176 @@
+#include "profiler.h"
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+#include <set>
+
+std::unique_ptr<Profiler> Profiler::instance;
+std::once_flag Profiler::flag;
+const size_t Profiler::bufferCapacity;
+
+namespace
+{
+	void WriteEscaped(std::ostream& out, const char* s)
+	{
+		for (; *s; s++) {
+			if (*s == '"' || *s == '\\')
+				out << '\\';
+			out << *s;
+		}
+	}
+}
+
+Profiler& Profiler::GetInstance()
+{
+	std::call_once(flag, [] {instance.reset(new Profiler); });
+	return *instance;
+}
+
+void Profiler::Start()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& buffer : buffers)
+		buffer->written = 0;
+	epoch = std::chrono::steady_clock::now();
+}
+
+int Profiler::Enter()
+{
+	return LocalBuffer().depth++;
+}
+
+void Profiler::Leave(const char* name, int64_t start, int depth)
+{
+	int64_t end = Now();
+	ThreadBuffer& buffer = LocalBuffer();
+	buffer.depth = depth;
+
+	Event& event = buffer.events[buffer.written % bufferCapacity];
+	event.name = name;
+	event.start = start;
+	event.end = end;
+	event.thread = buffer.thread;
+	event.depth = depth;
+	buffer.written++;
+}
+
+Profiler::ThreadBuffer& Profiler::LocalBuffer()
+{
+	// buffers are never freed, so the cached pointer stays valid for the
+	// lifetime of the thread
+	thread_local ThreadBuffer* local = 0;
+	if (local)
+		return *local;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	buffers.emplace_back(new ThreadBuffer);
+	local = buffers.back().get();
+	local->events.resize(bufferCapacity);
+	local->written = 0;
+	local->thread = buffers.size() - 1;
+	local->depth = 0;
+	return *local;
+}
+
+void Profiler::Collect(std::vector<Event>& events)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& buffer : buffers) {
+		size_t n = std::min(buffer->written, bufferCapacity);
+		size_t first = buffer->written - n;
+		for (size_t i = first; i < buffer->written; i++)
+			events.push_back(buffer->events[i % bufferCapacity]);
+	}
+
+	std::sort(events.begin(), events.end(),
+		[](const Event& a, const Event& b) {
+			return a.start < b.start ||
+				(a.start == b.start && a.depth < b.depth);
+		});
+}
+
+bool Profiler::WriteTrace(const std::string& path)
+{
+	std::ofstream out(path);
+	if (!out) {
+		std::cerr << "Unable to write trace to " << path << std::endl;
+		return false;
+	}
+
+	std::vector<Event> events;
+	Collect(events);
+
+	out << std::fixed << std::setprecision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (size_t i = 0; i < events.size(); i++) {
+		const Event& e = events[i];
+		out << (i ? ",\n" : "\n") << "{\"name\":\"";
+		WriteEscaped(out, e.name);
+		out << "\",\"cat\":\"zone\",\"ph\":\"X\",\"pid\":0,\"tid\":" <<
+			e.thread << ",\"ts\":" << e.start / 1000.0 <<
+			",\"dur\":" << (e.end - e.start) / 1000.0 << "}";
+	}
+	out << "\n]}\n";
+
+	return true;
+}
+
+void Profiler::PrintSummary(std::ostream& out)
+{
+	struct Row {
+		int64_t first;
+		int depth;
+		long long calls;
+		int64_t total, max;
+		std::set<int> threads;
+	};
+
+	std::vector<Event> events;
+	Collect(events);
+
+	std::map<std::string, Row> rows;
+	for (const Event& e : events) {
+		auto it = rows.find(e.name);
+		if (it == rows.end()) {
+			Row row = { e.start, e.depth, 0, 0, 0, std::set<int>() };
+			it = rows.emplace(e.name, row).first;
+		}
+		// worker threads of a parallel region start at depth zero, so the
+		// deepest occurrence is the one that shows where the zone nests
+		Row& row = it->second;
+		int64_t duration = e.end - e.start;
+		row.depth = std::max(row.depth, e.depth);
+		row.calls++;
+		row.total += duration;
+		row.max = std::max(row.max, duration);
+		row.threads.insert(e.thread);
+	}
+
+	std::vector<std::pair<std::string, Row>> sorted(rows.begin(), rows.end());
+	std::sort(sorted.begin(), sorted.end(),
+		[](const std::pair<std::string, Row>& a,
+			const std::pair<std::string, Row>& b) {
+			return a.second.first < b.second.first;
+		});
+
+	std::ios::fmtflags flags = out.flags();
+	out << std::left << std::setw(44) << "zone" << std::right <<
+		std::setw(10) << "calls" << std::setw(14) << "total ms" <<
+		std::setw(12) << "mean ms" << std::setw(12) << "max ms" <<
+		std::setw(9) << "threads" << "\n";
+	out << std::fixed << std::setprecision(3);
+	for (const auto& entry : sorted) {
+		const Row& row = entry.second;
+		std::string name = std::string(2 * row.depth, ' ') + entry.first;
+		out << std::left << std::setw(44) << name << std::right <<
+			std::setw(10) << row.calls <<
+			std::setw(14) << row.total / 1e6 <<
+			std::setw(12) << row.total / 1e6 / row.calls <<
+			std::setw(12) << row.max / 1e6 <<
+			std::setw(9) << row.threads.size() << "\n";
+	}
+	out.flags(flags);
+}
\ No newline at end of file
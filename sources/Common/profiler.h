@@ -0,0 +1,94 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+// Scoped-zone profiler. Every thread records into its own ring buffer,
+// so zones may be opened inside parallel regions; the oldest events of a
+// thread are overwritten once its buffer is full. Define NO_PROFILER to
+// compile the zones out.
+class Profiler
+{
+public:
+	struct Event {
+		const char* name;
+		int64_t start, end;
+		int thread;
+		int depth;
+	};
+
+	static Profiler& GetInstance();
+
+	// clears all buffers and restarts the clock
+	void Start();
+
+	int64_t Now() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	int Enter();
+	void Leave(const char* name, int64_t start, int depth);
+
+	void Collect(std::vector<Event>&);
+	bool WriteTrace(const std::string& path);
+	void PrintSummary(std::ostream&);
+
+private:
+	struct ThreadBuffer {
+		std::vector<Event> events;
+		size_t written;
+		int thread;
+		int depth;
+	};
+
+	ThreadBuffer& LocalBuffer();
+
+private:
+	static std::unique_ptr<Profiler> instance;
+	static std::once_flag flag;
+
+	static const size_t bufferCapacity = 1 << 16;
+
+	std::chrono::steady_clock::time_point epoch;
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+class ProfileZone
+{
+public:
+	ProfileZone(const char* name_) : name(name_) {
+		Profiler& profiler = Profiler::GetInstance();
+		depth = profiler.Enter();
+		start = profiler.Now();
+	}
+	~ProfileZone() {
+		Profiler::GetInstance().Leave(name, start, depth);
+	}
+
+private:
+	ProfileZone(const ProfileZone&) {}
+	ProfileZone& operator=(const ProfileZone&) {
+		return *this;
+	}
+
+	const char* name;
+	int64_t start;
+	int depth;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef NO_PROFILER
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_ZONE(name) \
+	ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#endif
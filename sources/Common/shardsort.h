@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <omp.h>
+
+// Parallel counting sort of the items 0 to n - 1 by shardOf(i), which is
+// in [0, nShards). order gets the items shard by shard, in input order
+// inside every shard, and shardBegin the nShards + 1 bounds of the shards
+// in order. The shards can then be processed by one thread each without
+// locking. shardOf is called twice per item and has to be thread safe.
+template<typename Index, typename ShardFn>
+void ShardSort(size_t n, int nShards, ShardFn shardOf,
+	std::vector<Index>& order, std::vector<size_t>& shardBegin)
+{
+	order.resize(n);
+	shardBegin.assign(nShards + 1, 0);
+	std::vector<size_t> counts;
+	int nThreads = 1;
+#pragma omp parallel
+	{
+#pragma omp single
+		{
+			nThreads = omp_get_num_threads();
+			counts.assign((size_t)nThreads * nShards, 0);
+		}
+
+		// every thread takes a contiguous range, so the scatter below
+		// keeps the input order
+		int tid = omp_get_thread_num();
+		size_t first = n * tid / nThreads;
+		size_t last = n * (tid + 1) / nThreads;
+		size_t* count = &counts[(size_t)tid * nShards];
+		for (size_t i = first; i < last; i++)
+			count[shardOf(i)]++;
+
+#pragma omp barrier
+#pragma omp single
+		{
+			size_t offset = 0;
+			for (int s = 0; s < nShards; s++) {
+				shardBegin[s] = offset;
+				for (int t = 0; t < nThreads; t++) {
+					size_t m = counts[(size_t)t * nShards + s];
+					counts[(size_t)t * nShards + s] = offset;
+					offset += m;
+				}
+			}
+			shardBegin[nShards] = offset;
+		}
+
+		for (size_t i = first; i < last; i++)
+			order[count[shardOf(i)]++] = i;
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+
+// Outcome of a job, or of a stage that can fail on its input. The command
+// line tools print the message and exit; embedding callers get it back.
+class Status
+{
+public:
+	enum Code {
+		OK = 0,
+		INVALID_ARGUMENT,
+		UNSUPPORTED,
+		IO_ERROR,
+		MODEL_TOO_BIG,
+		GL_ERROR,
+		BUFFER_TOO_SMALL
+	};
+
+	Status() : code(OK) {}
+	Status(Code code_, const std::string& message_)
+		: code(code_), message(message_) {}
+
+	bool IsOk() const {
+		return code == OK;
+	}
+	Code GetCode() const {
+		return code;
+	}
+	const std::string& Message() const {
+		return message;
+	}
+
+private:
+	Code code;
+	std::string message;
+};
@@ -0,0 +1,116 @@
+#include "taskgraph.h"
+#include "pipelinestage.h"
+
+struct TaskNode {
+	const char* name;
+	TaskGraph::Affinity affinity;
+	std::function<void()> work;
+	// dependencies that have not finished yet
+	int waiting;
+	std::vector<TaskNode*> dependents;
+};
+
+TaskGraph::TaskGraph(WorkerPool& pool_)
+	: pool(pool_), unfinished(0)
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+}
+
+TaskNode* TaskGraph::NewNode(const char* name, Affinity affinity,
+	std::function<void()> work)
+{
+	std::unique_ptr<TaskNode> node(new TaskNode);
+	node->name = name;
+	node->affinity = affinity;
+	node->work = std::move(work);
+	node->waiting = 0;
+	nodes.push_back(std::move(node));
+	return nodes.back().get();
+}
+
+void TaskGraph::Depend(TaskNode* node, TaskNode* dependency)
+{
+	node->waiting++;
+	dependency->dependents.push_back(node);
+}
+
+void TaskGraph::Run()
+{
+	// the roots are picked before any of them runs, a finished task
+	// dispatches the tasks it releases itself
+	std::vector<TaskNode*> roots;
+	for (const std::unique_ptr<TaskNode>& node : nodes) {
+		if (node->waiting == 0)
+			roots.push_back(node.get());
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		unfinished = nodes.size();
+	}
+	for (TaskNode* node : roots)
+		Dispatch(node);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (unfinished > 0) {
+		if (callerTasks.empty()) {
+			changed.wait(lock);
+			continue;
+		}
+
+		TaskNode* node = callerTasks.front();
+		callerTasks.pop_front();
+		lock.unlock();
+		Execute(node);
+		lock.lock();
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void TaskGraph::Dispatch(TaskNode* node)
+{
+	if (node->affinity == ANY) {
+		pool.Submit([this, node](int) {
+			Execute(node);
+			});
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	callerTasks.push_back(node);
+	changed.notify_all();
+}
+
+void TaskGraph::Execute(TaskNode* node)
+{
+	// nothing may escape: a pool thread would terminate the process, and
+	// Run must not unwind while submitted tasks still use the graph
+	try {
+		WORKER_ZONE(node->name);
+		node->work();
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!error)
+			error = std::current_exception();
+	}
+
+	std::vector<TaskNode*> ready;
+	{
+		// notified under the lock, Run may return and destroy the graph
+		// as soon as it is released
+		std::lock_guard<std::mutex> lock(mutex);
+		for (TaskNode* dependent : node->dependents) {
+			if (--dependent->waiting == 0)
+				ready.push_back(dependent);
+		}
+		unfinished--;
+		changed.notify_all();
+	}
+	for (TaskNode* dependent : ready)
+		Dispatch(dependent);
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <type_traits>
+#include "workerpool.h"
+
+struct TaskNode;
+
+// Value of a task, readable by the tasks added with it as a dependency
+// and by the caller once TaskGraph::Run has returned. Readers get it by
+// reference, so a single consumer may move it out. If the task threw, Get
+// throws the same exception, so the tasks reading it fail as well.
+template<typename T>
+class TaskFuture
+{
+public:
+	TaskFuture() : node(0) {}
+
+	T& Get() const {
+		if (slot->error)
+			std::rethrow_exception(slot->error);
+		return slot->value;
+	}
+
+private:
+	friend class TaskGraph;
+
+	struct Slot {
+		T value;
+		std::exception_ptr error;
+	};
+	std::shared_ptr<Slot> slot;
+	TaskNode* node;
+};
+
+// Stages of one job as a dependency graph, so that independent steps such
+// as reading the mesh, creating the context and compiling the shaders
+// overlap. A task starts once every task it reads from has finished. ANY
+// tasks run on a WorkerPool and are stolen by idle workers; CALLER tasks
+// run on the thread in Run, which is the one allowed to own the context.
+// A graph runs once. An exception of a task is kept in its future and
+// Run, after every task has finished, throws the first one.
+class TaskGraph
+{
+public:
+	enum Affinity {
+		ANY,
+		CALLER
+	};
+
+	TaskGraph(WorkerPool& pool_);
+	~TaskGraph();
+
+	// fn gets the values of deps and returns the value of the new task,
+	// which has to be default constructible
+	template<typename Fn, typename... Deps>
+	TaskFuture<std::invoke_result_t<Fn, Deps&...>> Add(const char* name,
+		Affinity affinity, Fn fn, TaskFuture<Deps>... deps)
+	{
+		typedef std::invoke_result_t<Fn, Deps&...> T;
+		static_assert(!std::is_void<T>::value, "a task returns its value");
+
+		typedef typename TaskFuture<T>::Slot Slot;
+		TaskFuture<T> future;
+		future.slot = std::make_shared<Slot>();
+		std::shared_ptr<Slot> slot = future.slot;
+		future.node = NewNode(name, affinity, [slot, fn, deps...]() mutable {
+			try {
+				slot->value = fn(deps.Get()...);
+			}
+			catch (...) {
+				slot->error = std::current_exception();
+				throw;
+			}
+			});
+		(Depend(future.node, deps.node), ...);
+		return future;
+	}
+
+	// returns when every task has finished; rethrows the first exception
+	// of a task
+	void Run();
+
+private:
+	TaskGraph(const TaskGraph&) = delete;
+	TaskGraph& operator=(const TaskGraph&) = delete;
+
+	TaskNode* NewNode(const char* name, Affinity, std::function<void()> work);
+	void Depend(TaskNode* node, TaskNode* dependency);
+	void Dispatch(TaskNode* node);
+	void Execute(TaskNode* node);
+
+private:
+	WorkerPool& pool;
+	std::vector<std::unique_ptr<TaskNode>> nodes;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<TaskNode*> callerTasks;
+	size_t unfinished;
+	std::exception_ptr error;
+};
@@ -0,0 +1,133 @@
+#include "trianglestream.h"
+
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+using glm::vec3;
+
+namespace {
+	const size_t STL_HEADER_SIZE = 80 + sizeof(uint32_t);
+	const size_t STL_RECORD_SIZE = 50;
+}
+
+std::unique_ptr<TriangleStream> TriangleStream::Open(const std::string& path,
+	size_t batchSize)
+{
+	std::unique_ptr<TriangleStream> stream(new TriangleStream);
+	stream->path = path;
+	stream->batchSize = batchSize;
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		std::cerr << "Unable to open : " << path << std::endl;
+		return nullptr;
+	}
+
+	size_t fileSize = file.tellg();
+	uint32_t count = 0;
+	file.seekg(80);
+	file.read(reinterpret_cast<char*>(&count), sizeof(count));
+	if (!file || fileSize != STL_HEADER_SIZE + STL_RECORD_SIZE * count) {
+		std::cerr << "Only binary STL can be streamed : " << path << std::endl;
+		return nullptr;
+	}
+	stream->nTriangles = count;
+	stream->records.resize(batchSize * STL_RECORD_SIZE);
+	stream->points.resize(batchSize * 9);
+
+	for (size_t first = 0; first < count; first += batchSize) {
+		size_t n = 0;
+		Status status = stream->ReadBatch(file, first, n);
+		if (!status.IsOk()) {
+			std::cerr << status.Message() << std::endl;
+			return nullptr;
+		}
+		for (size_t i = 0; i < n * 3; i++)
+			stream->aabb.Add(vec3(stream->points[i * 3],
+				stream->points[i * 3 + 1],
+				stream->points[i * 3 + 2]));
+	}
+
+	stream->InitStreamBuffer();
+	return stream;
+}
+
+void TriangleStream::Render()
+{
+	if (vao == 0)
+		return;
+
+	std::ifstream file;
+	status = Status();
+	if (!Begin(file)) {
+		status = Status(Status::IO_ERROR, "Unable to open : " + path);
+		return;
+	}
+
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	for (size_t first = 0; first < nTriangles; first += batchSize) {
+		size_t n = 0;
+		status = ReadBatch(file, first, n);
+		if (!status.IsOk())
+			break;
+		glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(GLfloat),
+			0, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, n * 9 * sizeof(GLfloat),
+			points.data());
+		glDrawArrays(GL_TRIANGLES, 0, n * 3);
+	}
+	glBindVertexArray(0);
+}
+
+bool TriangleStream::Begin(std::ifstream& file)
+{
+	file.open(path, std::ios::binary);
+	if (!file) {
+		std::cerr << "Unable to open : " << path << std::endl;
+		return false;
+	}
+
+	file.seekg(STL_HEADER_SIZE);
+	return true;
+}
+
+Status TriangleStream::ReadBatch(std::ifstream& file, size_t first,
+	size_t& n)
+{
+	n = std::min(batchSize, nTriangles - first);
+	file.read(records.data(), n * STL_RECORD_SIZE);
+	// a short read is a file that shrank after Open, not a last batch
+	if (!file || (size_t)file.gcount() != n * STL_RECORD_SIZE) {
+		n = 0;
+		return Status(Status::IO_ERROR, "Truncated STL : " + path);
+	}
+
+	for (size_t t = 0; t < n; t++)
+		memcpy(&points[t * 9], &records[t * STL_RECORD_SIZE + 12],
+			9 * sizeof(GLfloat));
+
+	return Status();
+}
+
+void TriangleStream::InitStreamBuffer()
+{
+	nElements = 0;
+
+	GLuint posBuf = 0;
+	glGenBuffers(1, &posBuf);
+	glBindBuffer(GL_ARRAY_BUFFER, posBuf);
+	glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(GLfloat),
+		0, GL_STREAM_DRAW);
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, posBuf);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(0);
+
+	glBindVertexArray(0);
+
+	buffers.push_back(posBuf);
+}
\ No newline at end of file
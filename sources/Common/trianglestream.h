@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "model3d.h"
+#include "status.h"
+
+// Binary STL read from disk in fixed-size triangle batches. Every Render()
+// streams the file once through a single orphaned vertex buffer, so only
+// one batch is ever resident on the host or the GPU.
+class TriangleStream : public TriMesh
+{
+public:
+	static std::unique_ptr<TriangleStream> Open(const std::string& path,
+		size_t batchSize);
+
+	void Render() override;
+
+	size_t TriangleCount() const {
+		return nTriangles;
+	}
+	// outcome of the last Render(); a file truncated or made unreadable
+	// since Open() stops the pass with an IO_ERROR
+	const Status& GetStatus() const {
+		return status;
+	}
+
+private:
+	TriangleStream() : nTriangles(0), batchSize(0) {}
+
+	bool Begin(std::ifstream& file);
+	Status ReadBatch(std::ifstream& file, size_t first, size_t& n);
+	void InitStreamBuffer();
+
+	std::string path;
+	size_t nTriangles;
+	size_t batchSize;
+	Status status;
+
+	std::vector<char> records;
+	std::vector<GLfloat> points;
+};
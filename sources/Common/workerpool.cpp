@@ -0,0 +1,124 @@
+#include "workerpool.h"
+
+WorkerPool::WorkerPool(int nWorkers)
+	: queued(0), pending(0), next(0), stopping(false)
+{
+	for (int i = 0; i < nWorkers; i++)
+		queues.emplace_back(new Queue);
+	for (int i = 0; i < nWorkers; i++)
+		threads.emplace_back(&WorkerPool::WorkerLoop, this, i);
+}
+
+WorkerPool::~WorkerPool()
+{
+	Wait();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+void WorkerPool::Submit(Task task, int worker)
+{
+	if (worker < 0) {
+		std::lock_guard<std::mutex> lock(mutex);
+		worker = next++ % queues.size();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+		queues[worker]->tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queued++;
+		pending++;
+	}
+	wake.notify_all();
+}
+
+void WorkerPool::SubmitPinned(Task task, int worker)
+{
+	{
+		std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+		queues[worker]->pinned.push_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queues[worker]->nPinned++;
+		pending++;
+	}
+	wake.notify_all();
+}
+
+void WorkerPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return pending == 0; });
+}
+
+bool WorkerPool::Take(int worker, Task& task, bool& pinned)
+{
+	{
+		Queue& own = *queues[worker];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		pinned = !own.pinned.empty();
+		if (pinned) {
+			task = std::move(own.pinned.front());
+			own.pinned.pop_front();
+			return true;
+		}
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.front());
+			own.tasks.pop_front();
+			return true;
+		}
+	}
+
+	for (size_t i = 1; i < queues.size(); i++) {
+		Queue& victim = *queues[(worker + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkerPool::WorkerLoop(int worker)
+{
+	while (true) {
+		Task task;
+		bool pinned;
+		if (Take(worker, task, pinned)) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (pinned)
+					queues[worker]->nPinned--;
+				else
+					queued--;
+			}
+			task(worker);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--pending == 0)
+				idle.notify_all();
+			continue;
+		}
+
+		// another worker may have taken the task that raised queued, so
+		// the deques are scanned again after every wake up
+		std::unique_lock<std::mutex> lock(mutex);
+		Queue& own = *queues[worker];
+		wake.wait(lock, [&] {
+			return queued > 0 || own.nPinned > 0 || stopping;
+			});
+		if (stopping && queued == 0 && own.nPinned == 0)
+			return;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Fixed set of threads with one task deque each. A worker runs its own
+// tasks in submission order and, once it runs dry, steals from the front
+// of the other deques, so a few long jobs do not leave the rest of the
+// pool idle and callers that submit their largest work first keep that
+// order.
+// Pinned tasks are never stolen and always run on the worker they name.
+class WorkerPool
+{
+public:
+	// the task gets the index of the worker running it
+	typedef std::function<void(int)> Task;
+
+	WorkerPool(int nWorkers);
+	~WorkerPool();
+
+	int Size() const {
+		return threads.size();
+	}
+
+	// queues on the given worker, round robin for -1
+	void Submit(Task task, int worker = -1);
+	// queues on the given worker only, for tasks bound to per-worker state
+	void SubmitPinned(Task task, int worker);
+	// blocks until every submitted task has finished
+	void Wait();
+
+private:
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+		std::deque<Task> pinned;
+		// pinned tasks not taken yet, guarded by the pool mutex
+		size_t nPinned = 0;
+	};
+
+	void WorkerLoop(int worker);
+	bool Take(int worker, Task& task, bool& pinned);
+
+private:
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+
+	std::mutex mutex;
+	std::condition_variable wake, idle;
+	// stealable tasks in the deques, and tasks submitted but not finished
+	size_t queued, pending;
+	size_t next;
+	bool stopping;
+};
@@ -0,0 +1,147 @@
+#include "columngraph.h"
+
+#include <limits>
+
+namespace
+{
+	const size_t ARITY = 4;
+	const size_t NOT_IN_HEAP = (size_t)-1;
+}
+
+ColumnGraph::ColumnGraph(size_t nVertices, size_t nEdges)
+{
+	offsets.reserve(nVertices + 1);
+	offsets.push_back(0);
+	targets.reserve(nEdges);
+	weights.reserve(nEdges);
+
+	distance.assign(nVertices, std::numeric_limits<float>::max());
+	color.assign(nVertices, WHITE);
+	heapIndex.assign(nVertices, NOT_IN_HEAP);
+}
+
+void ColumnGraph::AddEdge(uint32_t target, float weight)
+{
+	targets.push_back(target);
+	weights.push_back(weight);
+}
+
+void ColumnGraph::EndVertex()
+{
+	offsets.push_back(targets.size());
+}
+
+long long ColumnGraph::Cover(uint32_t source, float coverage,
+	std::vector<bool>& floatable, long long* covered)
+{
+	for (uint32_t v : touched) {
+		distance[v] = std::numeric_limits<float>::max();
+		color[v] = WHITE;
+		heapIndex[v] = NOT_IN_HEAP;
+	}
+	touched.clear();
+	heap.clear();
+
+	long long settled = 0;
+	distance[source] = 0;
+	color[source] = GRAY;
+	touched.push_back(source);
+	if (0 > coverage)
+		return settled;
+	Push(source);
+
+	while (!heap.empty()) {
+		uint32_t u = heap[0];
+		Pop();
+
+		float du = distance[u];
+		for (uint32_t e = offsets[u]; e < offsets[u + 1]; e++) {
+			uint32_t v = targets[e];
+			float d = du + weights[e];
+			if (color[v] == WHITE) {
+				if (d < distance[v])
+					distance[v] = d;
+				color[v] = GRAY;
+				touched.push_back(v);
+				if (distance[v] > coverage)
+					return settled;
+				Push(v);
+			}
+			else if (color[v] == GRAY && d < distance[v]) {
+				distance[v] = d;
+				SiftUp(heapIndex[v]);
+			}
+		}
+
+		color[u] = BLACK;
+		if (covered && floatable[u])
+			(*covered)++;
+		floatable[u] = false;
+		settled++;
+	}
+
+	return settled;
+}
+
+void ColumnGraph::Push(uint32_t v)
+{
+	heapIndex[v] = heap.size();
+	heap.push_back(v);
+	SiftUp(heap.size() - 1);
+}
+
+void ColumnGraph::Pop()
+{
+	heapIndex[heap[0]] = NOT_IN_HEAP;
+	if (heap.size() == 1) {
+		heap.pop_back();
+		return;
+	}
+
+	heap[0] = heap.back();
+	heapIndex[heap[0]] = 0;
+	heap.pop_back();
+	SiftDown();
+}
+
+void ColumnGraph::SiftUp(size_t index)
+{
+	uint32_t moving = heap[index];
+	float d = distance[moving];
+	while (index > 0) {
+		size_t parent = (index - 1) / ARITY;
+		if (!(d < distance[heap[parent]]))
+			break;
+		heap[index] = heap[parent];
+		heapIndex[heap[index]] = index;
+		index = parent;
+	}
+	heap[index] = moving;
+	heapIndex[moving] = index;
+}
+
+void ColumnGraph::SiftDown()
+{
+	size_t size = heap.size();
+	size_t index = 0;
+	float d = distance[heap[0]];
+	while (true) {
+		size_t first = index * ARITY + 1;
+		if (first >= size)
+			break;
+
+		size_t smallest = first;
+		size_t last = std::min(first + ARITY, size);
+		for (size_t c = first + 1; c < last; c++) {
+			if (distance[heap[c]] < distance[heap[smallest]])
+				smallest = c;
+		}
+		if (!(distance[heap[smallest]] < d))
+			break;
+
+		std::swap(heap[index], heap[smallest]);
+		heapIndex[heap[index]] = index;
+		heapIndex[heap[smallest]] = smallest;
+		index = smallest;
+	}
+}
\ No newline at end of file
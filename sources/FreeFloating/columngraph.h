@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Compressed adjacency of the intersection graph with a bounded Dijkstra
+// that only resets the vertices the previous search touched. The heap is
+// the 4-ary indirect heap of boost::dijkstra_shortest_paths, and edges are
+// scanned in insertion order, so ties settle in the same order and the
+// covered vertices match the boost search exactly.
+class ColumnGraph
+{
+public:
+	ColumnGraph(size_t nVertices, size_t nEdges);
+	~ColumnGraph() {}
+
+	// edges are appended to the current vertex, starting with vertex 0
+	void AddEdge(uint32_t target, float weight);
+	void EndVertex();
+
+	// Marks the vertices within coverage of the source as not floatable.
+	// Like the boost visitor, the search stops at the first vertex
+	// discovered beyond coverage. Returns the number of settled vertices
+	// and adds those that were floatable to covered.
+	long long Cover(uint32_t source, float coverage,
+		std::vector<bool>& floatable, long long* covered = 0);
+
+	// the vertices the last Cover discovered, and which of them it settled
+	const std::vector<uint32_t>& Touched() const {
+		return touched;
+	}
+	bool IsSettled(uint32_t v) const {
+		return color[v] == BLACK;
+	}
+
+	size_t VertexCount() const {
+		return offsets.size() - 1;
+	}
+	size_t EdgeCount() const {
+		return targets.size();
+	}
+
+private:
+	enum Color : uint8_t { WHITE, GRAY, BLACK };
+
+	void Push(uint32_t v);
+	void Pop();
+	void SiftUp(size_t index);
+	void SiftDown();
+
+private:
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> targets;
+	std::vector<float> weights;
+
+	std::vector<float> distance;
+	std::vector<Color> color;
+	std::vector<size_t> heapIndex;
+	std::vector<uint32_t> heap;
+	std::vector<uint32_t> touched;
+};
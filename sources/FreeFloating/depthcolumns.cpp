@@ -0,0 +1,109 @@
+#include "depthcolumns.h"
+
+#include <cmath>
+#include <algorithm>
+#include <memorystats.h>
+using glm::vec3;
+using glm::vec4;
+using glm::ivec4;
+
+void DepthColumns::Read(zLDNIGenerator& generator)
+{
+	generator.GetImageSize(width, height);
+	toPixel = generator.GetPixelTransform();
+	rows.assign(height, Row());
+
+	std::vector<vec3> list;
+	for (int i = 0; i < height; i++) {
+		Row& row = rows[i];
+		row.offsets.reserve(width + 1);
+		row.offsets.push_back(0);
+		for (int j = 0; j < width; j++) {
+			list.clear();
+			generator.GetSortedList(list, i, j);
+			row.points.insert(row.points.end(), list.begin(), list.end());
+			row.offsets.push_back(row.points.size());
+		}
+	}
+	generator.ReleaseLists();
+
+	MEMORY_TRACK("depth columns", height * (width + 1) * sizeof(uint32_t) +
+		PointCount() * sizeof(vec3));
+}
+
+void DepthColumns::Patch(zLDNIGenerator& generator, ivec4 window)
+{
+	std::vector<vec3> list;
+	for (int i = 0; i < window[3]; i++) {
+		Row& row = rows[window[1] + i];
+		int first = window[0], last = window[0] + window[2];
+
+		// the columns right of the window move by the change in length
+		Row patched;
+		patched.offsets.assign(row.offsets.begin(),
+			row.offsets.begin() + first + 1);
+		patched.points.assign(row.points.begin(),
+			row.points.begin() + row.offsets[first]);
+		for (int j = 0; j < window[2]; j++) {
+			list.clear();
+			generator.GetSortedList(list, i, j);
+			patched.points.insert(patched.points.end(), list.begin(), list.end());
+			patched.offsets.push_back(patched.points.size());
+		}
+		uint32_t moved = patched.points.size();
+		patched.points.insert(patched.points.end(),
+			row.points.begin() + row.offsets[last], row.points.end());
+		for (int j = last + 1; j <= width; j++)
+			patched.offsets.push_back(moved + row.offsets[j] - row.offsets[last]);
+
+		row = std::move(patched);
+	}
+}
+
+glm::ivec2 DepthColumns::Pixel(vec3 pos) const
+{
+	vec4 pixel = toPixel * vec4(pos, 1.0f);
+	return glm::ivec2((int)round(pixel.x), (int)round(pixel.y));
+}
+
+ivec4 DepthColumns::Footprint(const std::vector<vec3>& points) const
+{
+	if (points.empty())
+		return ivec4(0);
+
+	float left = width, bottom = height, right = 0, top = 0;
+	for (const vec3& pos : points) {
+		vec4 pixel = toPixel * vec4(pos, 1.0f);
+		left = std::min(left, pixel.x);
+		right = std::max(right, pixel.x);
+		bottom = std::min(bottom, pixel.y);
+		top = std::max(top, pixel.y);
+	}
+
+	int x0 = std::max(0, (int)floor(left) - 1);
+	int y0 = std::max(0, (int)floor(bottom) - 1);
+	int x1 = std::min(width, (int)ceil(right) + 2);
+	int y1 = std::min(height, (int)ceil(top) + 2);
+	if (x1 <= x0 || y1 <= y0)
+		return ivec4(0);
+	return ivec4(x0, y0, x1 - x0, y1 - y0);
+}
+
+bool DepthColumns::Contains(const std::vector<vec3>& points) const
+{
+	for (const vec3& pos : points) {
+		vec4 pixel = toPixel * vec4(pos, 1.0f);
+		if (pixel.x < 0 || pixel.x > width - 1 || pixel.y < 0 ||
+			pixel.y > height - 1 || pixel.z < 0 || pixel.z > 1)
+			return false;
+	}
+	return true;
+}
+
+size_t DepthColumns::PointCount() const
+{
+	size_t count = 0;
+	for (const Row& row : rows)
+		count += row.points.size();
+	return count;
+}
\ No newline at end of file
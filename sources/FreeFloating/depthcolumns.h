@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+#include "zldni.h"
+
+// The sorted fragments of every pixel column of a frame, kept on the host
+// so that the columns under an edit can be replaced. Each row is stored
+// flat, so a patch only rewrites the rows it touches.
+class DepthColumns
+{
+public:
+	DepthColumns() : width(0), height(0) {}
+	~DepthColumns() {}
+
+	// every column of the generator, which is left with its frame only
+	void Read(zLDNIGenerator&);
+	// replaces the columns in window with those of a generator rendered
+	// for that window of the same frame
+	void Patch(zLDNIGenerator&, glm::ivec4 window);
+
+	int Width() const {
+		return width;
+	}
+	int Height() const {
+		return height;
+	}
+	const glm::vec3* Column(int row, int col) const {
+		return rows[row].points.data() + rows[row].offsets[col];
+	}
+	size_t Count(int row, int col) const {
+		const std::vector<uint32_t>& offsets = rows[row].offsets;
+		return offsets[col + 1] - offsets[col];
+	}
+
+	// the pixel a point of the frame falls in
+	glm::ivec2 Pixel(glm::vec3 pos) const;
+	// pixels covering the points, with one pixel of slack and clipped to
+	// the frame; empty if none is inside
+	glm::ivec4 Footprint(const std::vector<glm::vec3>& points) const;
+	// whether the points lie inside the frame, depth included
+	bool Contains(const std::vector<glm::vec3>& points) const;
+
+private:
+	struct Row {
+		std::vector<uint32_t> offsets;
+		std::vector<glm::vec3> points;
+	};
+
+	size_t PointCount() const;
+
+private:
+	int width, height;
+	glm::mat4 toPixel;
+	std::vector<Row> rows;
+};
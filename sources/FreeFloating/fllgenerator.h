@@ -1,49 +1,52 @@
-#pragma once
-
-#include <glm/glm.hpp>
-#include <glad/glad.h>
-#include <glslprogram.h>
-#include <model3d.h>
-#include <opencv2/opencv.hpp>
-
-enum BufferNames {
-	COUNTER_BUFFER = 0,
-	LINKED_LIST_BUFFER
-};
-
-struct ListNode {
-	GLfloat depth;
-	GLuint next;
-};
-
-struct LinkedList {
-	std::vector<ListNode> list;
-	std::vector<GLuint> headPtr;
-
-	int width, height;
-	glm::mat4 model, view, projection;
-
-	AABB aabb;
-};
-
-class FLLGenerator
-{
-private:
-	GLSLProgram prog;
-	GLuint fboHandle;
-	GLuint buffers[2], clearBuf, headPtrTex;
-	GLuint maxNodes, nodeSize;
-
-	glm::mat4 model, view, projection;
-
-	void Configure(Model3D*, LinkedList&);
-	void SetupFBO(int, int);
-	void SetupShaderStorage(int, int);
-	void ClearBuffers(int, int);
-
-public:
-	FLLGenerator();
-	~FLLGenerator() {}
-
-	void Generate(Model3D*, LinkedList&);
-};
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+#include <glcontext.h>
+#include <jobcontext.h>
+#include <status.h>
+#include <model3d.h>
+#include <opencv2/opencv.hpp>
+
+enum BufferNames {
+	COUNTER_BUFFER = 0,
+	LINKED_LIST_BUFFER
+};
+
+struct ListNode {
+	GLfloat depth;
+	GLuint next;
+};
+
+struct LinkedList {
+	std::vector<ListNode> list;
+	std::vector<GLuint> headPtr;
+
+	int width, height;
+	glm::mat4 model, view, projection;
+
+	AABB aabb;
+};
+
+class FLLGenerator
+{
+private:
+	GLSLProgram* prog;
+	GLuint fboHandle, depthBuf;
+	GLuint buffers[2], clearBuf, headPtrTex;
+	GLuint maxNodes, nodeSize;
+
+	glm::mat4 model, view, projection;
+
+	Status Configure(const JobContext&, TriMesh*, LinkedList&);
+	void SetupFBO(int, int);
+	void SetupShaderStorage(int, int);
+	void ClearBuffers(int, int);
+	void DeleteBuffers();
+
+public:
+	FLLGenerator();
+	~FLLGenerator();
+
+	Status Generate(const JobContext&, TriMesh*, LinkedList&);
+};
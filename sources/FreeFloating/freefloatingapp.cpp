@@ -1,66 +1,299 @@
-#include "freefloatingapp.h"
-#include "supportpoint.h"
-
-#include <params.h>
-#include <stopwatch.h>
-
-std::unique_ptr<FreeFloatingApp> FreeFloatingApp::instance;
-std::once_flag FreeFloatingApp::flag;
-
-FreeFloatingApp& FreeFloatingApp::GetInstance()
-{
-	std::call_once(flag, [] {instance.reset(new FreeFloatingApp); });
-	return *instance;
-}
-
-void FreeFloatingApp::Run(std::string path)
-{
-	model3D = Model3D::Load(path);
-	StopWatch::GetInstance().Start();
-	BuildSupportStructure();
-}
-
-FreeFloatingApp::FreeFloatingApp()
-{
-	SetParameters();
-
-	if (!glfwInit())
-		exit(EXIT_FAILURE);
-
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
-
-	Params& params = Params::GetInstance();
-	offscreen = glfwCreateWindow(100, 100, "FreeFloating App", 0, 0);
-	if (!offscreen) {
-		glfwTerminate();
-		exit(EXIT_FAILURE);
-	}
-
-	glfwMakeContextCurrent(offscreen);
-	if (!gladLoadGL()) {
-		glfwTerminate();
-		exit(EXIT_FAILURE);
-	}
-}
-
-void FreeFloatingApp::SetParameters()
-{
-	Params& params = Params::GetInstance();
-
-	params.sliceThickness = 0.1f;
-	params.dpi = 600;
-	params.pixelWidth = 25.4 / params.dpi;
-	params.maxFBOSize = 4000;
-
-	params.effectiveRadius = 5.0f;
-	params.overhangAngle = 45 * 3.141592 / 180.0;
-}
-
-void FreeFloatingApp::BuildSupportStructure()
-{
-	SupportPointFinder supportPointFinder;
-	supportPointFinder.Run(model3D.get());
+#include "freefloatingapp.h"
+#include "supportpoint.h"
+#include "plate.h"
+#include "orientation.h"
+
+#include <pipelinestage.h>
+
+FreeFloatingApp::FreeFloatingApp(WorkerPool* setupPool_)
+	: prepared(false), setupPool(setupPool_)
+{
+	if (!setupPool) {
+		ownPool.reset(new WorkerPool(2));
+		setupPool = ownPool.get();
+	}
+}
+
+FreeFloatingApp::~FreeFloatingApp()
+{
+	// the cached meshes own buffers of this context
+	ContextScope current(gl.get());
+	cache.Clear();
+}
+
+void FreeFloatingApp::SetCacheSize(size_t entries)
+{
+	ContextScope current(gl.get());
+	cache.SetCapacity(entries);
+}
+
+Status FreeFloatingApp::Prepare()
+{
+	if (prepared)
+		return Status();
+
+	TaskGraph graph(*setupPool);
+	TaskFuture<Status> ready = AddSetup(graph);
+	graph.Run();
+	return ready.Get();
+}
+
+Status FreeFloatingApp::CreateContext()
+{
+	if (gl)
+		return Status();
+
+	Status status;
+	gl = GLContext::Create("FreeFloating App", status);
+	return status;
+}
+
+TaskFuture<Status> FreeFloatingApp::AddSetup(TaskGraph& graph)
+{
+	if (prepared)
+		return graph.Add("prepared", TaskGraph::CALLER, [] { return Status(); });
+
+	TaskFuture<std::unique_ptr<ProgramSource>> source = graph.Add(
+		"read shaders", TaskGraph::ANY, [] {
+			std::unique_ptr<ProgramSource> source(new ProgramSource);
+			if (!source->Read(zLDNIGenerator::vertexShader,
+				zLDNIGenerator::fragmentShader))
+				source.reset();
+			return source;
+		});
+	TaskFuture<Status> created = graph.Add("context",
+		TaskGraph::CALLER, [this] { return CreateContext(); });
+	return graph.Add("compile shaders", TaskGraph::CALLER,
+		[this](std::unique_ptr<ProgramSource>& source, Status& created) {
+			if (!created.IsOk())
+				return created;
+			ContextScope current(*gl);
+			if (!source || !GLContext::LoadProgram(*source))
+				return Status(Status::GL_ERROR,
+					"Unable to load the fragment list shaders");
+			prepared = true;
+			return Status();
+		}, source, created);
+}
+
+Params FreeFloatingApp::DefaultParams()
+{
+	Params params;
+
+	params.sliceThickness = 0.1f;
+	params.dpi = 600;
+	params.pixelWidth = 25.4 / params.dpi;
+	params.maxFBOSize = 4000;
+
+	params.effectiveRadius = 5.0f;
+	params.overhangAngle = 45 * 3.141592 / 180.0;
+	params.graphEngine = GraphEngineType::BOOST;
+
+	params.streamTriangles = false;
+	params.streamBatchSize = 1 << 16;
+
+	return params;
+}
+
+Status FreeFloatingApp::Run(const JobContext& context, std::string path,
+	JobResult* result)
+{
+	const Params& params = context.params;
+
+	// the mesh is read while the context is created and the program
+	// compiled, so a cold start costs about the longest of the three
+	TaskGraph graph(*setupPool);
+	TaskFuture<Status> ready = AddSetup(graph);
+	TaskFuture<std::unique_ptr<TriMesh>> loaded;
+	TriangleStream* stream = 0;
+	if (params.streamTriangles) {
+		// the stream creates its vertex buffer as it opens
+		loaded = graph.Add("load mesh", TaskGraph::CALLER,
+			[this, &path, &params, &stream](Status& ready) {
+				std::unique_ptr<TriangleStream> mesh;
+				if (ready.IsOk()) {
+					ContextScope current(*gl);
+					mesh = TriangleStream::Open(path, params.streamBatchSize);
+					stream = mesh.get();
+				}
+				return std::unique_ptr<TriMesh>(std::move(mesh));
+			}, ready);
+	}
+	else {
+		TaskFuture<std::unique_ptr<Model3D>> model3D = graph.Add("load mesh",
+			TaskGraph::ANY, [&path] { return Model3D::Load(path); });
+		loaded = graph.Add("upload mesh", TaskGraph::CALLER,
+			[this](std::unique_ptr<Model3D>& model3D, Status& ready) {
+				std::unique_ptr<TriMesh> mesh;
+				if (model3D && ready.IsOk()) {
+					ContextScope current(*gl);
+					model3D->ReleaseHostData();
+					mesh = std::move(model3D);
+				}
+				return mesh;
+			}, model3D, ready);
+	}
+	{
+		PIPELINE_STAGE("setup");
+		graph.Run();
+	}
+	if (!ready.Get().IsOk())
+		return ready.Get();
+
+	ContextScope current(*gl);
+	std::unique_ptr<TriMesh> mesh = std::move(loaded.Get());
+	if (!mesh)
+		return Status(Status::IO_ERROR, "Unable to read " + path);
+
+	PIPELINE_STAGE("build support structure");
+	Status status = BuildSupportStructure(context, mesh.get(), result);
+	// every pass re-reads the file, which may have changed since it opened
+	if (status.IsOk() && stream && !stream->GetStatus().IsOk())
+		return stream->GetStatus();
+	return status;
+}
+
+Status FreeFloatingApp::Run(const JobContext& context,
+	std::unique_ptr<Model3D> model3D, JobResult* result)
+{
+	Status status = Prepare();
+	if (!status.IsOk())
+		return status;
+	ContextScope current(*gl);
+
+	// moved into a local so the buffers are freed while the context is
+	// still current
+	std::unique_ptr<Model3D> mesh = std::move(model3D);
+	{
+		PIPELINE_STAGE("upload mesh");
+		mesh->ReleaseHostData();
+	}
+
+	PIPELINE_STAGE("build support structure");
+	return BuildSupportStructure(context, mesh.get(), result);
+}
+
+Status FreeFloatingApp::Run(const JobContext& context, const std::string& key,
+	std::function<std::unique_ptr<Model3D>()> load, JobResult* result,
+	bool* cacheHit)
+{
+	const Params& params = context.params;
+	Status status = Prepare();
+	if (!status.IsOk())
+		return status;
+	ContextScope current(*gl);
+
+	CacheEntry* entry = cache.Find(key);
+	if (cacheHit)
+		*cacheHit = entry != 0;
+	if (!entry) {
+		CacheEntry loaded;
+		{
+			PIPELINE_STAGE("load mesh");
+			loaded.mesh = load();
+			if (!loaded.mesh)
+				return Status(Status::IO_ERROR, "Unable to read " + key);
+			loaded.mesh->ReleaseHostData();
+		}
+		loaded.pixelWidth = 0;
+		entry = &cache.Insert(key, std::move(loaded));
+	}
+
+	if (!entry->ldni || entry->pixelWidth != params.pixelWidth) {
+		entry->ldni.reset(new zLDNIGenerator(context, entry->mesh.get()));
+		entry->pixelWidth = params.pixelWidth;
+	}
+
+	{
+		PIPELINE_STAGE("build support structure");
+		SupportPointFinder supportPointFinder(context);
+		status = supportPointFinder.Run(*entry->ldni);
+		if (status.IsOk() && result)
+			result->supportPoints = supportPointFinder.GetSupportPoints();
+	}
+
+	// a failed LDNI is not worth keeping, the next hit tries again
+	if (!status.IsOk())
+		entry->ldni.reset();
+	if (cache.Capacity() == 0)
+		cache.Clear();
+	return status;
+}
+
+Status FreeFloatingApp::RunPlate(const JobContext& context,
+	std::unique_ptr<Plate> plate, std::vector<JobResult>* results)
+{
+	Status status = Prepare();
+	if (!status.IsOk())
+		return status;
+	ContextScope current(*gl);
+
+	// moved into a local so the buffers are freed while the context is
+	// still current
+	std::unique_ptr<Plate> local = std::move(plate);
+	std::vector<std::vector<int>> frames;
+	{
+		PIPELINE_STAGE("pack plate");
+		status = PackPlate(context, local->parts, frames);
+		if (!status.IsOk())
+			return status;
+	}
+	{
+		PIPELINE_STAGE("upload mesh");
+		for (std::unique_ptr<Model3D>& mesh : local->meshes)
+			mesh->ReleaseHostData();
+	}
+	Metrics::GetInstance().GetCounter("plate frames").Add(frames.size());
+	if (results)
+		results->assign(local->parts.size(), JobResult());
+
+	PIPELINE_STAGE("build support structure");
+	for (const std::vector<int>& frame : frames) {
+		std::vector<PlatePart> parts;
+		for (int p : frame)
+			parts.push_back(local->parts[p]);
+		zLDNIGenerator generator(context, parts);
+		if (!generator.GetStatus().IsOk())
+			return generator.GetStatus();
+
+		for (size_t p = 0; p < frame.size(); p++) {
+			SupportPointFinder supportPointFinder(context);
+			status = supportPointFinder.Run(generator, p);
+			if (!status.IsOk())
+				return status;
+			if (results)
+				(*results)[frame[p]].supportPoints =
+					supportPointFinder.GetSupportPoints();
+		}
+	}
+	return Status();
+}
+
+Status FreeFloatingApp::FindOrientation(const JobContext& context,
+	std::unique_ptr<Model3D> model3D, const OrientationConfig& config,
+	std::vector<OrientationCandidate>& ranked)
+{
+	Status status = Prepare();
+	if (!status.IsOk())
+		return status;
+	ContextScope current(*gl);
+
+	// moved into a local so the buffers are freed while the context is
+	// still current
+	std::unique_ptr<Model3D> mesh = std::move(model3D);
+	OrientationSearch search(context, config);
+	return search.Run(mesh.get(), ranked);
+}
+
+Status FreeFloatingApp::BuildSupportStructure(const JobContext& context,
+	TriMesh* mesh, JobResult* result, const SearchProgress* progress)
+{
+	SupportPointFinder supportPointFinder(context);
+	supportPointFinder.SetProgress(progress);
+	Status status = supportPointFinder.Run(mesh);
+	if (status.IsOk() && result) {
+		result->supportPoints = supportPointFinder.GetSupportPoints();
+		result->covered = supportPointFinder.GetCoverage();
+	}
+	return status;
 }
\ No newline at end of file
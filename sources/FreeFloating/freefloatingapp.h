@@ -1,28 +1,86 @@
-#pragma once
-
-#include <memory>
-#include <GLFW/glfw3.h>
-#include <model3d.h>
-
-class FreeFloatingApp
-{
-public:
-	static FreeFloatingApp& GetInstance();
-
-	void Run(std::string);
-
-private:
-	FreeFloatingApp();
-
-	void SetParameters();
-
-	void BuildSupportStructure();
-
-private:
-	static std::unique_ptr<FreeFloatingApp> instance;
-	static std::once_flag flag;
-
-	GLFWwindow* offscreen;
-
-	std::unique_ptr<Model3D> model3D;
-};
+#pragma once
+
+#include <memory>
+#include <functional>
+#include <glcontext.h>
+#include <status.h>
+#include <jobcontext.h>
+#include <jobresult.h>
+#include <meshcache.h>
+#include <model3d.h>
+#include <trianglestream.h>
+#include <taskgraph.h>
+#include <workerpool.h>
+
+class zLDNIGenerator;
+struct Plate;
+struct OrientationConfig;
+struct OrientationCandidate;
+struct SearchProgress;
+
+class FreeFloatingApp
+{
+public:
+	// The CPU side of the setup runs on setupPool, which has to outlive
+	// the app, or on two threads of its own when none is given. Callers
+	// with many apps share one pool between them.
+	explicit FreeFloatingApp(WorkerPool* setupPool_ = 0);
+	~FreeFloatingApp();
+
+	// recipe defaults, adjusted by the caller before the job starts
+	static Params DefaultParams();
+
+	// Creates the context and compiles the program. The first Run does it
+	// otherwise, overlapped with reading the mesh; on the GLFW fallback it
+	// has to happen on the main thread.
+	Status Prepare();
+
+	Status Run(const JobContext&, std::string, JobResult* = 0);
+	// runs on a mesh that is already in memory, e.g. a generated one
+	Status Run(const JobContext&, std::unique_ptr<Model3D>, JobResult* = 0);
+	// Runs on the mesh cached under key and calls load only on a miss. A
+	// hit at the same resolution also reuses the fragment lists, so only
+	// the graph stages run again. Fails with IO_ERROR if load gave no mesh.
+	Status Run(const JobContext&, const std::string& key,
+		std::function<std::unique_ptr<Model3D>()> load,
+		JobResult* = 0, bool* cacheHit = 0);
+
+	// Runs every part of a build plate. The parts are packed into as few
+	// frames as MaxPlateFrame allows, each frame is rasterized in one pass and
+	// every part is searched on its own fragments. results gets one entry
+	// per part, with the points on the plate.
+	Status RunPlate(const JobContext&, std::unique_ptr<Plate>,
+		std::vector<JobResult>* results = 0);
+
+	// Ranks build orientations of the mesh, see OrientationSearch. The mesh
+	// keeps its host data, the cost proxy reads the face normals.
+	Status FindOrientation(const JobContext&, std::unique_ptr<Model3D>,
+		const OrientationConfig&, std::vector<OrientationCandidate>& ranked);
+
+	// meshes kept for the keyed Run
+	void SetCacheSize(size_t entries);
+
+	// the recipe itself, on whatever GL context is current; progressive
+	// with progress, see SearchProgress
+	static Status BuildSupportStructure(const JobContext&, TriMesh*, JobResult*,
+		const SearchProgress* progress = 0);
+
+private:
+	struct CacheEntry {
+		std::unique_ptr<Model3D> mesh;
+		float pixelWidth;
+		std::unique_ptr<zLDNIGenerator> ldni;
+	};
+
+	// the context and program tasks; the future is ok once both are ready
+	TaskFuture<Status> AddSetup(TaskGraph&);
+	Status CreateContext();
+
+private:
+	std::unique_ptr<GLContext> gl;
+	bool prepared;
+	// runs the CPU side of the setup, such as reading the mesh
+	WorkerPool* setupPool;
+	std::unique_ptr<WorkerPool> ownPool;
+	MeshCache<CacheEntry> cache;
+};
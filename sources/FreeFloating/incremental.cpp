@@ -0,0 +1,66 @@
+#include "incremental.h"
+
+#include <pipelinestage.h>
+#include <metrics.h>
+using glm::vec3;
+using glm::ivec4;
+
+Status IncrementalSupport::Run(TriMesh* mesh)
+{
+	supportPoints.clear();
+	trace = CoverTrace();
+	frame.reset(new zLDNIGenerator(context, mesh));
+	Status status = frame->GetStatus();
+	if (!status.IsOk()) {
+		frame.reset();
+		return status;
+	}
+	{
+		PIPELINE_STAGE("read columns");
+		columns.Read(*frame);
+	}
+	return Search(ivec4(0));
+}
+
+Status IncrementalSupport::Update(TriMesh* edited,
+	const std::vector<vec3>& changed)
+{
+	if (!frame)
+		return Run(edited);
+
+	vec3 lo = edited->aabb.GetMin(), hi = edited->aabb.GetMax();
+	std::vector<vec3> corners;
+	for (int c = 0; c < 8; c++)
+		corners.push_back(vec3(c & 1 ? hi.x : lo.x, c & 2 ? hi.y : lo.y,
+			c & 4 ? hi.z : lo.z));
+	if (!columns.Contains(corners))
+		return Run(edited);
+
+	ivec4 dirty = columns.Footprint(changed);
+	if (dirty[2] == 0)
+		return Status();
+
+	{
+		PIPELINE_STAGE("patch columns");
+		zLDNIGenerator patch(context, edited, *frame, dirty);
+		if (!patch.GetStatus().IsOk())
+			return patch.GetStatus();
+		columns.Patch(patch, dirty);
+	}
+	Metrics::GetInstance().GetCounter("patched columns").Add(
+		(long long)dirty[2] * dirty[3]);
+	return Search(dirty);
+}
+
+Status IncrementalSupport::Search(ivec4 dirty)
+{
+	SupportPointFinder supportPointFinder(context);
+	Status status = supportPointFinder.Run(columns, trace, dirty);
+	if (!status.IsOk()) {
+		// the next update starts over
+		frame.reset();
+		return status;
+	}
+	supportPoints = supportPointFinder.GetSupportPoints();
+	return status;
+}
\ No newline at end of file
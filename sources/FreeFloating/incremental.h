@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include <jobcontext.h>
+#include <status.h>
+#include <model3d.h>
+
+#include "zldni.h"
+#include "depthcolumns.h"
+#include "supportpoint.h"
+
+// FreeFloating for a mesh that is edited a little at a time. Run keeps the
+// sorted fragments of every column and the covers of the search; Update
+// renders only the columns under the changed triangles, patches them in
+// and searches again, replaying every cover that stayed clear of them. A
+// zero-penalty surface carries a cover arbitrarily far, so what has to be
+// searched again is read from the covers rather than from a radius; the
+// points are those of a full search on the edited mesh in the same frame.
+// An edit that leaves the frame of the first run runs everything again.
+// Only the rendering is local: the graph and the z order are still built
+// over every column, as the full search breaks ties in z by an unstable
+// sort of all vertices. An update costs 0.6 to 0.95 of a full search on
+// the validator's slab edit, against 3 to 13 ms to patch the columns.
+class IncrementalSupport
+{
+public:
+	IncrementalSupport(const Params& params) : context(params) {}
+	~IncrementalSupport() {}
+
+	// both need a current context, the same one for every call
+	Status Run(TriMesh*);
+	// changed holds the corners of every removed and every added triangle;
+	// the first Update is a Run
+	Status Update(TriMesh* edited, const std::vector<glm::vec3>& changed);
+
+	const JobContext& GetContext() const {
+		return context;
+	}
+	const std::vector<glm::vec3>& GetSupportPoints() const {
+		return supportPoints;
+	}
+
+private:
+	IncrementalSupport(const IncrementalSupport&) = delete;
+	IncrementalSupport& operator=(const IncrementalSupport&) = delete;
+
+	Status Search(glm::ivec4 dirty);
+
+private:
+	const JobContext context;
+	// the frame of the first run, without its lists
+	std::unique_ptr<zLDNIGenerator> frame;
+	DepthColumns columns;
+	CoverTrace trace;
+	std::vector<glm::vec3> supportPoints;
+};
@@ -0,0 +1,364 @@
+#include "orientation.h"
+#include "supportpoint.h"
+
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <taskgraph.h>
+#include <pipelinestage.h>
+#include <glm/gtc/matrix_transform.hpp>
+using glm::vec3;
+using glm::mat4;
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	const float PI = 3.141592f;
+
+	double Seconds(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	Params CoarseParams(Params params, int dpi)
+	{
+		params.dpi = dpi;
+		params.pixelWidth = 25.4 / dpi;
+		return params;
+	}
+
+	int PoolSize(int threads)
+	{
+		if (threads > 0)
+			return threads;
+		return std::max(1, (int)std::thread::hardware_concurrency());
+	}
+
+	// the rotation that turns up to +Z
+	mat4 RotationToUp(vec3 up)
+	{
+		vec3 axis = glm::cross(up, vec3(0, 0, 1));
+		float s = glm::length(axis);
+		float c = up.z;
+		if (s < 1e-6f)
+			return c > 0 ? mat4(1.0f) :
+				glm::rotate(mat4(1.0f), PI, vec3(1, 0, 0));
+		return glm::rotate(mat4(1.0f), atan2(s, c), axis / s);
+	}
+}
+
+OrientationConfig::OrientationConfig()
+	: candidates(64), refineSeeds(4), refineSamples(6), finalists(3),
+	coarseDpi(50), areaWeight(1.0f), threads(0)
+{
+}
+
+OrientationSearch::OrientationSearch(const JobContext& context_,
+	const OrientationConfig& config_)
+	: context(context_), config(config_),
+	coarse(CoarseParams(context_.params, config_.coarseDpi)),
+	pool(PoolSize(config_.threads)), mesh(0)
+{
+}
+
+OrientationCandidate OrientationSearch::Candidate(vec3 up) const
+{
+	OrientationCandidate candidate;
+	candidate.up = glm::normalize(up);
+	candidate.rotation = RotationToUp(candidate.up);
+	candidate.overhangArea = candidate.supportedVolume = candidate.cost = 0;
+	candidate.seconds = 0;
+	candidate.supportPoints = -1;
+	candidate.fullSeconds = 0;
+	return candidate;
+}
+
+Status OrientationSearch::Run(Model3D* model3D,
+	std::vector<OrientationCandidate>& ranked)
+{
+	ranked.clear();
+	mesh = &model3D->mesh;
+	if (mesh->FaceCount() == 0)
+		return Status(Status::INVALID_ARGUMENT,
+			"The orientation search needs the mesh on the host");
+	if (config.candidates < 1)
+		return Status(Status::INVALID_ARGUMENT, "No orientation to try");
+
+	{
+		PIPELINE_STAGE("face normals");
+		normals.resize(mesh->FaceCount());
+		areas.resize(mesh->FaceCount());
+#pragma omp parallel for
+		for (long long f = 0; f < (long long)mesh->FaceCount(); f++) {
+			vec3 a = mesh->Position(mesh->indices[f * 3]);
+			vec3 b = mesh->Position(mesh->indices[f * 3 + 1]);
+			vec3 c = mesh->Position(mesh->indices[f * 3 + 2]);
+			vec3 n = glm::cross(b - a, c - a);
+			float len = glm::length(n);
+			normals[f] = len > 0.0f ? n / len : vec3(0.0f);
+			areas[f] = len * 0.5f;
+		}
+	}
+
+	std::vector<OrientationCandidate> candidates;
+	float golden = PI * (3.0f - sqrt(5.0f));
+	for (int i = 0; i < config.candidates; i++) {
+		float z = 1.0f - 2.0f * (i + 0.5f) / config.candidates;
+		float r = sqrt(std::max(0.0f, 1.0f - z * z));
+		float phi = golden * i;
+		candidates.push_back(Candidate(vec3(r * cos(phi), r * sin(phi), z)));
+	}
+
+	auto byCost = [](const OrientationCandidate& a,
+		const OrientationCandidate& b) {
+			return a.cost < b.cost;
+		};
+	Status status;
+	{
+		PIPELINE_STAGE("coarse orientations");
+		status = Evaluate(model3D, candidates, 0);
+		if (!status.IsOk())
+			return status;
+	}
+	std::stable_sort(candidates.begin(), candidates.end(), byCost);
+
+	// a ring at half the spacing of the sphere around each of the best
+	size_t first = candidates.size();
+	float spacing = sqrt(4.0f * PI / config.candidates);
+	float along = cos(spacing / 2), across = sin(spacing / 2);
+	int seeds = std::min<int>(config.refineSeeds, first);
+	for (int s = 0; s < seeds; s++) {
+		vec3 up = candidates[s].up;
+		vec3 side = fabs(up.z) < 0.9f ? vec3(0, 0, 1) : vec3(1, 0, 0);
+		vec3 u = glm::normalize(glm::cross(up, side));
+		vec3 v = glm::cross(up, u);
+		for (int k = 0; k < config.refineSamples; k++) {
+			float t = 2.0f * PI * k / config.refineSamples;
+			float x = cos(t), y = sin(t);
+			candidates.push_back(Candidate(up * along + (u * x + v * y) * across));
+		}
+	}
+	if (candidates.size() > first) {
+		PIPELINE_STAGE("refine orientations");
+		status = Evaluate(model3D, candidates, first);
+		if (!status.IsOk())
+			return status;
+	}
+	std::stable_sort(candidates.begin(), candidates.end(), byCost);
+
+	{
+		PIPELINE_STAGE("full runs");
+		status = RunFinalists(model3D, candidates);
+		if (!status.IsOk())
+			return status;
+	}
+	// the finalists that ran lead, the rest keep their order by cost
+	std::vector<OrientationCandidate>::iterator ran = std::stable_partition(
+		candidates.begin(), candidates.end(),
+		[](const OrientationCandidate& candidate) {
+			return candidate.supportPoints >= 0;
+		});
+	std::stable_sort(candidates.begin(), ran,
+		[](const OrientationCandidate& a, const OrientationCandidate& b) {
+			return a.supportPoints < b.supportPoints;
+		});
+
+	Metrics::GetInstance().GetCounter("orientations").Add(candidates.size());
+	ranked = std::move(candidates);
+	return Status();
+}
+
+Status OrientationSearch::Evaluate(Model3D* model3D,
+	std::vector<OrientationCandidate>& candidates, size_t first)
+{
+	size_t n = candidates.size() - first;
+	std::vector<double> renderSeconds(n), scanSeconds(n), areaSeconds(n);
+	std::vector<TaskFuture<Status>> scanned;
+	size_t window = 2 * pool.Size();
+
+	TaskGraph graph(pool);
+	for (size_t i = 0; i < n; i++) {
+		OrientationCandidate* candidate = &candidates[first + i];
+		double* renderTime = &renderSeconds[i];
+		double* scanTime = &scanSeconds[i];
+		double* areaTime = &areaSeconds[i];
+
+		auto render = [this, model3D, candidate, renderTime] {
+			Clock::time_point start = Clock::now();
+			std::vector<PlatePart> parts(1,
+				PlatePart(model3D, candidate->rotation));
+			std::unique_ptr<zLDNIGenerator> generator(
+				new zLDNIGenerator(coarse, parts));
+			*renderTime = Seconds(start);
+			return generator;
+		};
+		// a render waits for the scan a window back, so only that many
+		// lists are held at a time
+		TaskFuture<std::unique_ptr<zLDNIGenerator>> ldni = i < window ?
+			graph.Add("coarse ldni", TaskGraph::CALLER, render) :
+			graph.Add("coarse ldni", TaskGraph::CALLER,
+				[render](Status&) { return render(); }, scanned[i - window]);
+		// the lists are read back, so the generator is freed here without
+		// touching the context
+		scanned.push_back(graph.Add("column scan", TaskGraph::ANY,
+			[this, candidate, scanTime](std::unique_ptr<zLDNIGenerator>& generator) {
+				Clock::time_point start = Clock::now();
+				Status status = generator->GetStatus();
+				if (status.IsOk())
+					candidate->supportedVolume = SupportedVolume(*generator);
+				generator.reset();
+				*scanTime = Seconds(start);
+				return status;
+			}, ldni));
+		graph.Add("overhang area", TaskGraph::ANY, [this, candidate, areaTime] {
+			Clock::time_point start = Clock::now();
+			candidate->overhangArea = OverhangArea(candidate->up);
+			*areaTime = Seconds(start);
+			return 0;
+			});
+	}
+	graph.Run();
+
+	for (size_t i = 0; i < n; i++) {
+		if (!scanned[i].Get().IsOk())
+			return scanned[i].Get();
+
+		OrientationCandidate& candidate = candidates[first + i];
+		candidate.cost = candidate.supportedVolume +
+			config.areaWeight * candidate.overhangArea;
+		candidate.seconds = renderSeconds[i] + scanSeconds[i] + areaSeconds[i];
+	}
+	return Status();
+}
+
+Status OrientationSearch::RunFinalists(Model3D* model3D,
+	std::vector<OrientationCandidate>& candidates)
+{
+	size_t wanted = std::min<size_t>(std::max(0, config.finalists),
+		candidates.size());
+	size_t next = 0, ran = 0;
+	// a finalist too big for the frame is replaced by the next candidate
+	while (ran < wanted && next < candidates.size()) {
+		size_t first = next;
+		next = std::min(candidates.size(), next + wanted - ran);
+		Status status = RunFull(model3D, candidates, first, next);
+		if (!status.IsOk())
+			return status;
+		for (size_t i = first; i < next; i++) {
+			if (candidates[i].supportPoints >= 0)
+				ran++;
+			else
+				Metrics::GetInstance().GetCounter("skipped finalists").Add(1);
+		}
+	}
+	return Status();
+}
+
+Status OrientationSearch::RunFull(Model3D* model3D,
+	std::vector<OrientationCandidate>& candidates, size_t first, size_t last)
+{
+	size_t n = last - first;
+	std::vector<double> renderSeconds(n);
+	std::vector<TaskFuture<Status>> searched;
+
+	// the search of one finalist overlaps the render of the next
+	TaskGraph graph(pool);
+	for (size_t i = 0; i < n; i++) {
+		OrientationCandidate* candidate = &candidates[first + i];
+		double* renderTime = &renderSeconds[i];
+
+		TaskFuture<std::unique_ptr<zLDNIGenerator>> ldni = graph.Add(
+			"full ldni", TaskGraph::CALLER, [this, model3D, candidate, renderTime] {
+				Clock::time_point start = Clock::now();
+				std::vector<PlatePart> parts(1,
+					PlatePart(model3D, candidate->rotation));
+				std::unique_ptr<zLDNIGenerator> generator(
+					new zLDNIGenerator(context, parts));
+				*renderTime = Seconds(start);
+				return generator;
+			});
+		searched.push_back(graph.Add("support points", TaskGraph::ANY,
+			[this, candidate](std::unique_ptr<zLDNIGenerator>& generator) {
+				Clock::time_point start = Clock::now();
+				Status status = generator->GetStatus();
+				if (status.GetCode() == Status::MODEL_TOO_BIG) {
+					candidate->skipReason = status.Message();
+					generator.reset();
+					return Status();
+				}
+				SupportPointFinder supportPointFinder(context);
+				status = supportPointFinder.Run(*generator);
+				if (status.IsOk())
+					candidate->supportPoints =
+						supportPointFinder.GetSupportPoints().size();
+				generator.reset();
+				candidate->fullSeconds = Seconds(start);
+				return status;
+			}, ldni));
+	}
+	graph.Run();
+
+	for (size_t i = 0; i < n; i++) {
+		if (!searched[i].Get().IsOk())
+			return searched[i].Get();
+		if (candidates[first + i].supportPoints >= 0)
+			candidates[first + i].fullSeconds += renderSeconds[i];
+	}
+	return Status();
+}
+
+float OrientationSearch::OverhangArea(vec3 up) const
+{
+	// the rotated z of a normal or a position is its component along up
+	float bottom = std::numeric_limits<float>::max();
+	for (size_t v = 0; v < mesh->VertexCount(); v++)
+		bottom = std::min(bottom, glm::dot(mesh->Position(v), up));
+	float resting = bottom + context.params.sliceThickness;
+
+	double area = 0;
+	for (size_t f = 0; f < normals.size(); f++) {
+		if (-glm::dot(normals[f], up) <= context.cosOverhangAngle)
+			continue;
+		// a face within a layer of the plate rests on it
+		float top = bottom;
+		for (int k = 0; k < 3; k++) {
+			vec3 p = mesh->Position(mesh->indices[f * 3 + k]);
+			top = std::max(top, glm::dot(p, up));
+		}
+		if (top > resting)
+			area += areas[f];
+	}
+	return area;
+}
+
+float OrientationSearch::SupportedVolume(zLDNIGenerator& generator) const
+{
+	int cols, rows;
+	generator.GetImageSize(cols, rows);
+
+	// every gap below an entry, down to the part below or to the plate,
+	// which is the lowest fragment
+	double gaps = 0;
+	float plate = std::numeric_limits<float>::max();
+	std::vector<float> lowest;
+	std::vector<vec3> list;
+	for (int i = 0; i < rows; i++) {
+		for (int j = 0; j < cols; j++) {
+			list.clear();
+			generator.GetSortedList(list, i, j);
+			if (list.empty())
+				continue;
+
+			plate = std::min(plate, list[0].z);
+			lowest.push_back(list[0].z);
+			for (size_t k = 2; k < list.size(); k += 2)
+				gaps += list[k].z - list[k - 1].z;
+		}
+	}
+	for (float z : lowest)
+		gaps += z - plate;
+
+	float pixelWidth = coarse.params.pixelWidth;
+	return gaps * pixelWidth * pixelWidth;
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <jobcontext.h>
+#include <status.h>
+#include <model3d.h>
+#include <workerpool.h>
+
+class zLDNIGenerator;
+
+struct OrientationConfig {
+	OrientationConfig();
+
+	// directions on the Fibonacci sphere
+	int candidates;
+	// best candidates refined locally, and the directions tried around each
+	int refineSeeds;
+	int refineSamples;
+	// best candidates that get the full FreeFloating run
+	int finalists;
+	// resolution of the coarse fragment lists
+	int coarseDpi;
+	// support, in mm, charged per mm2 of overhang on top of the volume
+	float areaWeight;
+	// workers of the CPU evaluation, zero for one per core
+	int threads;
+};
+
+struct OrientationCandidate {
+	// the direction of the part that ends up pointing up
+	glm::vec3 up;
+	glm::mat4 rotation;
+
+	// the proxy: overhang area from the face normals, without the faces
+	// resting on the plate, and the volume under the downward facing
+	// surfaces from coarse fragment lists
+	float overhangArea;
+	float supportedVolume;
+	float cost;
+	double seconds;
+
+	// -1 unless the candidate got the full run
+	int supportPoints;
+	double fullSeconds;
+	// why a finalist could not get the full run, e.g. a rotated footprint
+	// too big for the frame; the next candidate took its place
+	std::string skipReason;
+};
+
+// Ranks build orientations by a support cost proxy. The candidates are
+// rendered one after the other on the GL thread at coarse resolution while
+// the workers scan the columns and sum the overhang area of the earlier
+// ones, so the evaluation costs about one coarse render per candidate.
+// Only the finalists run the full recipe; they lead the ranking by their
+// number of support points, the rest follow by cost. A finalist too big
+// for the frame at full resolution is passed over for the next one.
+class OrientationSearch
+{
+public:
+	OrientationSearch(const JobContext& context_, const OrientationConfig&);
+	~OrientationSearch() {}
+
+	// needs a current context; the mesh keeps its host data for the normals
+	Status Run(Model3D*, std::vector<OrientationCandidate>& ranked);
+
+private:
+	OrientationCandidate Candidate(glm::vec3 up) const;
+	Status Evaluate(Model3D*, std::vector<OrientationCandidate>&, size_t first);
+	Status RunFinalists(Model3D*, std::vector<OrientationCandidate>&);
+	Status RunFull(Model3D*, std::vector<OrientationCandidate>&, size_t first,
+		size_t last);
+	float OverhangArea(glm::vec3 up) const;
+	float SupportedVolume(zLDNIGenerator&) const;
+
+private:
+	const JobContext& context;
+	OrientationConfig config;
+	JobContext coarse;
+	WorkerPool pool;
+
+	// the mesh of the run, and the unit normal and area of every face
+	const MeshData* mesh;
+	std::vector<glm::vec3> normals;
+	std::vector<float> areas;
+};
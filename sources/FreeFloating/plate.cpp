@@ -0,0 +1,124 @@
+#include "plate.h"
+
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <numeric>
+#include <algorithm>
+#include <filesystem>
+#include <glm/gtc/matrix_transform.hpp>
+using glm::vec3;
+using glm::mat4;
+namespace fs = std::filesystem;
+
+Status ReadPlate(const std::string& path, Plate& plate)
+{
+	std::ifstream in(path);
+	if (!in)
+		return Status(Status::IO_ERROR, "Unable to open plate " + path);
+
+	fs::path base = fs::path(path).parent_path();
+	std::map<std::string, Model3D*> read;
+	std::string line;
+	for (int lineNo = 1; std::getline(in, line); lineNo++) {
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		size_t first = line.find_first_not_of(" \t");
+		if (first == std::string::npos || line[first] == '#')
+			continue;
+
+		// the offset comes whole or not at all, a missing value is an
+		// error rather than a zero
+		std::stringstream stream(line);
+		std::string mesh;
+		std::vector<float> values;
+		float value;
+		stream >> std::quoted(mesh);
+		while (stream >> value)
+			values.push_back(value);
+		if (!stream.eof() || (values.size() != 0 && values.size() != 3 &&
+			values.size() != 4)) {
+			std::stringstream message;
+			message << path << ":" << lineNo << " : expected a mesh, then "
+				"optionally an offset x y z and a rotation";
+			return Status(Status::INVALID_ARGUMENT, message.str());
+		}
+		values.resize(4, 0.0f);
+		float x = values[0], y = values[1], z = values[2], degrees = values[3];
+
+		fs::path meshPath(mesh);
+		if (meshPath.is_relative())
+			meshPath = base / meshPath;
+		Model3D*& model3D = read[meshPath.string()];
+		if (!model3D) {
+			std::unique_ptr<Model3D> loaded = Model3D::Load(meshPath.string());
+			if (!loaded)
+				return Status(Status::IO_ERROR,
+					"Unable to read " + meshPath.string());
+			model3D = loaded.get();
+			plate.meshes.push_back(std::move(loaded));
+		}
+
+		mat4 transform = glm::translate(mat4(1.0f), vec3(x, y, z)) *
+			glm::rotate(mat4(1.0f), glm::radians(degrees), vec3(0, 0, 1));
+		plate.parts.push_back(PlatePart(model3D, transform));
+		plate.names.push_back(mesh);
+	}
+	return Status();
+}
+
+Status PackPlate(const JobContext& context, std::vector<PlatePart>& parts,
+	std::vector<std::vector<int>>& frames)
+{
+	frames.clear();
+	if (parts.empty())
+		return Status(Status::INVALID_ARGUMENT, "The plate has no parts");
+
+	// the generator adds a margin of ten pixels and rounds the frame; a
+	// lone part renders without part IDs and may use the whole FBO
+	const Params& params = context.params;
+	int maxSize = parts.size() > 1 ? zLDNIGenerator::MaxPlateFrame(params) :
+		params.maxFBOSize;
+	float limit = (maxSize - 11) * params.pixelWidth;
+	float gap = 2 * params.pixelWidth;
+
+	std::vector<AABB> bounds;
+	for (size_t p = 0; p < parts.size(); p++) {
+		bounds.push_back(parts[p].PlateBounds());
+		vec3 size = bounds.back().GetSize();
+		if (size.x > limit || size.y > limit) {
+			std::stringstream message;
+			message << "Part " << p << " is too big for a frame";
+			return Status(Status::MODEL_TOO_BIG, message.str());
+		}
+	}
+
+	std::vector<int> order(parts.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&bounds](int a, int b) {
+		return bounds[a].GetSize().y > bounds[b].GetSize().y;
+		});
+
+	float x = 0, y = 0, shelf = 0;
+	frames.push_back(std::vector<int>());
+	for (int p : order) {
+		vec3 size = bounds[p].GetSize();
+		if (x > 0 && x + size.x > limit) {
+			x = 0;
+			y += shelf + gap;
+			shelf = 0;
+		}
+		if (y > 0 && y + size.y > limit) {
+			frames.push_back(std::vector<int>());
+			x = y = shelf = 0;
+		}
+
+		vec3 lo = bounds[p].GetMin();
+		parts[p].shift = vec3(x - lo.x, y - lo.y, 0);
+		frames.back().push_back(p);
+		x += size.x + gap;
+		shelf = std::max(shelf, size.y);
+	}
+	return Status();
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <jobcontext.h>
+#include <status.h>
+#include <model3d.h>
+
+#include "zldni.h"
+
+// A build plate: every mesh read once and the parts placed from them, so
+// copies of a part share their buffers.
+struct Plate {
+	std::vector<std::unique_ptr<Model3D>> meshes;
+	std::vector<PlatePart> parts;
+	// the mesh path of each part
+	std::vector<std::string> names;
+};
+
+// Reads a plate file with one part per line: the mesh path, relative to
+// the file, then an optional offset x y z and, after it, an optional
+// rotation about Z in degrees. A partial offset is an error. Paths with
+// spaces are quoted and lines starting with # are skipped.
+Status ReadPlate(const std::string& path, Plate&);
+
+// Packs the footprints of the parts into frames of at most
+// zLDNIGenerator::MaxPlateFrame pixels, shelf by shelf with the tallest
+// parts first, and sets the shift of every part. frames gets the parts
+// rendered together in each frame.
+Status PackPlate(const JobContext&, std::vector<PlatePart>&,
+	std::vector<std::vector<int>>& frames);
@@ -1,143 +1,395 @@
-#include "supportpoint.h"
-
-#include <params.h>
-#include <stopwatch.h>
-using glm::vec3;
-using glm::uvec3;
-using std::chrono::nanoseconds;
-using std::cout;
-using std::endl;
-
-void SupportPointFinder::Run(Model3D* model3D)
-{
-	zLDNIGenerator generator(model3D);
-
-	StopWatch::GetInstance().Hit();
-	ConstructGraph(generator);
-	nanoseconds t = StopWatch::GetInstance().Hit();
-	cout << "time for constructing graph : " << t.count() << endl;
-	FindSupportPoints();
-	t = StopWatch::GetInstance().Hit();
-	cout << "time for finding support points : " << t.count() << endl;
-}
-
-void SupportPointFinder::ConstructGraph(zLDNIGenerator& generator)
-{
-	generator.GetImageSize(cols, rows);
-	intersections.resize(rows);
-	for (int i = 0; i < rows; i++)
-		intersections[i].resize(cols);
-
-	for (int i = 0; i < rows; i++) {
-		for (int j = 0; j < cols; j++) {
-			std::vector<vec3> list;
-			generator.GetSortedList(list, i, j);
-			if (list.empty())
-				continue;
-
-			intersections[i][j].resize(list.size());
-			for (int k = 0; k < list.size(); k++) {
-				intersections[i][j][k].first = list[k];
-				Vertex v = boost::add_vertex(VertexProp(list[k], true), g);
-				intersections[i][j][k].second = v;
-			}
-		}
-	}
-	for (int i = 0; i < rows; i++) {
-		for (int j = 0; j < cols; j++) {
-			for (int k = 0; k < intersections[i][j].size(); k += 2) {
-				vec3 pos = intersections[i][j][k].first;
-				Vertex d = intersections[i][j][k].second;
-
-				MakeEdgeIfConnected(i - 1, j - 1, pos, d);
-				MakeEdgeIfConnected(i - 1, j, pos, d);
-				MakeEdgeIfConnected(i - 1, j + 1, pos, d);
-				MakeEdgeIfConnected(i, j - 1, pos, d);
-				MakeEdgeIfConnected(i, j + 1, pos, d);
-				MakeEdgeIfConnected(i + 1, j - 1, pos, d);
-				MakeEdgeIfConnected(i + 1, j, pos, d);
-				MakeEdgeIfConnected(i + 1, j + 1, pos, d);
-
-				Vertex up = intersections[i][j][k + 1].second;
-				boost::add_edge(d, up, EdgeProp(0), g);
-			}
-		}
-	}
-}
-
-void SupportPointFinder::MakeEdgeIfConnected(int row, int col,
-	glm::vec3 pos, Vertex d)
-{
-	if (row > rows - 1 || row < 0 || col > cols - 1 || col < 0)
-		return;
-
-	Params& params = Params::GetInstance();
-	int machineZ =
-		ceil((pos[2] - params.sliceThickness * 0.5) / params.sliceThickness);
-	for (int i = 0; i < intersections[row][col].size(); i += 2) {
-		float entryZ = intersections[row][col][i].first[2];
-		int machineEntryZ = ceil((entryZ - params.sliceThickness * 0.5) /
-			params.sliceThickness);
-
-		if (machineEntryZ > machineZ)
-			return;
-
-		float exitZ = intersections[row][col][i + 1].first[2];
-		int machineExitZ =
-			ceil((exitZ - params.sliceThickness * 0.5) / params.sliceThickness);
-
-		if (machineExitZ >= machineZ)
-		{
-			Vertex s = intersections[row][col][i].second;
-			vec3 dir = glm::normalize(pos - intersections[row][col][i].first);
-			float angle = glm::acos(glm::dot(vec3(0, 0, 1), dir));
-			float weight = 0;
-			if (angle > params.overhangAngle)
-				weight = std::min(1.0f, 1.0f / (3.141592f / 2.0f - params.overhangAngle) *
-				(angle - params.overhangAngle));
-			boost::add_edge(s, d, EdgeProp(weight), g);
-			return;
-		}
-	}
-}
-
-void SupportPointFinder::FindSupportPoints()
-{
-	Params& params = Params::GetInstance();
-	float coverage = params.effectiveRadius / params.pixelWidth;
-
-	std::vector<std::pair<Vertex, float>> vertices;
-
-	Graph::vertex_iterator vi, v_end;
-	for (boost::tie(vi, v_end) = boost::vertices(g); vi != v_end; vi++)
-		vertices.push_back(std::make_pair(*vi, g[*vi].pos[2]));
-
-	std::sort(vertices.begin(), vertices.end(),
-		[](std::pair<Vertex, float> a, std::pair<Vertex, float> b) {
-			return a.second < b.second;
-		});
-
-	for (int i = 0; i < vertices.size(); i++) {
-		Vertex v = vertices[i].first;
-		if (!g[v].floatable)
-			continue;
-
-		supportPoints.push_back(g[v].pos);
-
-		DijkstraVisitor<boost::property_map<Graph, float VertexProp::*>::type,
-			boost::property_map<Graph, bool VertexProp::*>::type>
-			dijkstraVisitor(coverage,
-				boost::get(&VertexProp::distance, g),
-				boost::get(&VertexProp::floatable, g));
-		try
-		{
-			boost::dijkstra_shortest_paths(g, v,
-				boost::weight_map(boost::get(&EdgeProp::penalty, g))
-				.distance_map(boost::get(&VertexProp::distance, g))
-				.visitor(dijkstraVisitor));
-		}
-		catch (ExceedCoverage&)
-		{
-		}
-	}
+#include "supportpoint.h"
+
+#include <pipelinestage.h>
+#include <metrics.h>
+using glm::vec3;
+using glm::uvec3;
+
+Status SupportPointFinder::Run(TriMesh* mesh)
+{
+	zLDNIGenerator generator(context, mesh);
+	return Run(generator);
+}
+
+Status SupportPointFinder::Run(zLDNIGenerator& generator, int part)
+{
+	if (!generator.GetStatus().IsOk())
+		return generator.GetStatus();
+
+	{
+		PIPELINE_STAGE("construct graph");
+		ConstructGraph(generator, part);
+	}
+	{
+		PIPELINE_STAGE("find support points");
+		FindSupportPoints();
+	}
+	return Status();
+}
+
+Status SupportPointFinder::Run(const DepthColumns& columns, CoverTrace& trace_,
+	glm::ivec4 dirty)
+{
+	trace = &trace_;
+	previous = std::move(trace_);
+	trace_ = CoverTrace();
+	{
+		PIPELINE_STAGE("construct graph");
+		ReadIntersections(columns);
+		ConnectIntersections();
+		TrackGraph();
+	}
+	trace->offsets.push_back(0);
+	PlanReplay(dirty);
+
+	PIPELINE_STAGE("find support points");
+	FindSupportPoints();
+	MEMORY_TRACK("cover trace",
+		(trace->firstVertex.size() + trace->sources.size() +
+			trace->offsets.size() + trace->settled.size()) * sizeof(uint32_t) +
+		trace->reach.size() * sizeof(glm::ivec4));
+
+	previous = CoverTrace();
+	trace = 0;
+	return Status();
+}
+
+void SupportPointFinder::ConstructGraph(zLDNIGenerator& generator, int part)
+{
+	ReadIntersections(generator, part);
+	ConnectIntersections();
+	TrackGraph();
+}
+
+void SupportPointFinder::TrackGraph()
+{
+	size_t nIntersections = 0;
+	for (int i = 0; i < rows; i++) {
+		for (int j = 0; j < cols; j++)
+			nIntersections += intersections[i][j].size();
+	}
+	Metrics& metrics = Metrics::GetInstance();
+	metrics.GetCounter("graph vertices").Add(boost::num_vertices(g));
+	metrics.GetCounter("graph edges").Add(boost::num_edges(g));
+
+	MEMORY_TRACK("intersections",
+		rows * cols * sizeof(intersections[0][0]) +
+		nIntersections * sizeof(intersections[0][0][0]));
+	// estimated from the vecS layout: an out-edge vector and the property
+	// per vertex, a target and a heap-allocated property per edge
+	MEMORY_TRACK("graph",
+		boost::num_vertices(g) * (sizeof(std::vector<Edge>) + sizeof(VertexProp)) +
+		boost::num_edges(g) * (sizeof(Vertex) + sizeof(void*) + sizeof(EdgeProp)));
+}
+
+void SupportPointFinder::ReadIntersections(zLDNIGenerator& generator, int part)
+{
+	// the graph only spans the window of the part
+	glm::ivec4 window = generator.GetWindow(part);
+	cols = window[2];
+	rows = window[3];
+	intersections.resize(rows);
+	for (int i = 0; i < rows; i++)
+		intersections[i].resize(cols);
+
+	for (int i = 0; i < rows; i++) {
+		for (int j = 0; j < cols; j++) {
+			std::vector<vec3> list;
+			generator.GetSortedList(list, window[1] + i, window[0] + j, part);
+			if (list.empty())
+				continue;
+
+			intersections[i][j].resize(list.size());
+			for (int k = 0; k < list.size(); k++) {
+				intersections[i][j][k].first = list[k];
+				Vertex v = boost::add_vertex(VertexProp(list[k], true), g);
+				intersections[i][j][k].second = v;
+			}
+		}
+	}
+}
+
+void SupportPointFinder::ReadIntersections(const DepthColumns& columns)
+{
+	cols = columns.Width();
+	rows = columns.Height();
+	intersections.resize(rows);
+	for (int i = 0; i < rows; i++)
+		intersections[i].resize(cols);
+
+	std::vector<uint32_t>& firstVertex = trace->firstVertex;
+	for (int i = 0; i < rows; i++) {
+		for (int j = 0; j < cols; j++) {
+			const vec3* column = columns.Column(i, j);
+			size_t count = columns.Count(i, j);
+			firstVertex.push_back(boost::num_vertices(g));
+
+			intersections[i][j].resize(count);
+			for (size_t k = 0; k < count; k++) {
+				intersections[i][j][k].first = column[k];
+				Vertex v = boost::add_vertex(VertexProp(column[k], true), g);
+				intersections[i][j][k].second = v;
+				columnOf.push_back(i * cols + j);
+			}
+		}
+	}
+	firstVertex.push_back(boost::num_vertices(g));
+}
+
+void SupportPointFinder::PlanReplay(glm::ivec4 dirty)
+{
+	replayOf.assign(boost::num_vertices(g), -1);
+	if (previous.firstVertex.size() != trace->firstVertex.size())
+		return;
+
+	// the vertices of unchanged columns keep their place in the column
+	remap.assign(previous.firstVertex.back(), -1);
+	for (int c = 0; c + 1 < trace->firstVertex.size(); c++) {
+		int row = c / cols, col = c % cols;
+		if (col >= dirty[0] && col < dirty[0] + dirty[2] &&
+			row >= dirty[1] && row < dirty[1] + dirty[3])
+			continue;
+		uint32_t first = previous.firstVertex[c];
+		uint32_t count = previous.firstVertex[c + 1] - first;
+		if (count != trace->firstVertex[c + 1] - trace->firstVertex[c])
+			continue;
+		for (uint32_t k = 0; k < count; k++)
+			remap[first + k] = trace->firstVertex[c] + k;
+	}
+
+	// The edges of a vertex come from its own and the neighbouring
+	// columns, so a cover that discovered nothing within a pixel of the
+	// changed columns would discover the same vertices, edges and
+	// distances again.
+	glm::ivec4 changed(dirty[0] - 1, dirty[1] - 1,
+		dirty[0] + dirty[2], dirty[1] + dirty[3]);
+	for (int r = 0; r < previous.sources.size(); r++) {
+		const glm::ivec4& reach = previous.reach[r];
+		if (dirty[2] > 0 && reach[0] <= changed[2] && reach[2] >= changed[0] &&
+			reach[1] <= changed[3] && reach[3] >= changed[1])
+			continue;
+		int64_t source = remap[previous.sources[r]];
+		if (source >= 0)
+			replayOf[source] = r;
+	}
+}
+
+void SupportPointFinder::ConnectIntersections()
+{
+	for (int i = 0; i < rows; i++) {
+		for (int j = 0; j < cols; j++) {
+			for (int k = 0; k < intersections[i][j].size(); k += 2) {
+				vec3 pos = intersections[i][j][k].first;
+				Vertex d = intersections[i][j][k].second;
+
+				MakeEdgeIfConnected(i - 1, j - 1, pos, d);
+				MakeEdgeIfConnected(i - 1, j, pos, d);
+				MakeEdgeIfConnected(i - 1, j + 1, pos, d);
+				MakeEdgeIfConnected(i, j - 1, pos, d);
+				MakeEdgeIfConnected(i, j + 1, pos, d);
+				MakeEdgeIfConnected(i + 1, j - 1, pos, d);
+				MakeEdgeIfConnected(i + 1, j, pos, d);
+				MakeEdgeIfConnected(i + 1, j + 1, pos, d);
+
+				Vertex up = intersections[i][j][k + 1].second;
+				boost::add_edge(d, up, EdgeProp(0), g);
+			}
+		}
+	}
+}
+
+void SupportPointFinder::MakeEdgeIfConnected(int row, int col,
+	glm::vec3 pos, Vertex d)
+{
+	if (row > rows - 1 || row < 0 || col > cols - 1 || col < 0)
+		return;
+
+	float overhangAngle = context.params.overhangAngle;
+	int machineZ = context.MachineLayer(pos[2]);
+	for (int i = 0; i < intersections[row][col].size(); i += 2) {
+		float entryZ = intersections[row][col][i].first[2];
+		int machineEntryZ = context.MachineLayer(entryZ);
+
+		if (machineEntryZ > machineZ)
+			return;
+
+		float exitZ = intersections[row][col][i + 1].first[2];
+		int machineExitZ = context.MachineLayer(exitZ);
+
+		if (machineExitZ >= machineZ)
+		{
+			Vertex s = intersections[row][col][i].second;
+			vec3 dir = glm::normalize(pos - intersections[row][col][i].first);
+			float angle = glm::acos(glm::dot(vec3(0, 0, 1), dir));
+			float weight = 0;
+			if (angle > overhangAngle)
+				weight = std::min(1.0f, context.overhangWeightScale *
+					(angle - overhangAngle));
+			boost::add_edge(s, d, EdgeProp(weight), g);
+			return;
+		}
+	}
+}
+
+void SupportPointFinder::FindSupportPoints()
+{
+	float coverage = context.coverage;
+
+	std::vector<std::pair<Vertex, float>> vertices;
+
+	complete = true;
+	nFloatable = nCovered = 0;
+	Graph::vertex_iterator vi, v_end;
+	for (boost::tie(vi, v_end) = boost::vertices(g); vi != v_end; vi++) {
+		vertices.push_back(std::make_pair(*vi, g[*vi].pos[2]));
+		if (g[*vi].floatable)
+			nFloatable++;
+	}
+
+	std::sort(vertices.begin(), vertices.end(),
+		[](std::pair<Vertex, float> a, std::pair<Vertex, float> b) {
+			return a.second < b.second;
+		});
+
+	// a trace is kept by the column graph, whose covers match the boost ones
+	if (trace || context.params.graphEngine == GraphEngineType::COLUMN)
+		CoverColumnGraph(vertices, coverage);
+	else
+		CoverBoostGraph(vertices, coverage);
+
+	Metrics& metrics = Metrics::GetInstance();
+	metrics.GetCounter("support points").Add(supportPoints.size());
+	if (!complete)
+		metrics.GetCounter("stopped searches").Add(1);
+}
+
+bool SupportPointFinder::Stopped()
+{
+	if (!progress)
+		return false;
+	if ((progress->cancel && progress->cancel->load()) ||
+		std::chrono::steady_clock::now() >= progress->deadline)
+		complete = false;
+	return !complete;
+}
+
+void SupportPointFinder::Emit(const vec3& point) const
+{
+	if (progress && progress->emit)
+		progress->emit(point, GetCoverage());
+}
+
+void SupportPointFinder::CoverBoostGraph(
+	const std::vector<std::pair<Vertex, float>>& vertices, float coverage)
+{
+	Histogram& settledHistogram =
+		Metrics::GetInstance().GetHistogram("dijkstra settled vertices");
+	for (int i = 0; i < vertices.size(); i++) {
+		Vertex v = vertices[i].first;
+		if (!g[v].floatable)
+			continue;
+		if (Stopped())
+			break;
+
+		supportPoints.push_back(g[v].pos);
+
+		long long settled = 0;
+		DijkstraVisitor<boost::property_map<Graph, float VertexProp::*>::type,
+			boost::property_map<Graph, bool VertexProp::*>::type>
+			dijkstraVisitor(coverage,
+				boost::get(&VertexProp::distance, g),
+				boost::get(&VertexProp::floatable, g),
+				&settled, &nCovered);
+		try
+		{
+			boost::dijkstra_shortest_paths(g, v,
+				boost::weight_map(boost::get(&EdgeProp::penalty, g))
+				.distance_map(boost::get(&VertexProp::distance, g))
+				.visitor(dijkstraVisitor));
+		}
+		catch (ExceedCoverage&)
+		{
+		}
+		settledHistogram.Record(settled);
+		Emit(g[v].pos);
+	}
+}
+
+void SupportPointFinder::CoverColumnGraph(
+	const std::vector<std::pair<Vertex, float>>& vertices, float coverage)
+{
+	size_t nVertices = boost::num_vertices(g);
+	ColumnGraph column(nVertices, boost::num_edges(g));
+	std::vector<bool> floatable(nVertices);
+	for (Vertex v = 0; v < nVertices; v++) {
+		Graph::out_edge_iterator ei, e_end;
+		for (boost::tie(ei, e_end) = boost::out_edges(v, g); ei != e_end; ei++)
+			column.AddEdge(boost::target(*ei, g), g[*ei].penalty);
+		column.EndVertex();
+		floatable[v] = g[v].floatable;
+	}
+	MEMORY_TRACK("column graph", (nVertices + 1) * sizeof(uint32_t) +
+		column.EdgeCount() * (sizeof(uint32_t) + sizeof(float)) +
+		nVertices * (sizeof(float) + sizeof(size_t) + 1));
+
+	Histogram& settledHistogram =
+		Metrics::GetInstance().GetHistogram("dijkstra settled vertices");
+	long long replayed = 0;
+	for (int i = 0; i < vertices.size(); i++) {
+		Vertex v = vertices[i].first;
+		if (!floatable[v])
+			continue;
+		if (Stopped())
+			break;
+
+		supportPoints.push_back(g[v].pos);
+		if (trace && Replay(v, floatable))
+			replayed++;
+		else {
+			settledHistogram.Record(
+				column.Cover(v, coverage, floatable, &nCovered));
+			if (trace)
+				Record(v, column);
+		}
+		Emit(g[v].pos);
+	}
+	if (trace)
+		Metrics::GetInstance().GetCounter("replayed covers").Add(replayed);
+
+	for (Vertex v = 0; v < nVertices; v++)
+		g[v].floatable = floatable[v];
+}
+
+bool SupportPointFinder::Replay(Vertex v, std::vector<bool>& floatable)
+{
+	int r = replayOf[v];
+	if (r < 0)
+		return false;
+
+	trace->sources.push_back(v);
+	for (uint32_t k = previous.offsets[r]; k < previous.offsets[r + 1]; k++) {
+		uint32_t u = remap[previous.settled[k]];
+		if (floatable[u])
+			nCovered++;
+		floatable[u] = false;
+		trace->settled.push_back(u);
+	}
+	trace->offsets.push_back(trace->settled.size());
+	trace->reach.push_back(previous.reach[r]);
+	return true;
+}
+
+void SupportPointFinder::Record(Vertex v, const ColumnGraph& column)
+{
+	trace->sources.push_back(v);
+	glm::ivec4 reach(cols, rows, -1, -1);
+	for (uint32_t u : column.Touched()) {
+		int row = columnOf[u] / cols, col = columnOf[u] % cols;
+		reach = glm::ivec4(std::min(reach[0], col), std::min(reach[1], row),
+			std::max(reach[2], col), std::max(reach[3], row));
+		if (column.IsSettled(u))
+			trace->settled.push_back(u);
+	}
+	trace->offsets.push_back(trace->settled.size());
+	trace->reach.push_back(reach);
 }
\ No newline at end of file
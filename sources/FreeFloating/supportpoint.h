@@ -1,84 +1,186 @@
-#pragma once
-
-#include <boost/graph/graph_traits.hpp>
-#include <boost/graph/adjacency_list.hpp>
-#include <boost/graph/dijkstra_shortest_paths.hpp>
-#include <boost/property_map/property_map.hpp>
-#include <model3d.h>
-#include <glm/glm.hpp>
-
-#include "zldni.h"
-
-class SupportPointFinder
-{
-public:
-	SupportPointFinder() {}
-	~SupportPointFinder() {}
-
-	void Run(Model3D*);
-
-private:
-	struct VertexProp
-	{
-		VertexProp() {}
-		VertexProp(glm::vec3 pos_, bool floatable_)
-			: pos(pos_), floatable(floatable_) {}
-
-		glm::vec3 pos;
-		bool floatable;
-		float distance;
-	};
-	struct EdgeProp
-	{
-		EdgeProp() {}
-		EdgeProp(float penalty_) : penalty(penalty_) {}
-
-		float penalty;
-	};
-	typedef boost::adjacency_list<boost::vecS, boost::vecS, boost::directedS,
-		VertexProp, EdgeProp> Graph;
-	typedef Graph::vertex_descriptor Vertex;
-	typedef Graph::edge_descriptor Edge;
-
-	struct ExceedCoverage {};
-	template<typename DistancePropertyMap, typename FloatablePropertyMap>
-	class DijkstraVisitor : boost::default_dijkstra_visitor
-	{
-	public:
-		DijkstraVisitor(float coverage_,
-			DistancePropertyMap dm_,
-			FloatablePropertyMap fm_)
-			: coverage(coverage_), dm(dm_), fm(fm_) {}
-
-		void initialize_vertex(const Vertex& s, const Graph& g) const {}
-		void discover_vertex(const Vertex& s, const Graph& g) const
-		{
-			float d = boost::get(dm, s);
-			if (d > coverage)
-				throw ExceedCoverage();
-		}
-		void examine_vertex(const Vertex& s, const Graph& g) const {}
-		void examine_edge(const Edge& e, const Graph& g) const {}
-		void edge_relaxed(const Edge& e, const Graph& g) const {}
-		void edge_not_relaxed(const Edge& e, const Graph& g) const {}
-		void finish_vertex(const Vertex& s, const Graph& g) const
-		{
-			boost::put(fm, s, false);
-		}
-	private:
-		float coverage;
-		DistancePropertyMap dm;
-		FloatablePropertyMap fm;
-	};
-
-	int rows, cols;
-	std::vector<std::vector<
-		std::vector<std::pair<glm::vec3, Vertex>>>> intersections;
-	Graph g;
-	std::vector<glm::vec3> supportPoints;
-
-private:
-	void ConstructGraph(zLDNIGenerator&);
-	void MakeEdgeIfConnected(int, int, glm::vec3, Vertex);
-	void FindSupportPoints();
-};
+#pragma once
+
+#include <boost/graph/graph_traits.hpp>
+#include <boost/graph/adjacency_list.hpp>
+#include <boost/graph/dijkstra_shortest_paths.hpp>
+#include <boost/property_map/property_map.hpp>
+#include <model3d.h>
+#include <glm/glm.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+#include "zldni.h"
+#include "columngraph.h"
+#include "depthcolumns.h"
+
+// Progressive search: each support point is handed to emit as soon as it
+// is committed, lowest first, with the fraction of the floatable vertices
+// covered so far. Past deadline or once cancel is set the search stops
+// with the points it has; both are checked between searches.
+struct SearchProgress
+{
+	SearchProgress()
+		: deadline(std::chrono::steady_clock::time_point::max()), cancel(0) {}
+
+	std::function<void(const glm::vec3& point, float covered)> emit;
+	std::chrono::steady_clock::time_point deadline;
+	const std::atomic<bool>* cancel;
+};
+
+// What a search over DepthColumns leaves for the next one on the same
+// frame: the first vertex of every column, row by row, and for every
+// support point the vertices its cover settled and the columns it
+// discovered. A cover depends only on the part of the graph it
+// discovers, so one that stayed clear of the changed columns is replayed
+// instead of searched again.
+struct CoverTrace
+{
+	std::vector<uint32_t> firstVertex;
+	std::vector<uint32_t> sources;
+	// into settled, one more than sources
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> settled;
+	// left, bottom, right and top column, inclusive
+	std::vector<glm::ivec4> reach;
+};
+
+class SupportPointFinder
+{
+	friend class KernelBench;
+	friend class Validator;
+
+public:
+	SupportPointFinder(const JobContext& context_)
+		: context(context_), progress(0), complete(true),
+		nFloatable(0), nCovered(0), trace(0) {}
+	~SupportPointFinder() {}
+
+	// makes the next Run progressive; progress has to outlive it
+	void SetProgress(const SearchProgress* progress_) {
+		progress = progress_;
+	}
+
+	Status Run(TriMesh*);
+	// Reuses the fragment lists of an earlier job on the same mesh. On a
+	// plate generator, part picks the part to search; the points are then
+	// on the plate.
+	Status Run(zLDNIGenerator&, int part = -1);
+	// Searches every column. trace is that of an earlier search on the
+	// same frame, or empty, and is replaced by that of this one; the covers
+	// it holds that discovered no column within a pixel of dirty are
+	// replayed. The points are those of a search without a trace.
+	Status Run(const DepthColumns&, CoverTrace& trace, glm::ivec4 dirty);
+
+	const std::vector<glm::vec3>& GetSupportPoints() const {
+		return supportPoints;
+	}
+	// false if a progressive search stopped before covering everything
+	bool IsComplete() const {
+		return complete;
+	}
+	float GetCoverage() const {
+		return nFloatable > 0 ? (float)nCovered / nFloatable : 1.0f;
+	}
+
+private:
+	struct VertexProp
+	{
+		VertexProp() {}
+		VertexProp(glm::vec3 pos_, bool floatable_)
+			: pos(pos_), floatable(floatable_) {}
+
+		glm::vec3 pos;
+		bool floatable;
+		float distance;
+	};
+	struct EdgeProp
+	{
+		EdgeProp() {}
+		EdgeProp(float penalty_) : penalty(penalty_) {}
+
+		float penalty;
+	};
+	typedef boost::adjacency_list<boost::vecS, boost::vecS, boost::directedS,
+		VertexProp, EdgeProp> Graph;
+	typedef Graph::vertex_descriptor Vertex;
+	typedef Graph::edge_descriptor Edge;
+
+	struct ExceedCoverage {};
+	template<typename DistancePropertyMap, typename FloatablePropertyMap>
+	class DijkstraVisitor : boost::default_dijkstra_visitor
+	{
+	public:
+		DijkstraVisitor(float coverage_,
+			DistancePropertyMap dm_,
+			FloatablePropertyMap fm_,
+			long long* settled_,
+			long long* covered_)
+			: coverage(coverage_), dm(dm_), fm(fm_), settled(settled_),
+			covered(covered_) {}
+
+		void initialize_vertex(const Vertex& s, const Graph& g) const {}
+		void discover_vertex(const Vertex& s, const Graph& g) const
+		{
+			float d = boost::get(dm, s);
+			if (d > coverage)
+				throw ExceedCoverage();
+		}
+		void examine_vertex(const Vertex& s, const Graph& g) const {}
+		void examine_edge(const Edge& e, const Graph& g) const {}
+		void edge_relaxed(const Edge& e, const Graph& g) const {}
+		void edge_not_relaxed(const Edge& e, const Graph& g) const {}
+		void finish_vertex(const Vertex& s, const Graph& g) const
+		{
+			if (boost::get(fm, s))
+				(*covered)++;
+			boost::put(fm, s, false);
+			(*settled)++;
+		}
+	private:
+		float coverage;
+		DistancePropertyMap dm;
+		FloatablePropertyMap fm;
+		long long* settled;
+		long long* covered;
+	};
+
+	const JobContext& context;
+
+	int rows, cols;
+	std::vector<std::vector<
+		std::vector<std::pair<glm::vec3, Vertex>>>> intersections;
+	Graph g;
+	std::vector<glm::vec3> supportPoints;
+
+	const SearchProgress* progress;
+	bool complete;
+	long long nFloatable, nCovered;
+
+	// set while a search over DepthColumns runs
+	CoverTrace* trace;
+	CoverTrace previous;
+	// the column of each vertex, the vertex of each vertex of previous
+	// and the cover in previous to replay for each vertex, or -1
+	std::vector<uint32_t> columnOf;
+	std::vector<int64_t> remap;
+	std::vector<int> replayOf;
+
+private:
+	void ConstructGraph(zLDNIGenerator&, int part);
+	void ReadIntersections(zLDNIGenerator&, int part = -1);
+	void ReadIntersections(const DepthColumns&);
+	void PlanReplay(glm::ivec4 dirty);
+	void ConnectIntersections();
+	void MakeEdgeIfConnected(int, int, glm::vec3, Vertex);
+	void TrackGraph();
+	void FindSupportPoints();
+	void CoverBoostGraph(const std::vector<std::pair<Vertex, float>>&, float);
+	void CoverColumnGraph(const std::vector<std::pair<Vertex, float>>&, float);
+	// the cover of v from previous, if it can be replayed
+	bool Replay(Vertex v, std::vector<bool>& floatable);
+	void Record(Vertex v, const ColumnGraph&);
+	// checked before each search of a progressive run
+	bool Stopped();
+	void Emit(const glm::vec3& point) const;
+};
@@ -1,172 +1,337 @@
-#include "zldni.h"
-
-#include <GLFW/glfw3.h>
-#include <params.h>
-#include <glm/gtc/matrix_transform.hpp>
-#include <stopwatch.h>
-using glm::vec3;
-using glm::mat4;
-using cv::Mat;
-using std::chrono::nanoseconds;
-using std::cout;
-using std::endl;
-
-zLDNIGenerator::zLDNIGenerator(Model3D* model3D)
-{
-	prog.CompileShader("./shader/fragmentlist.vs", GLSLShader::VERTEX);
-	prog.CompileShader("./shader/fragmentlist.fs", GLSLShader::FRAGMENT);
-	prog.Link();
-
-	target = model3D;
-
-	Configure();
-	SetupFBO();
-	SetupShaderStorage();
-	StopWatch::GetInstance().Hit();
-	ClearBuffers();
-	Run();
-	nanoseconds t = StopWatch::GetInstance().Hit();
-	cout << "time for computing fragment list : " << t.count() << endl;
-}
-
-void zLDNIGenerator::GetImageSize(int& w, int& h)
-{
-	w = width;
-	h = height;
-}
-
-void zLDNIGenerator::GetSortedList(std::vector<glm::vec3>& nodes,
-	int row, int col)
-{
-	GLuint n = headPtr[width * row + col];
-	while (n != 0xffffffff) {
-		ListNode& node = list[n];
-		float d = node.depth;
-		vec3 pos = glm::unProject(vec3(col, row, d), view * model, projection,
-			glm::vec4(0, 0, width, height));
-		nodes.push_back(pos);
-		n = node.next;
-	}
-
-	if (nodes.empty())
-		return;
-
-	std::sort(nodes.begin(), nodes.end(), [](glm::vec3 lhs, glm::vec3 rhs) {
-		return lhs[2] < rhs[2];
-		});
-}
-
-void zLDNIGenerator::Configure()
-{
-	vec3 center = target->aabb.GetCenter();
-	vec3 size = target->aabb.GetSize();
-
-	Params& params = Params::GetInstance();
-	float margin = params.pixelWidth * 10;
-	size += vec3(margin);
-	float halfX = size.x / 2.0f;
-	float halfY = size.y / 2.0f;
-	float halfZ = size.z / 2.0f;
-
-	model = glm::translate(mat4(1.0f), -center);
-	view = glm::lookAt(
-		vec3(0.0f, 0.0f, halfZ),
-		vec3(0.0f, 0.0f, 0.0f),
-		vec3(0.0f, 1.0f, 0.0f)
-	);
-	projection = glm::ortho(-halfX, halfX, -halfY, halfY,
-		0.1f, size.z);
-
-	width = round(size.x / params.pixelWidth);
-	height = round(size.y / params.pixelWidth);
-	if (width > params.maxFBOSize || height > params.maxFBOSize) {
-		std::cerr << "The model is too big\n";
-		glfwTerminate();
-		exit(EXIT_FAILURE);
-	}
-}
-
-void zLDNIGenerator::SetupFBO()
-{
-	glGenFramebuffers(1, &fboHandle);
-	glBindFramebuffer(GL_FRAMEBUFFER, fboHandle);
-
-	GLuint depthBuf;
-	glGenRenderbuffers(1, &depthBuf);
-	glBindRenderbuffer(GL_RENDERBUFFER, depthBuf);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-		GL_RENDERBUFFER, depthBuf);
-
-	GLenum drawBuffers[] = { GL_NONE };
-	glDrawBuffers(1, drawBuffers);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
-
-void zLDNIGenerator::SetupShaderStorage()
-{
-	maxNodes = 20 * width * height;
-	nodeSize = sizeof(GLfloat) + sizeof(GLuint);
-
-	prog.Use();
-	prog.SetUniform("MaxNodes", maxNodes);
-
-	glGenBuffers(2, buffers);
-	glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, buffers[COUNTER_BUFFER]);
-	glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), 0, GL_DYNAMIC_DRAW);
-
-	glGenTextures(1, &headPtrTex);
-	glBindTexture(GL_TEXTURE_2D, headPtrTex);
-	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, width, height);
-	glBindImageTexture(0, headPtrTex, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
-
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[LINKED_LIST_BUFFER]);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, maxNodes * nodeSize, 0, GL_DYNAMIC_DRAW);
-
-	std::vector<GLuint> headPtrClearBuf(width * height, 0xffffffff);
-	glGenBuffers(1, &clearBuf);
-	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, clearBuf);
-	glBufferData(GL_PIXEL_UNPACK_BUFFER, headPtrClearBuf.size() * sizeof(GLuint),
-		&headPtrClearBuf[0], GL_STATIC_COPY);
-}
-
-void zLDNIGenerator::ClearBuffers()
-{
-	GLuint zero = 0;
-	glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, buffers[COUNTER_BUFFER]);
-	glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &zero);
-
-	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, clearBuf);
-	glBindTexture(GL_TEXTURE_2D, headPtrTex);
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED_INTEGER,
-		GL_UNSIGNED_INT, 0);
-}
-
-void zLDNIGenerator::Run()
-{
-	glBindFramebuffer(GL_FRAMEBUFFER, fboHandle);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[LINKED_LIST_BUFFER]);
-
-	glEnable(GL_DEPTH_TEST);
-	glDepthMask(GL_FALSE);
-
-	glViewport(0, 0, width, height);
-	glClearDepth(1.0);
-	glClear(GL_DEPTH_BUFFER_BIT);
-
-	prog.Use();
-	prog.SetUniform("MVP", projection * view * model);
-	target->Render();
-
-	list.resize(maxNodes);
-	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
-		maxNodes * nodeSize, list.data());
-	headPtr.resize(width * height);
-	glGetTexImage(GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_UNSIGNED_INT,
-		headPtr.data());
-	glFlush();
-	glMemoryBarrier(GL_ALL_BARRIER_BITS);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+#include "zldni.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <pipelinestage.h>
+#include <metrics.h>
+#include <cmath>
+#include <algorithm>
+using glm::vec3;
+using glm::mat4;
+using cv::Mat;
+
+const char* zLDNIGenerator::vertexShader = "./shader/fragmentlist.vs";
+const char* zLDNIGenerator::fragmentShader = "./shader/fragmentlist.fs";
+const char* zLDNIGenerator::plateFragmentShader = "./shader/platelist.fs";
+
+int zLDNIGenerator::MaxPlateFrame(const Params& params)
+{
+	size_t budget = (size_t)params.maxPlateListMB << 20;
+	size_t pixelBytes = nodesPerPixel * (sizeof(ListNode) + sizeof(GLuint)) +
+		sizeof(GLuint);
+	int side = sqrt((double)(budget / pixelBytes));
+	return std::min(side, params.maxFBOSize);
+}
+
+zLDNIGenerator::zLDNIGenerator(const JobContext& context, TriMesh* mesh)
+	: fboHandle(0), depthBuf(0), clearBuf(0), headPtrTex(0)
+{
+	parts.push_back(PlatePart(mesh, mat4(1.0f)));
+	Generate(context);
+}
+
+zLDNIGenerator::zLDNIGenerator(const JobContext& context,
+	const std::vector<PlatePart>& parts_)
+	: fboHandle(0), depthBuf(0), clearBuf(0), headPtrTex(0), parts(parts_)
+{
+	if (parts.empty()) {
+		buffers[0] = buffers[1] = buffers[2] = 0;
+		status = Status(Status::INVALID_ARGUMENT, "The plate has no parts");
+		return;
+	}
+	Generate(context);
+}
+
+zLDNIGenerator::zLDNIGenerator(const JobContext& context, TriMesh* mesh,
+	const zLDNIGenerator& frame, glm::ivec4 window)
+	: fboHandle(0), depthBuf(0), clearBuf(0), headPtrTex(0),
+	model(frame.model), view(frame.view), projection(frame.projection),
+	width(window[2]), height(window[3]),
+	viewport(frame.viewport), origin(window[0], window[1])
+{
+	parts.push_back(PlatePart(mesh, mat4(1.0f)));
+	windows.push_back(glm::ivec4(0, 0, width, height));
+	Generate(context);
+}
+
+zLDNIGenerator::~zLDNIGenerator()
+{
+	DeleteBuffers();
+}
+
+void zLDNIGenerator::Generate(const JobContext& context)
+{
+	PROFILE_ZONE("fragment list");
+	buffers[0] = buffers[1] = buffers[2] = 0;
+	prog = GLContext::LoadProgram(vertexShader,
+		IsPlate() ? plateFragmentShader : fragmentShader);
+	if (!prog) {
+		status = Status(Status::GL_ERROR, "Unable to load the fragment list shaders");
+		return;
+	}
+
+	// a window of another frame is set up by its constructor
+	if (windows.empty())
+		status = Configure(context);
+	if (!status.IsOk())
+		return;
+	SetupFBO();
+	SetupShaderStorage();
+	PIPELINE_STAGE("compute fragment list");
+	ClearBuffers();
+	Run();
+	// the lists are read back, so the generator can outlive the job
+	// without holding on to GPU memory
+	DeleteBuffers();
+}
+
+void zLDNIGenerator::GetImageSize(int& w, int& h)
+{
+	w = width;
+	h = height;
+}
+
+glm::ivec4 zLDNIGenerator::GetWindow(int part) const
+{
+	if (part < 0)
+		return glm::ivec4(0, 0, width, height);
+	return windows[part];
+}
+
+glm::mat4 zLDNIGenerator::GetPixelTransform() const
+{
+	vec3 half(viewport[2] / 2.0f, viewport[3] / 2.0f, 0.5f);
+	vec3 offset(viewport[0] - origin.x, viewport[1] - origin.y, 0.0f);
+	mat4 toPixel = glm::translate(mat4(1.0f), offset + half) *
+		glm::scale(mat4(1.0f), half);
+	return toPixel * projection * view * model;
+}
+
+void zLDNIGenerator::ReleaseLists()
+{
+	std::vector<ListNode>().swap(list);
+	std::vector<GLuint>().swap(headPtr);
+	std::vector<GLuint>().swap(partOf);
+}
+
+void zLDNIGenerator::GetSortedList(std::vector<glm::vec3>& nodes,
+	int row, int col, int part)
+{
+	GLuint n = headPtr[width * row + col];
+	while (n != 0xffffffff) {
+		ListNode& node = list[n];
+		if (part < 0 || !IsPlate() || partOf[n] == (GLuint)part) {
+			float d = node.depth;
+			vec3 pos = glm::unProject(vec3(col + origin.x, row + origin.y, d),
+				view * model, projection, glm::vec4(viewport));
+			if (part >= 0)
+				pos -= parts[part].shift;
+			nodes.push_back(pos);
+		}
+		n = node.next;
+	}
+
+	if (nodes.empty())
+		return;
+
+	std::sort(nodes.begin(), nodes.end(), [](glm::vec3 lhs, glm::vec3 rhs) {
+		return lhs[2] < rhs[2];
+		});
+}
+
+Status zLDNIGenerator::Configure(const JobContext& context)
+{
+	AABB frame;
+	for (const PlatePart& part : parts) {
+		AABB bounds = part.PlateBounds();
+		frame.Add(bounds.GetMin() + part.shift);
+		frame.Add(bounds.GetMax() + part.shift);
+	}
+	vec3 center = frame.GetCenter();
+	vec3 size = frame.GetSize();
+
+	const Params& params = context.params;
+	float margin = params.pixelWidth * 10;
+	size += vec3(margin);
+	float halfX = size.x / 2.0f;
+	float halfY = size.y / 2.0f;
+	float halfZ = size.z / 2.0f;
+
+	model = glm::translate(mat4(1.0f), -center);
+	view = glm::lookAt(
+		vec3(0.0f, 0.0f, halfZ),
+		vec3(0.0f, 0.0f, 0.0f),
+		vec3(0.0f, 1.0f, 0.0f)
+	);
+	projection = glm::ortho(-halfX, halfX, -halfY, halfY,
+		0.1f, size.z);
+
+	width = round(size.x / params.pixelWidth);
+	height = round(size.y / params.pixelWidth);
+	int maxSize = IsPlate() ? MaxPlateFrame(params) : params.maxFBOSize;
+	if (width > maxSize || height > maxSize)
+		return Status(Status::MODEL_TOO_BIG, "The model is too big");
+	viewport = glm::ivec4(0, 0, width, height);
+	origin = glm::ivec2(0);
+
+	// a pixel of slack on every side, the part IDs keep neighbours apart
+	vec3 corner = center - size / 2.0f;
+	glm::vec2 scale(width / size.x, height / size.y);
+	for (const PlatePart& part : parts) {
+		AABB bounds = part.PlateBounds();
+		vec3 lo = bounds.GetMin() + part.shift - corner;
+		vec3 hi = bounds.GetMax() + part.shift - corner;
+		int left = std::max(0, (int)floor(lo.x * scale.x) - 1);
+		int bottom = std::max(0, (int)floor(lo.y * scale.y) - 1);
+		int right = std::min(width, (int)ceil(hi.x * scale.x) + 1);
+		int top = std::min(height, (int)ceil(hi.y * scale.y) + 1);
+		windows.push_back(glm::ivec4(left, bottom, right - left, top - bottom));
+	}
+	return Status();
+}
+
+void zLDNIGenerator::SetupFBO()
+{
+	glGenFramebuffers(1, &fboHandle);
+	glBindFramebuffer(GL_FRAMEBUFFER, fboHandle);
+
+	glGenRenderbuffers(1, &depthBuf);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuf);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT,
+		origin.x + width, origin.y + height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+		GL_RENDERBUFFER, depthBuf);
+
+	GLenum drawBuffers[] = { GL_NONE };
+	glDrawBuffers(1, drawBuffers);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void zLDNIGenerator::SetupShaderStorage()
+{
+	maxNodes = nodesPerPixel * width * height;
+	nodeSize = sizeof(GLfloat) + sizeof(GLuint);
+
+	prog->Use();
+	prog->SetUniform("MaxNodes", maxNodes);
+
+	glGenBuffers(3, buffers);
+	glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, buffers[COUNTER_BUFFER]);
+	glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), 0, GL_DYNAMIC_DRAW);
+
+	glGenTextures(1, &headPtrTex);
+	glBindTexture(GL_TEXTURE_2D, headPtrTex);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, width, height);
+	glBindImageTexture(0, headPtrTex, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+
+	if (IsPlate()) {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers[PART_BUFFER]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, maxNodes * sizeof(GLuint), 0,
+			GL_DYNAMIC_DRAW);
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[LINKED_LIST_BUFFER]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, maxNodes * nodeSize, 0, GL_DYNAMIC_DRAW);
+
+	std::vector<GLuint> headPtrClearBuf(width * height, 0xffffffff);
+	glGenBuffers(1, &clearBuf);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, clearBuf);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, headPtrClearBuf.size() * sizeof(GLuint),
+		&headPtrClearBuf[0], GL_STATIC_COPY);
+}
+
+void zLDNIGenerator::ClearBuffers()
+{
+	GLuint zero = 0;
+	glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, buffers[COUNTER_BUFFER]);
+	glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &zero);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, clearBuf);
+	glBindTexture(GL_TEXTURE_2D, headPtrTex);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED_INTEGER,
+		GL_UNSIGNED_INT, 0);
+}
+
+void zLDNIGenerator::DeleteBuffers()
+{
+	if (fboHandle != 0) {
+		glDeleteFramebuffers(1, &fboHandle);
+		glDeleteRenderbuffers(1, &depthBuf);
+		fboHandle = depthBuf = 0;
+	}
+	if (buffers[0] != 0) {
+		glDeleteBuffers(3, buffers);
+		glDeleteBuffers(1, &clearBuf);
+		glDeleteTextures(1, &headPtrTex);
+		buffers[0] = buffers[1] = buffers[2] = clearBuf = headPtrTex = 0;
+	}
+}
+
+void zLDNIGenerator::Run()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, fboHandle);
+	if (IsPlate())
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers[PART_BUFFER]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[LINKED_LIST_BUFFER]);
+
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glClearDepth(1.0);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glScissor(origin.x, origin.y, width, height);
+	glEnable(GL_SCISSOR_TEST);
+
+	// one pass over the whole plate, only the placement changes per part
+	prog->Use();
+	if (!IsPlate())
+		prog->SetUniform("Origin", origin);
+	for (size_t p = 0; p < parts.size(); p++) {
+		const PlatePart& part = parts[p];
+		mat4 placement = glm::translate(mat4(1.0f), part.shift) * part.transform;
+		prog->SetUniform("MVP", projection * view * model * placement);
+		if (IsPlate())
+			prog->SetUniform("PartID", (GLuint)p);
+		part.mesh->Render();
+	}
+	glDisable(GL_SCISSOR_TEST);
+
+	list.resize(maxNodes);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+		maxNodes * nodeSize, list.data());
+	if (IsPlate()) {
+		partOf.resize(maxNodes);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[PART_BUFFER]);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+			maxNodes * sizeof(GLuint), partOf.data());
+	}
+	headPtr.resize(width * height);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_UNSIGNED_INT,
+		headPtr.data());
+	MEMORY_TRACK("fragment list", list.size() * sizeof(ListNode) +
+		(headPtr.size() + partOf.size()) * sizeof(GLuint));
+
+	long long totalFragments = 0;
+	std::vector<long long> depthComplexity;
+	for (int i = 0; i < headPtr.size(); i++) {
+		GLuint n = headPtr[i];
+		int fragments = 0;
+		while (n != 0xffffffff) {
+			n = list[n].next;
+			fragments++;
+		}
+		if (fragments >= depthComplexity.size())
+			depthComplexity.resize(fragments + 1, 0);
+		depthComplexity[fragments]++;
+		totalFragments += fragments;
+	}
+
+	Metrics& metrics = Metrics::GetInstance();
+	metrics.GetCounter("fragments").Add(totalFragments);
+	metrics.GetCounter("max depth complexity").Max(depthComplexity.size() - 1);
+	metrics.GetHistogram("depth complexity").RecordCounts(depthComplexity);
+	glFlush();
+	glMemoryBarrier(GL_ALL_BARRIER_BITS);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
\ No newline at end of file
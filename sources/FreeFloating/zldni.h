@@ -1,46 +1,126 @@
-#pragma once
-
-#include <glm/glm.hpp>
-#include <glad/glad.h>
-#include <glslprogram.h>
-#include <model3d.h>
-#include <opencv2/opencv.hpp>
-
-enum BufferNames {
-	COUNTER_BUFFER = 0,
-	LINKED_LIST_BUFFER
-};
-
-class zLDNIGenerator
-{
-private:
-	GLSLProgram prog;
-	GLuint fboHandle;
-	GLuint buffers[2], clearBuf, headPtrTex;
-	GLuint maxNodes, nodeSize;
-
-	glm::mat4 model, view, projection;
-	int width, height;
-
-	Model3D* target;
-
-	struct ListNode {
-		GLfloat depth;
-		GLuint next;
-	};
-	std::vector<ListNode> list;
-	std::vector<GLuint> headPtr;
-
-	void Configure();
-	void SetupFBO();
-	void SetupShaderStorage();
-	void ClearBuffers();
-	void Run();
-
-public:
-	zLDNIGenerator(Model3D*);
-	~zLDNIGenerator() {}
-
-	void GetImageSize(int&, int&);
-	void GetSortedList(std::vector<glm::vec3>& nodes, int row, int col);
-};
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+#include <glcontext.h>
+#include <jobcontext.h>
+#include <status.h>
+#include <model3d.h>
+#include <opencv2/opencv.hpp>
+
+enum BufferNames {
+	COUNTER_BUFFER = 0,
+	LINKED_LIST_BUFFER,
+	PART_BUFFER
+};
+
+// A mesh drawn into a frame shared with other parts of a build plate.
+// transform puts it on the plate and shift moves it, in XY, to its place
+// in the frame; its fragments are moved back onto the plate.
+struct PlatePart {
+	PlatePart() : mesh(0), transform(1.0f), shift(0.0f) {}
+	PlatePart(TriMesh* mesh_, const glm::mat4& transform_)
+		: mesh(mesh_), transform(transform_), shift(0.0f) {}
+
+	// the box of the mesh on the plate, before the shift
+	AABB PlateBounds() const {
+		AABB bounds;
+		glm::vec3 lo = mesh->aabb.GetMin(), hi = mesh->aabb.GetMax();
+		for (int c = 0; c < 8; c++) {
+			glm::vec4 corner(c & 1 ? hi.x : lo.x, c & 2 ? hi.y : lo.y,
+				c & 4 ? hi.z : lo.z, 1.0f);
+			bounds.Add(glm::vec3(transform * corner));
+		}
+		return bounds;
+	}
+
+	TriMesh* mesh;
+	glm::mat4 transform;
+	glm::vec3 shift;
+};
+
+class zLDNIGenerator
+{
+private:
+	GLSLProgram* prog;
+	GLuint fboHandle, depthBuf;
+	GLuint buffers[3], clearBuf, headPtrTex;
+	GLuint maxNodes, nodeSize;
+
+	glm::mat4 model, view, projection;
+	int width, height;
+	// the frame in pixels, and the pixel of it the lists start at
+	glm::ivec4 viewport;
+	glm::ivec2 origin;
+
+	std::vector<PlatePart> parts;
+	// pixels of each part, left, bottom, width and height
+	std::vector<glm::ivec4> windows;
+	Status status;
+
+	struct ListNode {
+		GLfloat depth;
+		GLuint next;
+	};
+	std::vector<ListNode> list;
+	std::vector<GLuint> headPtr;
+	// the part of each node, read back for plates only
+	std::vector<GLuint> partOf;
+
+	bool IsPlate() const {
+		return parts.size() > 1;
+	}
+
+	void Generate(const JobContext&);
+	Status Configure(const JobContext&);
+	void SetupFBO();
+	void SetupShaderStorage();
+	void ClearBuffers();
+	void DeleteBuffers();
+	void Run();
+
+public:
+	// the program, for callers that read and compile it ahead
+	static const char* vertexShader;
+	static const char* fragmentShader;
+	// the program of plates, which also records the part of each node
+	static const char* plateFragmentShader;
+	// node slots reserved per pixel of the frame
+	static const int nodesPerPixel = 20;
+
+	// The largest square frame, in pixels, a plate of several parts may
+	// use: maxFBOSize, or less if its lists and part IDs would not fit in
+	// maxPlateListMB.
+	static int MaxPlateFrame(const Params&);
+
+	zLDNIGenerator(const JobContext&, TriMesh*);
+	// all parts in one frame and one draw pass, see PackPlate
+	zLDNIGenerator(const JobContext&, const std::vector<PlatePart>&);
+	// Only the pixels in window of the frame of another generator, e.g.
+	// the columns under an edit. The lists are those of the window. The
+	// frame is rasterized as a whole and cut to the window by the scissor,
+	// so the fragments are exactly the ones the frame would get.
+	zLDNIGenerator(const JobContext&, TriMesh*, const zLDNIGenerator& frame,
+		glm::ivec4 window);
+	~zLDNIGenerator();
+
+	// the lists are empty unless this is ok
+	const Status& GetStatus() const {
+		return status;
+	}
+
+	void GetImageSize(int&, int&);
+	int GetPartCount() const {
+		return parts.size();
+	}
+	// the pixels a part covers; the whole frame for part -1
+	glm::ivec4 GetWindow(int part) const;
+	// the fragments of one part, on the plate, or of all parts for -1
+	void GetSortedList(std::vector<glm::vec3>& nodes, int row, int col,
+		int part = -1);
+	// from the frame to pixel coordinates and depth
+	glm::mat4 GetPixelTransform() const;
+	// frees the lists once they have been read; the frame can still be
+	// used for windows
+	void ReleaseLists();
+};
@@ -1,198 +1,364 @@
-#include "anchormap.h"
-#include "binaryimages.h"
-
-#include <params.h>
-#include <glm/gtc/matrix_transform.hpp>
-#include <stopwatch.h>
-using glm::vec3;
-using glm::mat4;
-using cv::Mat;
-using std::chrono::nanoseconds;
-using std::cout;
-using std::endl;
-
-void AnchorMapGenerator::Run(Model3D* model3D)
-{
-	vec3 size = model3D->aabb.GetSize();
-	Params& params = Params::GetInstance();
-
-	float val = size.z / params.sliceThickness;
-	int quot = floor(val);
-	float fract = val - quot;
-	if (fract < 0.5)
-		quot--;
-
-	BinaryImageSampler sampler(model3D);
-	int cols, rows;
-	sampler.GetImageSize(cols, rows);
-	Mat upperPart = Mat::zeros(rows, cols, CV_8UC1);
-	Mat upperAnchorMap = Mat::zeros(rows, cols, CV_8UC1);
-	StopWatch::GetInstance().Hit();
-	for (int i = quot; i >= 0; i--) {
-		float z = (i + 0.5) * params.sliceThickness;
-		z -= size.z / 2.0;
-
-		cv::Mat currentPart = sampler.Slice(z);
-		if (i == quot) {
-			upperPart = currentPart.clone();
-			continue;
-		}
-
-		cv::Mat shadow = Subtract(upperPart, currentPart);
-		cv::Mat pa = Subtract(upperAnchorMap, currentPart);
-		cv::Mat supportRegion = GrowingSwallow(
-			GrowingSwallow(shadow, currentPart, upperPart, params.selfSupportThres),
-			pa, pa, params.effectiveRadius);
-		cv::Mat anchorMap = GenAnchorMap(supportRegion, params.effectiveRadius);
-		anchorMap = Union(anchorMap, pa);
-
-		upperPart = currentPart.clone();
-		upperAnchorMap = anchorMap.clone();
-	}
-	nanoseconds t = StopWatch::GetInstance().Hit();
-	cout << "time for computing anchormaps : " << t.count() << endl;
-}
-
-cv::Mat AnchorMapGenerator::Subtract(cv::Mat a, cv::Mat b)
-{
-	Mat result;
-	cv::bitwise_xor(a, b, result);
-	cv::bitwise_and(a, result, result);
-
-	return result;
-}
-
-cv::Mat AnchorMapGenerator::Intersect(cv::Mat a, cv::Mat b)
-{
-	Mat result;
-	cv::bitwise_and(a, b, result);
-	return result;
-}
-
-cv::Mat AnchorMapGenerator::Union(cv::Mat a, cv::Mat b)
-{
-	Mat result;
-	cv::bitwise_or(a, b, result);
-	return result;
-}
-
-cv::Mat AnchorMapGenerator::Invert(cv::Mat m)
-{
-	Mat result;
-	cv::bitwise_not(m, result);
-	return result;
-}
-
-bool AnchorMapGenerator::IsZeros(cv::Mat m)
-{
-	for (int i = 0; i < m.rows; i++) {
-		for (int j = 0; j < m.cols; j++) {
-			if (m.at<uchar>(i, j) != 0)
-				return false;
-		}
-	}
-	return true;
-}
-
-cv::Mat AnchorMapGenerator::GrowingSwallow(
-	cv::Mat psi, cv::Mat p1, cv::Mat p2, float t)
-{
-	Params& params = Params::GetInstance();
-	float radius = t / params.pixelWidth;
-
-	Mat result = psi.clone();
-
-	Mat a = Intersect(p1, p2);
-	Mat b = a.clone();
-	Mat c = b.clone();
-
-	Mat dist;
-	cv::distanceTransform(Invert(p1), dist, cv::DIST_L2, cv::DIST_MASK_3, CV_32F);
-	cv::threshold(dist, dist, radius, 255, cv::THRESH_BINARY_INV);
-	dist.convertTo(dist, CV_8UC1);
-
-	while (1) {
-		if (IsZeros(c))
-			break;
-
-		cv::dilate(a, b, cv::getStructuringElement(
-			cv::MORPH_RECT, cv::Size(3, 3)));
-		c = Intersect(Intersect(Subtract(b, a), dist), result);
-		a = Union(c, a);
-		result = Subtract(result, a);
-	}
-
-	return result;
-}
-
-cv::Mat AnchorMapGenerator::GenAnchorMap(cv::Mat supportRegion, float ta)
-{
-	Params& params = Params::GetInstance();
-	int gridWidth = floor(1.414 * ta / params.pixelWidth);
-	int rows = supportRegion.rows;
-	int cols = supportRegion.cols;
-
-	Mat anchorMap = Mat::zeros(rows, cols, CV_8UC1);
-	for (int i = 0; i < rows; i += gridWidth) {
-		for (int j = 0; j < cols; j += gridWidth) {
-			if (supportRegion.at<uchar>(i, j) != 0)
-				anchorMap.at<uchar>(i, j) = 255;
-		}
-	}
-
-	supportRegion = GrowingSwallow(supportRegion, anchorMap, anchorMap, ta);
-
-	for (int i = 0; i < rows; i += gridWidth) {
-		bool inside = false;
-		int enter, exit;
-		for (int j = 0; j < cols; j++) {
-			if (supportRegion.at<uchar>(i, j) != 0) {
-				if (inside)
-					continue;
-
-				inside = true;
-				enter = j;
-			}
-			else if (inside) {
-				inside = false;
-				exit = j - 1;
-				int center = round((enter + exit) / 2.0);
-				anchorMap.at<uchar>(i, center) = 255;
-			}
-		}
-	}
-
-	for (int j = 0; j < cols; j += gridWidth) {
-		bool inside = false;
-		int enter, exit;
-		for (int i = 0; i < rows; i++) {
-			if (supportRegion.at<uchar>(i, j) != 0) {
-				if (inside)
-					continue;
-
-				inside = true;
-				enter = i;
-			}
-			else if (inside) {
-				inside = false;
-				exit = i - 1;
-				int center = round((enter + exit) / 2.0);
-				anchorMap.at<uchar>(center, j) = 255;
-			}
-		}
-	}
-
-	supportRegion = GrowingSwallow(supportRegion, anchorMap, anchorMap, ta);
-
-	for (int i = 0; i < rows; i++) {
-		for (int j = 0; j < cols; j++) {
-			if (supportRegion.at<uchar>(i, j) != 0) {
-				anchorMap.at<uchar>(i, j) = 255;
-				supportRegion =
-					GrowingSwallow(supportRegion, anchorMap, anchorMap, ta);
-			}
-		}
-	}
-
-	return anchorMap;
+#include "anchormap.h"
+#include "binaryimages.h"
+#include "contourslicer.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <pipelinestage.h>
+#include <metrics.h>
+#include <omp.h>
+using glm::vec3;
+using glm::mat4;
+using cv::Mat;
+using std::chrono::nanoseconds;
+using std::cout;
+using std::endl;
+
+Status AnchorMapGenerator::Run(TriMesh* mesh, BinaryImageSampler* sampler)
+{
+	const Params& params = context.params;
+	std::vector<float> heights = LayerHeights(mesh);
+	int quot = heights.size() - 1;
+
+	Model3D* model3D = dynamic_cast<Model3D*>(mesh);
+	if (!model3D &&
+		(params.slicer == SlicerType::CONTOUR || params.compareSlicers))
+		return Status(Status::UNSUPPORTED,
+			"The contour slicer needs the mesh in memory");
+
+	if (params.compareSlicers) {
+		Status status = CompareSlicers(model3D, heights);
+		if (!status.IsOk())
+			return status;
+	}
+
+	int cols, rows;
+	if (params.slicer == SlicerType::CONTOUR) {
+		ContourSlicer slicer(context, model3D, heights);
+		slicer.GetImageSize(cols, rows);
+
+		int batchSize = omp_get_max_threads();
+		int batchFirst = 0;
+		std::vector<Mat> batch;
+		GenerateAnchorMaps(rows, cols, quot, [&](int i) {
+			if (batch.empty() || i < batchFirst) {
+				batchFirst = std::max(0, i - batchSize + 1);
+				slicer.Slice(batchFirst, i + 1, batch);
+			}
+			return batch[i - batchFirst];
+			});
+	}
+	else {
+		std::unique_ptr<BinaryImageSampler> local;
+		if (!sampler) {
+			local.reset(new BinaryImageSampler(context, mesh));
+			sampler = local.get();
+		}
+		if (!sampler->GetStatus().IsOk())
+			return sampler->GetStatus();
+		sampler->GetImageSize(cols, rows);
+		GenerateAnchorMaps(rows, cols, quot, [&](int i) {
+			return sampler->Slice(heights[i]);
+			});
+	}
+	return Status();
+}
+
+std::vector<float> AnchorMapGenerator::LayerHeights(TriMesh* mesh)
+{
+	vec3 size = mesh->aabb.GetSize();
+	const Params& params = context.params;
+
+	float val = size.z / params.sliceThickness;
+	int quot = floor(val);
+	float fract = val - quot;
+	if (fract < 0.5)
+		quot--;
+
+	std::vector<float> heights(quot + 1);
+	for (int i = 0; i <= quot; i++)
+		heights[i] = (i + 0.5) * params.sliceThickness - size.z / 2.0;
+	return heights;
+}
+
+void AnchorMapGenerator::GenerateAnchorMaps(int rows, int cols, int top,
+	std::function<cv::Mat(int)> slice)
+{
+	const Params& params = context.params;
+
+	Mat upperPart = Mat::zeros(rows, cols, CV_8UC1);
+	Mat upperAnchorMap = Mat::zeros(rows, cols, CV_8UC1);
+	PIPELINE_STAGE("compute anchormaps");
+	Histogram& iterations =
+		Metrics::GetInstance().GetHistogram("growing swallow iterations per layer");
+	for (int i = top; i >= 0; i--) {
+		cv::Mat currentPart = slice(i);
+		if (i == top) {
+			upperPart = currentPart.clone();
+			continue;
+		}
+
+		cv::Mat shadow = Subtract(upperPart, currentPart);
+		cv::Mat pa = Subtract(upperAnchorMap, currentPart);
+		swallowIterations = 0;
+		cv::Mat supportRegion = GrowingSwallow(
+			GrowingSwallow(shadow, currentPart, upperPart, params.selfSupportThres),
+			pa, pa, params.effectiveRadius);
+		cv::Mat anchorMap = GenAnchorMap(supportRegion, params.effectiveRadius);
+		anchorMap = Union(anchorMap, pa);
+		iterations.Record(swallowIterations);
+		if (anchorMapSink)
+			anchorMapSink->push_back(anchorMap);
+
+		upperPart = currentPart.clone();
+		upperAnchorMap = anchorMap.clone();
+	}
+}
+
+Status AnchorMapGenerator::CompareSlicers(Model3D* model3D,
+	const std::vector<float>& heights)
+{
+	PIPELINE_STAGE("compare slicers");
+	typedef std::chrono::steady_clock Clock;
+
+	Clock::time_point start = Clock::now();
+	BinaryImageSampler sampler(context, model3D);
+	nanoseconds ldniTime = Clock::now() - start;
+	if (!sampler.GetStatus().IsOk())
+		return sampler.GetStatus();
+
+	start = Clock::now();
+	ContourSlicer slicer(context, model3D, heights);
+	nanoseconds contourTime = Clock::now() - start;
+
+	int batchSize = omp_get_max_threads();
+	long long mismatched = 0;
+	std::vector<Mat> ldniSlices, contourSlices;
+	for (int first = 0; first < heights.size(); first += batchSize) {
+		int last = std::min<int>(heights.size(), first + batchSize);
+
+		start = Clock::now();
+		ldniSlices.clear();
+		for (int i = first; i < last; i++)
+			ldniSlices.push_back(sampler.Slice(heights[i]));
+		ldniTime += Clock::now() - start;
+
+		start = Clock::now();
+		slicer.Slice(first, last, contourSlices);
+		contourTime += Clock::now() - start;
+
+		for (int i = 0; i < ldniSlices.size(); i++) {
+			Mat diff;
+			cv::bitwise_xor(ldniSlices[i], contourSlices[i], diff);
+			mismatched += cv::countNonZero(diff);
+		}
+	}
+
+	cout << "time for LDNI slicing : " << ldniTime.count() << endl;
+	cout << "time for contour slicing : " << contourTime.count() << endl;
+	cout << "mismatched pixels : " << mismatched << endl;
+	return Status();
+}
+
+cv::Mat AnchorMapGenerator::Subtract(cv::Mat a, cv::Mat b)
+{
+	Mat result;
+	cv::bitwise_xor(a, b, result);
+	cv::bitwise_and(a, result, result);
+
+	return result;
+}
+
+cv::Mat AnchorMapGenerator::Intersect(cv::Mat a, cv::Mat b)
+{
+	Mat result;
+	cv::bitwise_and(a, b, result);
+	return result;
+}
+
+cv::Mat AnchorMapGenerator::Union(cv::Mat a, cv::Mat b)
+{
+	Mat result;
+	cv::bitwise_or(a, b, result);
+	return result;
+}
+
+cv::Mat AnchorMapGenerator::Invert(cv::Mat m)
+{
+	Mat result;
+	cv::bitwise_not(m, result);
+	return result;
+}
+
+bool AnchorMapGenerator::IsZeros(cv::Mat m)
+{
+	for (int i = 0; i < m.rows; i++) {
+		for (int j = 0; j < m.cols; j++) {
+			if (m.at<uchar>(i, j) != 0)
+				return false;
+		}
+	}
+	return true;
+}
+
+cv::Mat AnchorMapGenerator::GrowingSwallow(
+	cv::Mat psi, cv::Mat p1, cv::Mat p2, float t)
+{
+	const Params& params = context.params;
+	float radius = t / params.pixelWidth;
+
+	Mat result = psi.clone();
+
+	Mat a = Intersect(p1, p2);
+	Mat b = a.clone();
+	Mat c = b.clone();
+
+	Mat dist;
+	cv::distanceTransform(Invert(p1), dist, cv::DIST_L2, cv::DIST_MASK_3, CV_32F);
+	cv::threshold(dist, dist, radius, 255, cv::THRESH_BINARY_INV);
+	dist.convertTo(dist, CV_8UC1);
+
+	if (params.swallowEngine == SwallowEngineType::FRONTIER)
+		return FrontierSwallow(result, a, dist);
+
+	while (1) {
+		if (IsZeros(c))
+			break;
+
+		cv::dilate(a, b, cv::getStructuringElement(
+			cv::MORPH_RECT, cv::Size(3, 3)));
+		c = Intersect(Intersect(Subtract(b, a), dist), result);
+		a = Union(c, a);
+		result = Subtract(result, a);
+		swallowIterations++;
+	}
+
+	return result;
+}
+
+// works in place on result, which GrowingSwallow has already cloned
+cv::Mat AnchorMapGenerator::FrontierSwallow(
+	cv::Mat result, cv::Mat seed, cv::Mat reach)
+{
+	int rows = result.rows;
+	int cols = result.cols;
+	Mat visited = seed.clone();
+
+	std::vector<int> frontier, next;
+	for (int i = 0; i < rows; i++) {
+		const uchar* s = seed.ptr<uchar>(i);
+		uchar* r = result.ptr<uchar>(i);
+		for (int j = 0; j < cols; j++) {
+			if (s[j] != 0) {
+				frontier.push_back(i * cols + j);
+				r[j] = 0;
+			}
+		}
+	}
+	if (frontier.empty())
+		return result;
+
+	// the dilation loop only ever takes pixels next to the newest layer,
+	// so a breadth-first walk gives the same pixels, one layer per step
+	swallowIterations++;
+	while (!frontier.empty()) {
+		next.clear();
+		for (int p : frontier) {
+			int i = p / cols;
+			int j = p % cols;
+			for (int di = -1; di <= 1; di++) {
+				int ni = i + di;
+				if (ni < 0 || ni >= rows)
+					continue;
+				uchar* v = visited.ptr<uchar>(ni);
+				uchar* r = result.ptr<uchar>(ni);
+				const uchar* d = reach.ptr<uchar>(ni);
+				for (int dj = -1; dj <= 1; dj++) {
+					int nj = j + dj;
+					if (nj < 0 || nj >= cols || v[nj] != 0 ||
+						d[nj] == 0 || r[nj] == 0)
+						continue;
+					v[nj] = 255;
+					r[nj] = 0;
+					next.push_back(ni * cols + nj);
+				}
+			}
+		}
+		if (!next.empty())
+			swallowIterations++;
+		frontier.swap(next);
+	}
+
+	return result;
+}
+
+cv::Mat AnchorMapGenerator::GenAnchorMap(cv::Mat supportRegion, float ta)
+{
+	const Params& params = context.params;
+	int gridWidth = floor(1.414 * ta / params.pixelWidth);
+	int rows = supportRegion.rows;
+	int cols = supportRegion.cols;
+
+	Mat anchorMap = Mat::zeros(rows, cols, CV_8UC1);
+	for (int i = 0; i < rows; i += gridWidth) {
+		for (int j = 0; j < cols; j += gridWidth) {
+			if (supportRegion.at<uchar>(i, j) != 0)
+				anchorMap.at<uchar>(i, j) = 255;
+		}
+	}
+
+	supportRegion = GrowingSwallow(supportRegion, anchorMap, anchorMap, ta);
+
+	for (int i = 0; i < rows; i += gridWidth) {
+		bool inside = false;
+		int enter, exit;
+		for (int j = 0; j < cols; j++) {
+			if (supportRegion.at<uchar>(i, j) != 0) {
+				if (inside)
+					continue;
+
+				inside = true;
+				enter = j;
+			}
+			else if (inside) {
+				inside = false;
+				exit = j - 1;
+				int center = round((enter + exit) / 2.0);
+				anchorMap.at<uchar>(i, center) = 255;
+			}
+		}
+	}
+
+	for (int j = 0; j < cols; j += gridWidth) {
+		bool inside = false;
+		int enter, exit;
+		for (int i = 0; i < rows; i++) {
+			if (supportRegion.at<uchar>(i, j) != 0) {
+				if (inside)
+					continue;
+
+				inside = true;
+				enter = i;
+			}
+			else if (inside) {
+				inside = false;
+				exit = i - 1;
+				int center = round((enter + exit) / 2.0);
+				anchorMap.at<uchar>(center, j) = 255;
+			}
+		}
+	}
+
+	supportRegion = GrowingSwallow(supportRegion, anchorMap, anchorMap, ta);
+
+	for (int i = 0; i < rows; i++) {
+		for (int j = 0; j < cols; j++) {
+			if (supportRegion.at<uchar>(i, j) != 0) {
+				anchorMap.at<uchar>(i, j) = 255;
+				supportRegion =
+					GrowingSwallow(supportRegion, anchorMap, anchorMap, ta);
+			}
+		}
+	}
+
+	return anchorMap;
 }
\ No newline at end of file
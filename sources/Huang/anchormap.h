@@ -1,26 +1,52 @@
-#pragma once
-
-#include <glm/glm.hpp>
-#include <vector>
-#include <opencv2/opencv.hpp>
-#include <model3d.h>
-
-class AnchorMapGenerator
-{
-public:
-	AnchorMapGenerator() {}
-	~AnchorMapGenerator() {}
-
-	void Run(Model3D*);
-
-private:
-	cv::Mat Subtract(cv::Mat, cv::Mat);
-	cv::Mat Intersect(cv::Mat, cv::Mat);
-	cv::Mat Union(cv::Mat, cv::Mat);
-	cv::Mat Invert(cv::Mat);
-	bool IsZeros(cv::Mat);
-
-	cv::Mat GrowingSwallow(cv::Mat, cv::Mat, cv::Mat, float);
-
-	cv::Mat GenAnchorMap(cv::Mat, float);
-};
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <functional>
+#include <opencv2/opencv.hpp>
+#include <model3d.h>
+#include <jobcontext.h>
+#include <status.h>
+
+class BinaryImageSampler;
+
+class AnchorMapGenerator
+{
+	friend class KernelBench;
+	friend class Validator;
+
+public:
+	AnchorMapGenerator(const JobContext& context_)
+		: context(context_), swallowIterations(0), anchorMapSink(0) {}
+	~AnchorMapGenerator() {}
+
+	// sampler, when given, is the LDNI of an earlier job on the same mesh
+	Status Run(TriMesh*, BinaryImageSampler* sampler = 0);
+
+	void SetAnchorMapSink(std::vector<cv::Mat>* sink) {
+		anchorMapSink = sink;
+	}
+
+private:
+	std::vector<float> LayerHeights(TriMesh*);
+	void GenerateAnchorMaps(int, int, int, std::function<cv::Mat(int)>);
+	Status CompareSlicers(Model3D*, const std::vector<float>&);
+
+	cv::Mat Subtract(cv::Mat, cv::Mat);
+	cv::Mat Intersect(cv::Mat, cv::Mat);
+	cv::Mat Union(cv::Mat, cv::Mat);
+	cv::Mat Invert(cv::Mat);
+	bool IsZeros(cv::Mat);
+
+	cv::Mat GrowingSwallow(cv::Mat, cv::Mat, cv::Mat, float);
+	cv::Mat FrontierSwallow(cv::Mat, cv::Mat, cv::Mat);
+
+	cv::Mat GenAnchorMap(cv::Mat, float);
+
+private:
+	const JobContext& context;
+
+	long long swallowIterations;
+	// collects the map of every layer, top-down, when set
+	std::vector<cv::Mat>* anchorMapSink;
+};
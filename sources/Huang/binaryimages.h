@@ -1,33 +1,48 @@
-#pragma once
-
-#include <glslprogram.h>
-#include <model3d.h>
-#include <opencv2/opencv.hpp>
-
-class BinaryImageSampler
-{
-private:
-	Model3D* target;
-
-	GLSLProgram prog;
-	GLuint fboHandle;
-
-	int width, height;
-	glm::mat4 model, view, projection;
-
-	std::vector<cv::Mat> ldni;
-
-public:
-	BinaryImageSampler(Model3D*);
-	~BinaryImageSampler() {}
-
-	void GetImageSize(int&, int&);
-
-	cv::Mat Slice(float h);
-
-private:
-	void Configure();
-	void SetupFBO();
-	void Sample();
-	void Sort();
-};
+#pragma once
+
+#include <glcontext.h>
+#include <jobcontext.h>
+#include <status.h>
+#include <model3d.h>
+#include <opencv2/opencv.hpp>
+
+class BinaryImageSampler
+{
+	friend class KernelBench;
+
+private:
+	TriMesh* target;
+	Status status;
+
+	GLSLProgram* prog;
+	GLuint fboHandle, dsTex;
+
+	int width, height;
+	glm::mat4 model, view, projection;
+
+	std::vector<cv::Mat> ldni;
+
+public:
+	// the program, for callers that read and compile it ahead
+	static const char* vertexShader;
+	static const char* fragmentShader;
+
+	BinaryImageSampler(const JobContext&, TriMesh*);
+	~BinaryImageSampler();
+
+	// there are no layers unless this is ok
+	const Status& GetStatus() const {
+		return status;
+	}
+
+	void GetImageSize(int&, int&);
+
+	cv::Mat Slice(float h);
+
+private:
+	Status Configure(const JobContext&);
+	void SetupFBO();
+	void DeleteFBO();
+	void Sample();
+	void Sort();
+};
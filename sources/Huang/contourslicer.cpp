@@ -0,0 +1,256 @@
+#include "contourslicer.h"
+
+#include <pipelinestage.h>
+#include <omp.h>
+#include <deque>
+#include <unordered_map>
+using glm::vec2;
+using glm::vec3;
+using cv::Mat;
+
+ContourSlicer::ContourSlicer(const JobContext& context, Model3D* model3D,
+	const std::vector<float>& heights_)
+	: heights(heights_)
+{
+	PIPELINE_STAGE("compute contours");
+	Configure(context, model3D);
+	Sweep();
+}
+
+void ContourSlicer::GetImageSize(int& w, int& h)
+{
+	w = width;
+	h = height;
+}
+
+cv::Mat ContourSlicer::Slice(int layer)
+{
+	Mat slice;
+	Fill(layer, slice);
+	return slice;
+}
+
+void ContourSlicer::Slice(int first, int last, std::vector<cv::Mat>& slices)
+{
+	PROFILE_ZONE("fill contour slices");
+	slices.resize(last - first);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int i = first; i < last; i++)
+		Fill(i, slices[i - first]);
+}
+
+void ContourSlicer::Configure(const JobContext& context, Model3D* model3D)
+{
+	center = model3D->aabb.GetCenter();
+	vec3 size = model3D->aabb.GetSize();
+
+	const Params& params = context.params;
+	float margin = params.pixelWidth * 10;
+	size += vec3(margin);
+	halfX = size.x / 2.0f;
+	halfY = size.y / 2.0f;
+
+	width = round(size.x / params.pixelWidth);
+	height = round(size.y / params.pixelWidth);
+
+	mesh = &model3D->mesh;
+}
+
+glm::vec3 ContourSlicer::Vertex(GLuint v) const
+{
+	return mesh->Position(v) - center;
+}
+
+void ContourSlicer::Sweep()
+{
+	const std::vector<GLuint>& indices = mesh->indices;
+	sweep.resize(mesh->FaceCount());
+	for (int i = 0; i < sweep.size(); i++) {
+		float z0 = Vertex(indices[i * 3]).z;
+		float z1 = Vertex(indices[i * 3 + 1]).z;
+		float z2 = Vertex(indices[i * 3 + 2]).z;
+		sweep[i].zMin = std::min(z0, std::min(z1, z2));
+		sweep[i].zMax = std::max(z0, std::max(z1, z2));
+		sweep[i].index = i;
+	}
+	std::sort(sweep.begin(), sweep.end(),
+		[](const SweepTriangle& a, const SweepTriangle& b) {
+			return a.zMin < b.zMin;
+		});
+
+	int layerCount = heights.size();
+	layers.assign(layerCount, std::vector<Contour>());
+
+	// every thread sweeps its own contiguous block of layers, so the
+	// sorted list is scanned from the start only once per thread
+#pragma omp parallel
+	{
+		WORKER_ZONE("sweep layer block");
+		int nThreads = omp_get_num_threads();
+		int tid = omp_get_thread_num();
+		int first = (long long)layerCount * tid / nThreads;
+		int last = (long long)layerCount * (tid + 1) / nThreads;
+
+		std::vector<GLuint> active;
+		size_t next = 0;
+		for (int layer = first; layer < last; layer++) {
+			float h = heights[layer];
+			while (next < sweep.size() && sweep[next].zMin < h) {
+				if (sweep[next].zMax >= h)
+					active.push_back(next);
+				next++;
+			}
+
+			for (int i = 0; i < active.size();) {
+				if (sweep[active[i]].zMax < h) {
+					active[i] = active.back();
+					active.pop_back();
+				}
+				else
+					i++;
+			}
+
+			Intersect(layer, active);
+		}
+	}
+
+	size_t nPoints = 0;
+	for (const std::vector<Contour>& contours : layers) {
+		for (const Contour& contour : contours)
+			nPoints += contour.size();
+	}
+	MEMORY_TRACK("contours", sweep.size() * sizeof(SweepTriangle) +
+		nPoints * sizeof(vec2));
+}
+
+void ContourSlicer::Intersect(int layer, const std::vector<GLuint>& active)
+{
+	float h = heights[layer];
+
+	std::vector<Segment> segments;
+	segments.reserve(active.size());
+	for (int i = 0; i < active.size(); i++) {
+		const GLuint* tri = &mesh->indices[sweep[active[i]].index * 3];
+
+		Segment segment;
+		int n = 0;
+		for (int e = 0; e < 3; e++) {
+			GLuint a = tri[e];
+			GLuint b = tri[(e + 1) % 3];
+			vec3 va = Vertex(a);
+			vec3 vb = Vertex(b);
+			bool belowA = va.z < h;
+			bool belowB = vb.z < h;
+			if (belowA == belowB)
+				continue;
+
+			// the crossing of an edge is computed from its lower index
+			// so that both triangles sharing it get the identical point
+			if (a > b) {
+				std::swap(a, b);
+				std::swap(va, vb);
+			}
+			float t = (h - va.z) / (vb.z - va.z);
+			segment.key[n] = ((uint64_t)a << 32) | b;
+			segment.p[n] = vec2(va.x + t * (vb.x - va.x),
+				va.y + t * (vb.y - va.y));
+			n++;
+		}
+
+		if (n == 2)
+			segments.push_back(segment);
+	}
+
+	Chain(segments, layers[layer]);
+}
+
+void ContourSlicer::Chain(const std::vector<Segment>& segments,
+	std::vector<Contour>& contours)
+{
+	std::unordered_map<uint64_t, std::pair<int, int>> ends;
+	ends.reserve(segments.size() * 2);
+	for (int s = 0; s < segments.size(); s++) {
+		for (int e = 0; e < 2; e++) {
+			auto it = ends.emplace(segments[s].key[e],
+				std::make_pair(-1, -1)).first;
+			if (it->second.first < 0)
+				it->second.first = s;
+			else if (it->second.second < 0)
+				it->second.second = s;
+		}
+	}
+
+	std::vector<bool> used(segments.size(), false);
+	for (int s = 0; s < segments.size(); s++) {
+		if (used[s])
+			continue;
+		used[s] = true;
+
+		std::deque<vec2> chain = { segments[s].p[0], segments[s].p[1] };
+		for (int dir = 1; dir >= 0; dir--) {
+			int current = s;
+			uint64_t key = segments[s].key[dir];
+			while (true) {
+				const std::pair<int, int>& slot = ends[key];
+				int next = slot.first == current ? slot.second : slot.first;
+				if (next < 0 || used[next])
+					break;
+				used[next] = true;
+
+				int far = segments[next].key[0] == key ? 1 : 0;
+				if (dir == 1)
+					chain.push_back(segments[next].p[far]);
+				else
+					chain.push_front(segments[next].p[far]);
+				key = segments[next].key[far];
+				current = next;
+			}
+		}
+
+		contours.push_back(Contour(chain.begin(), chain.end()));
+	}
+}
+
+void ContourSlicer::Fill(int layer, cv::Mat& slice)
+{
+	slice = Mat::zeros(height, width, CV_8UC1);
+
+	float pixelX = 2.0f * halfX / width;
+	float pixelY = 2.0f * halfY / height;
+
+	// rows are top-down like the flipped read-back of BinaryImageSampler,
+	// and coordinates are measured in pixels from the first pixel center
+	std::vector<std::vector<float>> crossings(height);
+	for (const Contour& contour : layers[layer]) {
+		for (int k = 0; k < contour.size(); k++) {
+			vec2 a = contour[k];
+			vec2 b = contour[(k + 1) % contour.size()];
+			float ra = (halfY - a.y) / pixelY - 0.5f;
+			float rb = (halfY - b.y) / pixelY - 0.5f;
+			if (ra == rb)
+				continue;
+
+			int first = std::max(0, (int)ceil(std::min(ra, rb)));
+			int last = std::min(height, (int)ceil(std::max(ra, rb)));
+			for (int i = first; i < last; i++) {
+				float t = (i - ra) / (rb - ra);
+				float x = a.x + t * (b.x - a.x);
+				crossings[i].push_back((x + halfX) / pixelX - 0.5f);
+			}
+		}
+	}
+
+	for (int i = 0; i < height; i++) {
+		std::vector<float>& row = crossings[i];
+		std::sort(row.begin(), row.end());
+
+		uchar* pixels = slice.ptr<uchar>(i);
+		for (int k = 0; k + 1 < row.size(); k += 2) {
+			int enter = std::max(0, (int)ceil(row[k]));
+			int exit = std::min(width, (int)ceil(row[k + 1]));
+			for (int j = enter; j < exit; j++)
+				pixels[j] = 255;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <model3d.h>
+#include <jobcontext.h>
+
+class ContourSlicer
+{
+private:
+	struct SweepTriangle {
+		float zMin, zMax;
+		GLuint index;
+	};
+	struct Segment {
+		uint64_t key[2];
+		glm::vec2 p[2];
+	};
+	typedef std::vector<glm::vec2> Contour;
+
+	int width, height;
+	float halfX, halfY;
+
+	const MeshData* mesh;
+	glm::vec3 center;
+	std::vector<SweepTriangle> sweep;
+
+	std::vector<float> heights;
+	std::vector<std::vector<Contour>> layers;
+
+public:
+	// heights are the slicing planes in model-centered coordinates, ascending
+	ContourSlicer(const JobContext&, Model3D*, const std::vector<float>& heights);
+	~ContourSlicer() {}
+
+	void GetImageSize(int&, int&);
+
+	cv::Mat Slice(int layer);
+	void Slice(int first, int last, std::vector<cv::Mat>& slices);
+
+private:
+	void Configure(const JobContext&, Model3D*);
+	void Sweep();
+	glm::vec3 Vertex(GLuint v) const;
+	void Intersect(int layer, const std::vector<GLuint>& active);
+	void Chain(const std::vector<Segment>&, std::vector<Contour>&);
+	void Fill(int layer, cv::Mat& slice);
+};
@@ -1,65 +1,247 @@
-#include "huangapp.h"
-#include "anchormap.h"
-
-#include <params.h>
-#include <stopwatch.h>
-
-std::unique_ptr<HuangApp> HuangApp::instance;
-std::once_flag HuangApp::flag;
-
-HuangApp& HuangApp::GetInstance()
-{
-	std::call_once(flag, [] {instance.reset(new HuangApp); });
-	return *instance;
-}
-
-void HuangApp::Run(std::string path)
-{
-	model3D = Model3D::Load(path);
-	StopWatch::GetInstance().Start();
-	BuildSupportStructure();
-}
-
-HuangApp::HuangApp()
-{
-	SetParameters();
-
-	if (!glfwInit())
-		exit(EXIT_FAILURE);
-
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
-
-	offscreen = glfwCreateWindow(100, 100, "Huang App", 0, 0);
-	if (!offscreen) {
-		glfwTerminate();
-		exit(EXIT_FAILURE);
-	}
-
-	glfwMakeContextCurrent(offscreen);
-	if (!gladLoadGL()) {
-		glfwTerminate();
-		exit(EXIT_FAILURE);
-	}
-}
-
-void HuangApp::SetParameters()
-{
-	Params& params = Params::GetInstance();
-
-	params.sliceThickness = 0.1f;
-	params.dpi = 600;
-	params.pixelWidth = 25.4 / params.dpi;
-	params.maxFBOSize = 4000;
-
-	params.selfSupportThres = 0.1f;
-	params.effectiveRadius = 5.0f;
-}
-
-void HuangApp::BuildSupportStructure()
-{
-	AnchorMapGenerator generator;
-	generator.Run(model3D.get());
+#include "huangapp.h"
+#include "anchormap.h"
+#include "binaryimages.h"
+
+#include <pipelinestage.h>
+
+HuangApp::HuangApp(WorkerPool* setupPool_)
+	: prepared(false), setupPool(setupPool_)
+{
+	if (!setupPool) {
+		ownPool.reset(new WorkerPool(2));
+		setupPool = ownPool.get();
+	}
+}
+
+HuangApp::~HuangApp()
+{
+	// the cached meshes own buffers of this context
+	ContextScope current(gl.get());
+	cache.Clear();
+}
+
+void HuangApp::SetCacheSize(size_t entries)
+{
+	ContextScope current(gl.get());
+	cache.SetCapacity(entries);
+}
+
+Status HuangApp::Prepare()
+{
+	if (prepared)
+		return Status();
+
+	TaskGraph graph(*setupPool);
+	TaskFuture<Status> ready = AddSetup(graph, true);
+	graph.Run();
+	return ready.Get();
+}
+
+bool HuangApp::NeedsContext(const Params& params)
+{
+	return params.slicer == SlicerType::LDNI || params.compareSlicers;
+}
+
+Status HuangApp::CreateContext()
+{
+	if (gl)
+		return Status();
+
+	Status status;
+	gl = GLContext::Create("Huang App", status);
+	return status;
+}
+
+TaskFuture<Status> HuangApp::AddSetup(TaskGraph& graph, bool needsContext)
+{
+	if (prepared || !needsContext)
+		return graph.Add("prepared", TaskGraph::CALLER, [] { return Status(); });
+
+	TaskFuture<std::unique_ptr<ProgramSource>> source = graph.Add(
+		"read shaders", TaskGraph::ANY, [] {
+			std::unique_ptr<ProgramSource> source(new ProgramSource);
+			if (!source->Read(BinaryImageSampler::vertexShader,
+				BinaryImageSampler::fragmentShader))
+				source.reset();
+			return source;
+		});
+	TaskFuture<Status> created = graph.Add("context",
+		TaskGraph::CALLER, [this] { return CreateContext(); });
+	return graph.Add("compile shaders", TaskGraph::CALLER,
+		[this](std::unique_ptr<ProgramSource>& source, Status& created) {
+			if (!created.IsOk())
+				return created;
+			ContextScope current(*gl);
+			if (!source || !GLContext::LoadProgram(*source))
+				return Status(Status::GL_ERROR, "Unable to load the LDNI shaders");
+			prepared = true;
+			return Status();
+		}, source, created);
+}
+
+Params HuangApp::DefaultParams()
+{
+	Params params;
+
+	params.sliceThickness = 0.1f;
+	params.dpi = 600;
+	params.pixelWidth = 25.4 / params.dpi;
+	params.maxFBOSize = 4000;
+
+	params.selfSupportThres = 0.1f;
+	params.effectiveRadius = 5.0f;
+
+	params.slicer = SlicerType::LDNI;
+	params.compareSlicers = false;
+	params.swallowEngine = SwallowEngineType::ITERATIVE;
+
+	params.streamTriangles = false;
+	params.streamBatchSize = 1 << 16;
+
+	return params;
+}
+
+Status HuangApp::Run(const JobContext& context, std::string path,
+	JobResult* result)
+{
+	const Params& params = context.params;
+	// the contour slicer reads the host copy of the mesh
+	bool gpuOnly = params.slicer == SlicerType::LDNI && !params.compareSlicers;
+
+	// the mesh is read while the context is created and the program
+	// compiled, so a cold start costs about the longest of the three
+	TaskGraph graph(*setupPool);
+	TaskFuture<Status> ready = AddSetup(graph,
+		NeedsContext(params) || params.streamTriangles);
+	TaskFuture<std::unique_ptr<TriMesh>> loaded;
+	TriangleStream* stream = 0;
+	if (params.streamTriangles) {
+		// the stream creates its vertex buffer as it opens
+		loaded = graph.Add("load mesh", TaskGraph::CALLER,
+			[this, &path, &params, &stream](Status& ready) {
+				std::unique_ptr<TriangleStream> mesh;
+				if (ready.IsOk()) {
+					ContextScope current(*gl);
+					mesh = TriangleStream::Open(path, params.streamBatchSize);
+					stream = mesh.get();
+				}
+				return std::unique_ptr<TriMesh>(std::move(mesh));
+			}, ready);
+	}
+	else {
+		TaskFuture<std::unique_ptr<Model3D>> model3D = graph.Add("load mesh",
+			TaskGraph::ANY, [&path] { return Model3D::Load(path); });
+		loaded = graph.Add("upload mesh", TaskGraph::CALLER,
+			[this, gpuOnly](std::unique_ptr<Model3D>& model3D, Status& ready) {
+				std::unique_ptr<TriMesh> mesh;
+				if (model3D && ready.IsOk()) {
+					if (gpuOnly) {
+						ContextScope current(*gl);
+						model3D->ReleaseHostData();
+					}
+					mesh = std::move(model3D);
+				}
+				return mesh;
+			}, model3D, ready);
+	}
+	{
+		PIPELINE_STAGE("setup");
+		graph.Run();
+	}
+	if (!ready.Get().IsOk())
+		return ready.Get();
+
+	ContextScope current(gl.get());
+	std::unique_ptr<TriMesh> mesh = std::move(loaded.Get());
+	if (!mesh)
+		return Status(Status::IO_ERROR, "Unable to read " + path);
+
+	PIPELINE_STAGE("build support structure");
+	Status status = BuildSupportStructure(context, mesh.get(), result);
+	// every pass re-reads the file, which may have changed since it opened
+	if (status.IsOk() && stream && !stream->GetStatus().IsOk())
+		return stream->GetStatus();
+	return status;
+}
+
+Status HuangApp::Run(const JobContext& context, std::unique_ptr<Model3D> model3D,
+	JobResult* result)
+{
+	const Params& params = context.params;
+	if (NeedsContext(params)) {
+		Status status = Prepare();
+		if (!status.IsOk())
+			return status;
+	}
+	ContextScope current(gl.get());
+
+	// moved into a local so the buffers are freed while the context is
+	// still current
+	std::unique_ptr<Model3D> mesh = std::move(model3D);
+	{
+		PIPELINE_STAGE("upload mesh");
+		if (params.slicer == SlicerType::LDNI && !params.compareSlicers)
+			mesh->ReleaseHostData();
+	}
+
+	PIPELINE_STAGE("build support structure");
+	return BuildSupportStructure(context, mesh.get(), result);
+}
+
+Status HuangApp::Run(const JobContext& context, const std::string& key,
+	std::function<std::unique_ptr<Model3D>()> load, JobResult* result,
+	bool* cacheHit)
+{
+	const Params& params = context.params;
+	if (NeedsContext(params)) {
+		Status status = Prepare();
+		if (!status.IsOk())
+			return status;
+	}
+	// current whenever it exists, an eviction may free LDNI buffers
+	ContextScope current(gl.get());
+
+	CacheEntry* entry = cache.Find(key);
+	if (cacheHit)
+		*cacheHit = entry != 0;
+	if (!entry) {
+		CacheEntry loaded;
+		{
+			PIPELINE_STAGE("load mesh");
+			loaded.mesh = load();
+			if (!loaded.mesh)
+				return Status(Status::IO_ERROR, "Unable to read " + key);
+		}
+		loaded.pixelWidth = 0;
+		entry = &cache.Insert(key, std::move(loaded));
+	}
+
+	if (params.slicer == SlicerType::LDNI &&
+		(!entry->ldni || entry->pixelWidth != params.pixelWidth)) {
+		entry->ldni.reset(new BinaryImageSampler(context, entry->mesh.get()));
+		entry->pixelWidth = params.pixelWidth;
+	}
+
+	Status status;
+	{
+		PIPELINE_STAGE("build support structure");
+		status = BuildSupportStructure(context, entry->mesh.get(), result,
+			entry->ldni.get());
+	}
+
+	// a failed LDNI is not worth keeping, the next hit tries again
+	if (!status.IsOk())
+		entry->ldni.reset();
+	if (cache.Capacity() == 0)
+		cache.Clear();
+	return status;
+}
+
+Status HuangApp::BuildSupportStructure(const JobContext& context,
+	TriMesh* mesh, JobResult* result, BinaryImageSampler* sampler)
+{
+	AnchorMapGenerator generator(context);
+	if (result)
+		generator.SetAnchorMapSink(&result->anchorMaps);
+	return generator.Run(mesh, sampler);
 }
\ No newline at end of file
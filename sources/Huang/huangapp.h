@@ -1,29 +1,73 @@
-#pragma once
-
-#include <memory>
-#include <GLFW/glfw3.h>
-#include <model3d.h>
-
-class HuangApp
-{
-public:
-	~HuangApp() {}
-
-	static HuangApp& GetInstance();
-
-	void Run(std::string);
-
-private:
-	HuangApp();
-
-	void SetParameters();
-	void BuildSupportStructure();
-
-private:
-	static std::unique_ptr<HuangApp> instance;
-	static std::once_flag flag;
-
-	GLFWwindow* offscreen;
-
-	std::unique_ptr<Model3D> model3D;
-};
+#pragma once
+
+#include <memory>
+#include <functional>
+#include <glcontext.h>
+#include <status.h>
+#include <jobcontext.h>
+#include <jobresult.h>
+#include <meshcache.h>
+#include <model3d.h>
+#include <trianglestream.h>
+#include <taskgraph.h>
+#include <workerpool.h>
+
+class BinaryImageSampler;
+
+class HuangApp
+{
+public:
+	// The CPU side of the setup runs on setupPool, which has to outlive
+	// the app, or on two threads of its own when none is given. Callers
+	// with many apps share one pool between them.
+	explicit HuangApp(WorkerPool* setupPool_ = 0);
+	~HuangApp();
+
+	// recipe defaults, adjusted by the caller before the job starts
+	static Params DefaultParams();
+
+	// Creates the context and compiles the LDNI program. The first Run
+	// that needs them does it otherwise, overlapped with reading the mesh;
+	// on the GLFW fallback it has to happen on the main thread.
+	Status Prepare();
+
+	Status Run(const JobContext&, std::string, JobResult* = 0);
+	// runs on a mesh that is already in memory, e.g. a generated one
+	Status Run(const JobContext&, std::unique_ptr<Model3D>, JobResult* = 0);
+	// Runs on the mesh cached under key and calls load only on a miss. A
+	// hit at the same resolution also reuses the LDNI, so only the anchor
+	// maps are computed again. Fails with IO_ERROR if load gave no mesh.
+	Status Run(const JobContext&, const std::string& key,
+		std::function<std::unique_ptr<Model3D>()> load,
+		JobResult* = 0, bool* cacheHit = 0);
+
+	// meshes kept for the keyed Run
+	void SetCacheSize(size_t entries);
+
+	// the recipe itself, on whatever GL context is current; the contour
+	// slicer needs no context at all
+	static Status BuildSupportStructure(const JobContext&, TriMesh*, JobResult*,
+		BinaryImageSampler* = 0);
+
+private:
+	// the mesh keeps its host copy, so either slicer can run on it
+	struct CacheEntry {
+		std::unique_ptr<Model3D> mesh;
+		float pixelWidth;
+		std::unique_ptr<BinaryImageSampler> ldni;
+	};
+
+	// the contour slicer alone runs without a context
+	static bool NeedsContext(const Params&);
+	// the context and program tasks; the future is ok once both are ready
+	TaskFuture<Status> AddSetup(TaskGraph&, bool needsContext);
+	Status CreateContext();
+
+private:
+	std::unique_ptr<GLContext> gl;
+	bool prepared;
+	// runs the CPU side of the setup, such as reading the mesh
+	WorkerPool* setupPool;
+	std::unique_ptr<WorkerPool> ownPool;
+	MeshCache<CacheEntry> cache;
+};
@@ -0,0 +1,300 @@
+#include "supportlib.h"
+
+#include "freefloatingapp.h"
+#include "incremental.h"
+#include "supportpoint.h"
+#include "huangapp.h"
+#include "vanekapp.h"
+
+#include <glcontext.h>
+#include <jobcontext.h>
+#include <model3d.h>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+using glm::vec3;
+
+namespace
+{
+	// Uploads the caller's streams straight into the GL buffers, so the
+	// GPU-only recipes never copy the mesh on the host.
+	class BorrowedMesh : public TriMesh
+	{
+	public:
+		BorrowedMesh(const MeshView& view_) : view(view_) {
+			const float* p = view.positions.data;
+			for (size_t v = 0; v < view.positions.size; v += 3)
+				aabb.Add(vec3(p[v], p[v + 1], p[v + 2]));
+		}
+
+		void Render() override {
+			if (vao == 0)
+				InitBuffers(view.indices.data, view.indices.size,
+					view.positions.data, view.positions.size);
+
+			TriMesh::Render();
+		}
+
+	private:
+		MeshView view;
+	};
+
+	template<typename T>
+	bool Fits(const OutputBuffer<T>& buffer)
+	{
+		return !buffer.data || buffer.owned || buffer.capacity >= buffer.size;
+	}
+
+	template<typename T>
+	T* Reserve(OutputBuffer<T>& buffer, std::vector<T>& arena)
+	{
+		if (!buffer.data || buffer.owned) {
+			arena.resize(buffer.size);
+			buffer.data = arena.data();
+			buffer.capacity = arena.size();
+			buffer.owned = true;
+		}
+		return buffer.data;
+	}
+
+	void CopyPoints(const std::vector<vec3>& points, OutputBuffer<float>& buffer,
+		std::vector<float>& arena)
+	{
+		float* out = Reserve(buffer, arena);
+		for (size_t i = 0; i < points.size(); i++) {
+			out[i * 3] = points[i].x;
+			out[i * 3 + 1] = points[i].y;
+			out[i * 3 + 2] = points[i].z;
+		}
+	}
+}
+
+SupportConfig SupportConfig::Defaults(Recipe recipe)
+{
+	SupportConfig config;
+	config.recipe = recipe;
+	if (recipe == Recipe::FREE_FLOATING) {
+		config.backend = Backend::GL;
+		config.params = FreeFloatingApp::DefaultParams();
+	}
+	else if (recipe == Recipe::HUANG) {
+		config.backend = Backend::CPU;
+		config.params = HuangApp::DefaultParams();
+		config.params.slicer = SlicerType::CONTOUR;
+	}
+	else {
+		config.backend = Backend::CPU;
+		config.params = VanekApp::DefaultParams();
+		config.params.faceSampler = FaceSamplerType::BARYCENTRIC;
+	}
+	config.params.streamTriangles = false;
+	return config;
+}
+
+SupportSession::SupportSession()
+{
+}
+
+SupportSession::~SupportSession()
+{
+}
+
+Status SupportSession::Run(const SupportConfig& config, const MeshView& view,
+	SupportOutput& output)
+{
+	return Run(config, view, SupportProgress(), output);
+}
+
+Status SupportSession::Run(const SupportConfig& config, const MeshView& view,
+	const SupportProgress& progress, SupportOutput& output)
+{
+	std::chrono::steady_clock::time_point start =
+		std::chrono::steady_clock::now();
+	last = JobResult();
+	incremental.reset();
+
+	Status status = Validate(config, view);
+	if (!status.IsOk())
+		return status;
+
+	bool progressive = progress.emit || progress.budget > 0 || progress.cancel;
+	if (progressive && config.recipe != Recipe::FREE_FLOATING)
+		return Status(Status::UNSUPPORTED, "Only FreeFloating runs progressively");
+	SearchProgress search;
+	if (progress.emit) {
+		const std::function<void(const float*, float)>& emit = progress.emit;
+		search.emit = [&emit](const vec3& point, float covered) {
+			float xyz[3] = { point.x, point.y, point.z };
+			emit(xyz, covered);
+		};
+	}
+	if (progress.budget > 0)
+		search.deadline = start +
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>(progress.budget));
+	search.cancel = progress.cancel;
+
+	if (config.backend == Backend::GL) {
+		if (!gl) {
+			gl = GLContext::Create("Support Library", status);
+			if (!status.IsOk())
+				return status;
+		}
+		ContextScope current(*gl);
+		status = Build(config, view, progressive ? &search : 0);
+	}
+	else
+		status = Build(config, view, 0);
+
+	if (!status.IsOk())
+		return status;
+	return Emit(output);
+}
+
+Status SupportSession::Update(const SupportConfig& config,
+	const MeshView& edited, Span<float> changed, SupportOutput& output)
+{
+	last = JobResult();
+
+	Status status = Validate(config, edited);
+	if (!status.IsOk())
+		return status;
+	if (config.recipe != Recipe::FREE_FLOATING || config.backend != Backend::GL)
+		return Status(Status::UNSUPPORTED, "Updates need FreeFloating on GL");
+	if (changed.size % 9 != 0 || (changed.size > 0 && !changed.data))
+		return Status(Status::INVALID_ARGUMENT,
+			"Changed triangles come in nines");
+
+	if (!gl) {
+		gl = GLContext::Create("Support Library", status);
+		if (!status.IsOk())
+			return status;
+	}
+	ContextScope current(*gl);
+	BorrowedMesh mesh(edited);
+	if (!incremental) {
+		incremental.reset(new IncrementalSupport(config.params));
+		status = incremental->Run(&mesh);
+	}
+	else {
+		std::vector<vec3> corners;
+		for (size_t c = 0; c < changed.size; c += 3)
+			corners.push_back(vec3(changed.data[c], changed.data[c + 1],
+				changed.data[c + 2]));
+		status = incremental->Update(&mesh, corners);
+	}
+	if (!status.IsOk()) {
+		incremental.reset();
+		return status;
+	}
+
+	last.supportPoints = incremental->GetSupportPoints();
+	return Emit(output);
+}
+
+Status SupportSession::Validate(const SupportConfig& config,
+	const MeshView& view) const
+{
+	const Span<float>& positions = view.positions;
+	const Span<uint32_t>& indices = view.indices;
+	if (positions.size % 3 != 0 || indices.size % 3 != 0)
+		return Status(Status::INVALID_ARGUMENT,
+			"Positions and indices come in threes");
+	if (indices.size == 0 || !indices.data || !positions.data)
+		return Status(Status::INVALID_ARGUMENT, "The mesh has no triangles");
+
+	size_t nVertices = positions.size / 3;
+	for (size_t i = 0; i < indices.size; i++) {
+		if (indices.data[i] >= nVertices) {
+			std::ostringstream message;
+			message << "Index " << i << " refers to vertex " <<
+				indices.data[i] << " of " << nVertices;
+			return Status(Status::INVALID_ARGUMENT, message.str());
+		}
+	}
+
+	const Params& params = config.params;
+	if (params.pixelWidth <= 0 || params.sliceThickness <= 0)
+		return Status(Status::INVALID_ARGUMENT,
+			"The pixel width and the slice thickness must be positive");
+
+	if (config.backend == Backend::CPU) {
+		if (config.recipe == Recipe::FREE_FLOATING)
+			return Status(Status::UNSUPPORTED,
+				"FreeFloating needs the GL backend");
+		if (config.recipe == Recipe::HUANG &&
+			(params.slicer != SlicerType::CONTOUR || params.compareSlicers))
+			return Status(Status::UNSUPPORTED,
+				"Huang on the CPU backend needs the contour slicer alone");
+		if (config.recipe == Recipe::VANEK &&
+			params.faceSampler != FaceSamplerType::BARYCENTRIC)
+			return Status(Status::UNSUPPORTED,
+				"Vanek on the CPU backend needs the barycentric face sampler");
+	}
+	return Status();
+}
+
+Status SupportSession::Build(const SupportConfig& config, const MeshView& view,
+	const SearchProgress* progress)
+{
+	JobContext context(config.params);
+	const Params& params = context.params;
+
+	bool gpuOnly = config.recipe == Recipe::FREE_FLOATING ||
+		(config.recipe == Recipe::HUANG && params.slicer == SlicerType::LDNI &&
+			!params.compareSlicers);
+	if (gpuOnly) {
+		BorrowedMesh mesh(view);
+		if (config.recipe == Recipe::FREE_FLOATING)
+			return FreeFloatingApp::BuildSupportStructure(context, &mesh, &last,
+				progress);
+		return HuangApp::BuildSupportStructure(context, &mesh, &last);
+	}
+
+	// the CPU stages read a MeshData, so the mesh is copied once
+	MeshData data;
+	data.points.assign(view.positions.data,
+		view.positions.data + view.positions.size);
+	data.indices.assign(view.indices.data,
+		view.indices.data + view.indices.size);
+	std::unique_ptr<Model3D> model3D = Model3D::Create(std::move(data));
+
+	if (config.recipe == Recipe::HUANG)
+		return HuangApp::BuildSupportStructure(context, model3D.get(), &last);
+
+	model3D->mesh.HalfedgeMesh();
+	return VanekApp::BuildSupportStructure(context, model3D.get(), &last);
+}
+
+Status SupportSession::Emit(SupportOutput& output)
+{
+	const std::vector<cv::Mat>& maps = last.anchorMaps;
+	output.layers = maps.size();
+	output.rows = maps.empty() ? 0 : maps[0].rows;
+	output.cols = maps.empty() ? 0 : maps[0].cols;
+	output.covered = last.covered;
+
+	output.supportPoints.size = last.supportPoints.size() * 3;
+	output.anchorMaps.size = (size_t)output.layers * output.rows * output.cols;
+	output.overhangSamples.size = last.overhangSamples.size() * 3;
+	output.supportSegments.size = last.supportSegments.size() * 3;
+
+	if (!Fits(output.supportPoints) || !Fits(output.anchorMaps) ||
+		!Fits(output.overhangSamples) || !Fits(output.supportSegments))
+		return Status(Status::BUFFER_TOO_SMALL,
+			"An output buffer is smaller than its size");
+
+	CopyPoints(last.supportPoints, output.supportPoints, pointArena);
+	CopyPoints(last.overhangSamples, output.overhangSamples, sampleArena);
+	CopyPoints(last.supportSegments, output.supportSegments, segmentArena);
+
+	uint8_t* out = Reserve(output.anchorMaps, mapArena);
+	for (const cv::Mat& map : maps) {
+		for (int r = 0; r < map.rows; r++) {
+			const uchar* row = map.ptr<uchar>(r);
+			std::copy(row, row + map.cols, out);
+			out += map.cols;
+		}
+	}
+	return Status();
+}
\ No newline at end of file
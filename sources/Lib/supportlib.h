@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <params.h>
+#include <jobresult.h>
+#include <status.h>
+
+class GLContext;
+class IncrementalSupport;
+struct SearchProgress;
+
+// Support generation for programs that link it in rather than run the
+// command line tools. The mesh is borrowed from the caller, results go to
+// the caller's buffers or to storage of the session, and every failure is
+// a Status; nothing exits and no window is opened unless the GL backend is
+// asked for. Builds of the library define NO_PROFILER and NO_MEMORY_STATS.
+
+template<typename T>
+struct Span {
+	const T* data;
+	size_t size;
+};
+
+// Three floats per vertex and three indices per triangle. The memory has
+// to stay valid for the duration of Run.
+struct MeshView {
+	Span<float> positions;
+	Span<uint32_t> indices;
+};
+
+enum class Recipe {
+	FREE_FLOATING,
+	HUANG,
+	VANEK
+};
+
+// CPU runs without a context: Huang with the contour slicer and Vanek with
+// the barycentric face sampler. FreeFloating always needs GL.
+enum class Backend {
+	CPU,
+	GL
+};
+
+struct SupportConfig {
+	Recipe recipe;
+	Backend backend;
+	Params params;
+
+	// the recipe defaults, moved to the CPU backend where the recipe has one
+	static SupportConfig Defaults(Recipe);
+};
+
+// Caller memory of capacity elements, or, with data null, storage of the
+// session that stays valid until its next Run or Emit. size is set to the
+// number of elements of the result even when the buffer is too small.
+// Session storage sets owned, so the same output can be passed again and
+// gets fresh storage instead of being held to the previous size.
+template<typename T>
+struct OutputBuffer {
+	OutputBuffer() : data(0), capacity(0), size(0), owned(false) {}
+
+	T* data;
+	size_t capacity;
+	size_t size;
+	bool owned;
+};
+
+// Progressive FreeFloating runs. emit gets each support point, three
+// floats, as soon as it is committed, lowest first, with the fraction of
+// the floatable vertices covered so far. The run stops early with the
+// points so far once budget seconds have passed since Run was called or
+// once cancel is set; zero and null for neither.
+struct SupportProgress {
+	SupportProgress() : budget(0), cancel(0) {}
+
+	std::function<void(const float* point, float covered)> emit;
+	double budget;
+	const std::atomic<bool>* cancel;
+};
+
+// The parts of JobResult as flat arrays of floats, three per point and six
+// per segment. Anchor maps are layers * rows * cols bytes, top layer first.
+// covered is below 1 only when a progressive run stopped early.
+struct SupportOutput {
+	SupportOutput() : layers(0), rows(0), cols(0), covered(1) {}
+
+	OutputBuffer<float> supportPoints;
+	OutputBuffer<uint8_t> anchorMaps;
+	int layers, rows, cols;
+	OutputBuffer<float> overhangSamples;
+	OutputBuffer<float> supportSegments;
+	float covered;
+};
+
+// One session per thread. The GL backend creates the context on its first
+// run and keeps it, with the compiled programs, for the later ones. EGL
+// needs no display; only on the GLFW fallback does that first run have to
+// be on the main thread.
+class SupportSession
+{
+public:
+	SupportSession();
+	~SupportSession();
+
+	Status Run(const SupportConfig&, const MeshView&, SupportOutput&);
+	// a progressive run, FreeFloating only
+	Status Run(const SupportConfig&, const MeshView&, const SupportProgress&,
+		SupportOutput&);
+	// the result of the last Run again, e.g. into the larger buffers asked
+	// for by BUFFER_TOO_SMALL
+	Status Emit(SupportOutput&);
+	// FreeFloating on GL for a mesh edited since the last Update. Only the
+	// columns under the changed triangles, nine floats each for the removed
+	// and the added ones, are rendered again, and only the covers that
+	// reach them are searched again; the points are those of a full run.
+	// The first Update after construction or a Run is a full run with
+	// config; the later ones keep its params. Only the support points are
+	// set.
+	Status Update(const SupportConfig&, const MeshView& edited,
+		Span<float> changed, SupportOutput&);
+
+private:
+	SupportSession(const SupportSession&) = delete;
+	SupportSession& operator=(const SupportSession&) = delete;
+
+	Status Validate(const SupportConfig&, const MeshView&) const;
+	Status Build(const SupportConfig&, const MeshView&,
+		const SearchProgress* progress);
+
+private:
+	std::unique_ptr<GLContext> gl;
+	JobResult last;
+	std::unique_ptr<IncrementalSupport> incremental;
+
+	std::vector<float> pointArena, sampleArena, segmentArena;
+	std::vector<uint8_t> mapArena;
+};
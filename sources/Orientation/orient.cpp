@@ -0,0 +1,110 @@
+#include "freefloatingapp.h"
+#include "orientation.h"
+
+#include <params.h>
+#include <pipelinestage.h>
+#include <iostream>
+#include <iomanip>
+
+void ParseOptions(int argc, char** argv, OrientationConfig& config,
+	Params& params)
+{
+	for (int i = 2; i < argc; i++) {
+		std::string option = argv[i];
+		std::string name, value;
+		SplitOption(option, name, value);
+
+		bool known = true;
+		if (name == "--candidates")
+			known = ParseNumber(value, config.candidates);
+		else if (name == "--refine-seeds")
+			known = ParseNumber(value, config.refineSeeds);
+		else if (name == "--refine-samples")
+			known = ParseNumber(value, config.refineSamples);
+		else if (name == "--finalists")
+			known = ParseNumber(value, config.finalists);
+		else if (name == "--coarse-dpi")
+			known = ParseNumber(value, config.coarseDpi);
+		else if (name == "--area-weight")
+			known = ParseNumber(value, config.areaWeight);
+		else if (name == "--threads")
+			known = ParseNumber(value, config.threads);
+		else
+			known = ParseOption(option, params);
+
+		if (!known) {
+			std::cerr << "Unknown option : " << option << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (config.candidates < 1 || config.coarseDpi < 1) {
+		std::cerr << "At least one candidate and one dot per inch are needed" <<
+			std::endl;
+		exit(EXIT_FAILURE);
+	}
+	PerfCounters::GetInstance().Enable(params.perfCounters);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::cerr << "usage: orient <mesh> [--candidates=n] [--refine-seeds=n] "
+			"[--refine-samples=n] [--finalists=n] [--coarse-dpi=n] "
+			"[--area-weight=mm] [--threads=n] [FreeFloating options]" <<
+			std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	OrientationConfig config;
+	Params params = FreeFloatingApp::DefaultParams();
+	ParseOptions(argc, argv, config, params);
+	JobContext context(params);
+
+	StartPipelineStats();
+	std::unique_ptr<Model3D> model3D;
+	{
+		PIPELINE_STAGE("load mesh");
+		model3D = Model3D::Load(argv[1]);
+	}
+	if (!model3D) {
+		std::cerr << "Unable to read " << argv[1] << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	FreeFloatingApp app;
+	std::vector<OrientationCandidate> ranked;
+	Status status = app.FindOrientation(context, std::move(model3D), config,
+		ranked);
+	if (!status.IsOk()) {
+		std::cerr << status.Message() << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	std::cout << "rank up overhang(mm2) volume(mm3) cost ms points full(ms)" <<
+		std::endl;
+	std::cout << std::fixed;
+	for (size_t i = 0; i < ranked.size(); i++) {
+		const OrientationCandidate& candidate = ranked[i];
+		std::cout << std::setprecision(3) << i << " " << candidate.up.x << "," <<
+			candidate.up.y << "," << candidate.up.z << " " <<
+			std::setprecision(1) << candidate.overhangArea << " " <<
+			candidate.supportedVolume << " " << candidate.cost << " " <<
+			std::setprecision(2) << candidate.seconds * 1000;
+		if (candidate.supportPoints >= 0)
+			std::cout << " " << candidate.supportPoints << " " <<
+				candidate.fullSeconds * 1000;
+		else if (!candidate.skipReason.empty())
+			std::cout << " skipped: " << candidate.skipReason;
+		std::cout << std::endl;
+	}
+
+	Profiler::GetInstance().PrintSummary(std::cout);
+	if (!params.tracePath.empty())
+		Profiler::GetInstance().WriteTrace(params.tracePath);
+	PerfCounters::GetInstance().PrintSummary(std::cout);
+
+	Metrics::GetInstance().PrintSummary(std::cout);
+	if (!params.metricsPath.empty())
+		Metrics::GetInstance().WriteReport(params.metricsPath);
+}
\ No newline at end of file
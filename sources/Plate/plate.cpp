@@ -0,0 +1,70 @@
+#include "freefloatingapp.h"
+#include "plate.h"
+
+#include <params.h>
+#include <pipelinestage.h>
+#include <iostream>
+
+void ParseOptions(int argc, char** argv, Params& params)
+{
+	for (int i = 2; i < argc; i++) {
+		std::string option = argv[i];
+		if (!ParseOption(option, params)) {
+			std::cerr << "Unknown option : " << option << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	PerfCounters::GetInstance().Enable(params.perfCounters);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::cerr << "usage: plate <plate file> [FreeFloating options]" <<
+			std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	Params params = FreeFloatingApp::DefaultParams();
+	ParseOptions(argc, argv, params);
+	JobContext context(params);
+
+	StartPipelineStats();
+	std::unique_ptr<Plate> plate(new Plate);
+	Status status;
+	{
+		PIPELINE_STAGE("load plate");
+		status = ReadPlate(argv[1], *plate);
+	}
+	if (!status.IsOk()) {
+		std::cerr << status.Message() << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	std::vector<std::string> names = plate->names;
+	std::vector<JobResult> results;
+	FreeFloatingApp app;
+	status = app.RunPlate(context, std::move(plate), &results);
+	if (!status.IsOk()) {
+		std::cerr << status.Message() << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t p = 0; p < results.size(); p++)
+		std::cout << p << " " << names[p] << " : " <<
+			results[p].supportPoints.size() << " support points" << std::endl;
+
+	Profiler::GetInstance().PrintSummary(std::cout);
+	if (!params.tracePath.empty())
+		Profiler::GetInstance().WriteTrace(params.tracePath);
+	PerfCounters::GetInstance().PrintSummary(std::cout);
+
+	MemoryStats::GetInstance().PrintSummary(std::cout);
+	if (!params.memoryReportPath.empty())
+		MemoryStats::GetInstance().WriteReport(params.memoryReportPath);
+
+	Metrics::GetInstance().PrintSummary(std::cout);
+	if (!params.metricsPath.empty())
+		Metrics::GetInstance().WriteReport(params.metricsPath);
+}
\ No newline at end of file
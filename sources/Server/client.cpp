@@ -0,0 +1,162 @@
+#include <params.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Stand-in for the slicer front end: sends the same job to the support
+// server a number of times and prints the round trip of each, so the
+// first, cold request can be compared with the repeated edits.
+
+struct ClientConfig {
+	std::string socketPath;
+	std::string recipe;
+	std::string mesh;
+	std::vector<std::string> options;
+	bool sendInline;
+	int repeat;
+	// raw reply of the last request
+	std::string outPath;
+};
+
+int Connect(const std::string& path)
+{
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+		std::cerr << "Unable to connect to " << path << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return fd;
+}
+
+bool SendAll(int fd, const std::string& data)
+{
+	size_t done = 0;
+	while (done < data.size()) {
+		ssize_t n = send(fd, data.data() + done, data.size() - done, 0);
+		if (n <= 0)
+			return false;
+		done += n;
+	}
+	return true;
+}
+
+// reads up to and including the END or ERROR line
+bool ReadReply(int fd, std::string& reply)
+{
+	reply.clear();
+	char buffer[1 << 16];
+	while (true) {
+		size_t last = reply.rfind('\n', reply.size() >= 2 ? reply.size() - 2 : 0);
+		std::string tail = reply.substr(last == std::string::npos ? 0 : last + 1);
+		if (tail == "END\n" || (tail.compare(0, 6, "ERROR ") == 0 &&
+			tail.back() == '\n'))
+			return true;
+
+		ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+		if (n <= 0)
+			return false;
+		reply.append(buffer, n);
+	}
+}
+
+void ParseOptions(int argc, char** argv, ClientConfig& config)
+{
+	for (int i = 4; i < argc; i++) {
+		std::string option = argv[i];
+		if (option == "--inline")
+			config.sendInline = true;
+		else if (option.compare(0, 9, "--repeat=") == 0) {
+			if (!ParseNumber(option.substr(9), config.repeat)) {
+				std::cerr << "Unknown option : " << option << std::endl;
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (option.compare(0, 6, "--out=") == 0)
+			config.outPath = option.substr(6);
+		else
+			config.options.push_back(option);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 4) {
+		std::cerr << "usage: client <socket> <recipe> <mesh> [--inline] "
+			"[--repeat=n] [--out=path] [recipe options]" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	ClientConfig config;
+	config.socketPath = argv[1];
+	config.recipe = argv[2];
+	config.mesh = argv[3];
+	config.sendInline = false;
+	config.repeat = 1;
+	ParseOptions(argc, argv, config);
+
+	std::string payload;
+	std::ostringstream request;
+	request << "RUN " << config.recipe << " ";
+	if (config.sendInline) {
+		std::ifstream in(config.mesh, std::ios::binary);
+		if (!in) {
+			std::cerr << "Unable to open " << config.mesh << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		payload.assign(std::istreambuf_iterator<char>(in),
+			std::istreambuf_iterator<char>());
+		request << "inline:" << payload.size();
+	}
+	else
+		request << std::quoted(config.mesh);
+	for (const std::string& option : config.options)
+		request << " " << option;
+	request << "\n";
+
+	int fd = Connect(config.socketPath);
+	std::string reply;
+	for (int i = 0; i < config.repeat; i++) {
+		std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+		if (!SendAll(fd, request.str() + payload) || !ReadReply(fd, reply)) {
+			std::cerr << "Connection closed by the server" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		double ms = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count();
+
+		// the status line and the section headers
+		std::istringstream lines(reply);
+		std::string line, summary;
+		while (std::getline(lines, line)) {
+			if (line.compare(0, 3, "OK ") == 0 || line.compare(0, 6, "ERROR ") == 0 ||
+				line.compare(0, 7, "POINTS ") == 0 || line.compare(0, 7, "LAYERS ") == 0 ||
+				line.compare(0, 8, "SAMPLES ") == 0 || line.compare(0, 9, "SEGMENTS ") == 0)
+				summary += (summary.empty() ? "" : ", ") + line;
+		}
+		std::cout << "request " << i << " " << std::fixed << std::setprecision(1) <<
+			ms << " ms round trip : " << summary << std::endl;
+	}
+
+	SendAll(fd, "QUIT\n");
+	close(fd);
+
+	if (!config.outPath.empty()) {
+		std::ofstream out(config.outPath, std::ios::binary);
+		out << reply;
+	}
+}
\ No newline at end of file
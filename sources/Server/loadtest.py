@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""Load test for the support server.
+
+Every client connects once and sends its requests one after another,
+cycling through the meshes and a few option sets, the way an interactive
+front end re-runs a part after an edit. The first request of a mesh is
+reported as cold, the rest as warm.
+
+With --fault, a request of the Fault recipe, whose job throws on its
+worker, is sent first; the server, started with --fault-recipe, has to
+reply ERROR and keep serving the same connection.
+
+usage: loadtest.py <socket> <recipe> <mesh> [mesh ...]
+                   [--clients=n] [--requests=n] [--inline] [--fault]
+"""
+
+import socket
+import sys
+import threading
+import time
+
+OPTION_SETS = {
+    "FreeFloating": [[], ["--graph=column"]],
+    "Huang": [[], ["--swallow=frontier"], ["--slicer=contour"]],
+    "Vanek": [[], ["--face-sampler=gl"]],
+}
+
+
+def read_reply(sock, pending):
+    """Returns the reply up to its END or ERROR line and the bytes after it."""
+    data = pending
+    start = 0
+    while True:
+        end = data.find(b"\n", start)
+        if end < 0:
+            chunk = sock.recv(1 << 16)
+            if not chunk:
+                raise ConnectionError("connection closed by the server")
+            data += chunk
+            continue
+        line = data[start:end]
+        if line == b"END" or line.startswith(b"ERROR "):
+            return data[:end + 1], data[end + 1:]
+        start = end + 1
+
+
+def request(recipe, mesh, payloads, args=""):
+    if payloads is not None:
+        payload = payloads[mesh]
+        header = "RUN %s inline:%d %s\n" % (recipe, len(payload), args)
+        return header.encode() + payload
+    return ('RUN %s "%s" %s\n' % (recipe, mesh, args)).encode()
+
+
+def check_fault(path, recipe, mesh, payloads):
+    """Returns None if a throwing job failed alone, else what went wrong."""
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(path)
+    try:
+        sock.sendall(request("Fault", mesh, payloads))
+        reply, pending = read_reply(sock, b"")
+        status = reply.split(b"\n", 1)[0].decode()
+        if not status.startswith("ERROR "):
+            return "the Fault request got " + status
+        sock.sendall(request(recipe, mesh, payloads))
+        reply, pending = read_reply(sock, pending)
+        status = reply.split(b"\n", 1)[0].decode()
+        if not status.startswith("OK"):
+            return "the request after the fault got " + status
+        sock.sendall(b"QUIT\n")
+    except ConnectionError as e:
+        return str(e)
+    finally:
+        sock.close()
+    return None
+
+
+def client(path, recipe, meshes, payloads, requests, results, index):
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(path)
+    options = OPTION_SETS.get(recipe, [[]])
+    pending = b""
+    for i in range(requests):
+        mesh = meshes[(index + i) % len(meshes)]
+        args = " ".join(options[i // len(meshes) % len(options)])
+        message = request(recipe, mesh, payloads, args)
+
+        start = time.perf_counter()
+        sock.sendall(message)
+        reply, pending = read_reply(sock, pending)
+        elapsed = (time.perf_counter() - start) * 1e3
+
+        status = reply.split(b"\n", 1)[0].decode()
+        results.append((mesh, elapsed, status))
+    sock.sendall(b"QUIT\n")
+    sock.close()
+
+
+def percentile(values, p):
+    values = sorted(values)
+    if not values:
+        return 0.0
+    return values[min(len(values) - 1, int(p / 100.0 * len(values)))]
+
+
+def report(name, values):
+    if not values:
+        return
+    print("%-5s %5d requests  p50 %8.1f ms  p95 %8.1f ms  max %8.1f ms" % (
+        name, len(values), percentile(values, 50), percentile(values, 95),
+        max(values)))
+
+
+def main(argv):
+    args = [a for a in argv if not a.startswith("--")]
+    flags = dict(a[2:].split("=", 1) if "=" in a else (a[2:], "")
+                 for a in argv if a.startswith("--"))
+    if len(args) < 3:
+        print(__doc__.strip())
+        return 1
+
+    path, recipe, meshes = args[0], args[1], args[2:]
+    clients = int(flags.get("clients", 4))
+    requests = int(flags.get("requests", 20))
+    payloads = None
+    if "inline" in flags:
+        payloads = {}
+        for mesh in meshes:
+            with open(mesh, "rb") as f:
+                payloads[mesh] = f.read()
+
+    if "fault" in flags:
+        problem = check_fault(path, recipe, meshes[0], payloads)
+        if problem:
+            print("fault: " + problem)
+            return 1
+        print("fault: the throwing job failed alone")
+
+    results = []
+    threads = [threading.Thread(target=client, args=(
+        path, recipe, meshes, payloads, requests, results, i))
+        for i in range(clients)]
+    start = time.perf_counter()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    wall = time.perf_counter() - start
+
+    errors = [r for r in results if not r[2].startswith("OK")]
+    cold = [r[1] for r in results if r[2].startswith("OK miss")]
+    warm = [r[1] for r in results if r[2].startswith("OK hit")]
+    report("cold", cold)
+    report("warm", warm)
+    print("%d requests in %.2f s, %.1f requests/s, %d errors" % (
+        len(results), wall, len(results) / wall if wall > 0 else 0,
+        len(errors)))
+    for mesh, _, status in errors[:5]:
+        print("  %s : %s" % (mesh, status))
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
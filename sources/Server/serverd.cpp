@@ -0,0 +1,80 @@
+#include "supportserver.h"
+
+#include <params.h>
+#include <pipelinestage.h>
+#include <iostream>
+#include <csignal>
+#include <cstdint>
+
+namespace
+{
+	SupportServer* server = 0;
+
+	void OnSignal(int)
+	{
+		if (server)
+			server->Stop();
+	}
+}
+
+void ParseOptions(int argc, char** argv, ServerConfig& config)
+{
+	for (int i = 2; i < argc; i++) {
+		std::string option = argv[i];
+		std::string name, value;
+		SplitOption(option, name, value);
+
+		bool known = true;
+		if (name == "--workers")
+			known = ParseNumber(value, config.workers);
+		else if (name == "--threads")
+			known = ParseNumber(value, config.threads);
+		else if (name == "--cache")
+			known = ParseNumber(value, config.cacheSize);
+		else if (option == "--fault-recipe")
+			config.faultRecipe = true;
+		else if (name == "--max-inline-mb") {
+			size_t megabytes;
+			known = ParseNumber(value, megabytes) && megabytes <= SIZE_MAX >> 20;
+			if (known)
+				config.maxInlineBytes = megabytes << 20;
+		}
+		else
+			known = false;
+
+		if (!known) {
+			std::cerr << "Unknown option : " << option << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::cerr << "usage: serverd <socket> [--workers=n] [--threads=n] "
+			"[--cache=n] [--max-inline-mb=n] [--fault-recipe]" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	ServerConfig config;
+	config.socketPath = argv[1];
+	config.workers = 1;
+	config.threads = 0;
+	config.cacheSize = 8;
+	config.maxInlineBytes = (size_t)256 << 20;
+	config.faultRecipe = false;
+	ParseOptions(argc, argv, config);
+
+	SupportServer supportServer(config);
+	if (!supportServer.Listen())
+		exit(EXIT_FAILURE);
+
+	server = &supportServer;
+	signal(SIGINT, OnSignal);
+	signal(SIGTERM, OnSignal);
+
+	StartPipelineStats();
+	supportServer.Serve();
+	server = 0;
+}
\ No newline at end of file
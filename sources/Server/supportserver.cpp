@@ -0,0 +1,483 @@
+#include "supportserver.h"
+#include "freefloatingapp.h"
+#include "huangapp.h"
+#include "vanekapp.h"
+
+#include <jobcontext.h>
+#include <workerpool.h>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <future>
+#include <chrono>
+#include <thread>
+#include <omp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <stdexcept>
+
+// Buffered reads and writes on a connected socket.
+class Connection
+{
+public:
+	Connection(int fd_) : fd(fd_), begin(0), end(0) {}
+
+	bool ReadLine(std::string& line) {
+		line.clear();
+		while (true) {
+			for (; begin < end; begin++) {
+				char c = buffer[begin];
+				if (c == '\n') {
+					begin++;
+					if (!line.empty() && line.back() == '\r')
+						line.pop_back();
+					return true;
+				}
+				line.push_back(c);
+			}
+			if (!Fill())
+				return false;
+		}
+	}
+
+	bool ReadBytes(std::string& data, size_t size) {
+		data.resize(size);
+		size_t done = 0;
+		while (done < size) {
+			if (begin == end && !Fill())
+				return false;
+			size_t n = std::min(size - done, end - begin);
+			memcpy(&data[done], buffer + begin, n);
+			begin += n;
+			done += n;
+		}
+		return true;
+	}
+
+	// reads size bytes and drops them
+	bool SkipBytes(size_t size) {
+		while (size > 0) {
+			if (begin == end && !Fill())
+				return false;
+			size_t n = std::min(size, end - begin);
+			begin += n;
+			size -= n;
+		}
+		return true;
+	}
+
+	bool Write(const std::string& data) {
+		size_t done = 0;
+		while (done < data.size()) {
+			ssize_t n = send(fd, data.data() + done, data.size() - done,
+				MSG_NOSIGNAL);
+			if (n <= 0)
+				return false;
+			done += n;
+		}
+		return true;
+	}
+
+private:
+	bool Fill() {
+		ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+		if (n <= 0)
+			return false;
+		begin = 0;
+		end = n;
+		return true;
+	}
+
+	int fd;
+	char buffer[1 << 16];
+	size_t begin, end;
+};
+
+namespace
+{
+	// the socket replies are cut into writes of about this size
+	const size_t flushSize = 1 << 16;
+
+	uint64_t HashBytes(const std::string& data)
+	{
+		// FNV-1a
+		uint64_t h = 14695981039346656037ull;
+		for (unsigned char c : data) {
+			h ^= c;
+			h *= 1099511628211ull;
+		}
+		return h;
+	}
+
+	bool RecipeDefaults(const std::string& recipe, Params& params)
+	{
+		if (recipe == "FreeFloating")
+			params = FreeFloatingApp::DefaultParams();
+		else if (recipe == "Huang")
+			params = HuangApp::DefaultParams();
+		else if (recipe == "Vanek")
+			params = VanekApp::DefaultParams();
+		else
+			return false;
+		return true;
+	}
+
+	bool Section(Connection& connection, std::ostringstream& out)
+	{
+		if (out.tellp() < (std::streamoff)flushSize)
+			return true;
+		bool written = connection.Write(out.str());
+		out.str("");
+		return written;
+	}
+
+	bool WritePoints(Connection& connection, std::ostringstream& out,
+		const char* name, const std::vector<glm::vec3>& points, int perLine)
+	{
+		out << name << " " << points.size() / perLine << "\n";
+		for (size_t i = 0; i < points.size(); i += perLine) {
+			for (int k = 0; k < perLine; k++) {
+				const glm::vec3& p = points[i + k];
+				out << (k ? " " : "") << p.x << " " << p.y << " " << p.z;
+			}
+			out << "\n";
+			if (!Section(connection, out))
+				return false;
+		}
+		return true;
+	}
+}
+
+SupportServer::SupportServer(const ServerConfig& config_)
+	: config(config_), listenFd(-1), stopping(false), requests(0), hits(0)
+{
+}
+
+SupportServer::~SupportServer()
+{
+	// the pool goes first, its tasks use the apps
+	pool.reset();
+	workers.clear();
+	setupPool.reset();
+	if (listenFd >= 0) {
+		close(listenFd);
+		unlink(config.socketPath.c_str());
+	}
+}
+
+bool SupportServer::Listen()
+{
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (config.socketPath.size() >= sizeof(address.sun_path)) {
+		std::cerr << "Socket path too long : " << config.socketPath << std::endl;
+		return false;
+	}
+	strcpy(address.sun_path, config.socketPath.c_str());
+
+	listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd < 0) {
+		std::cerr << "Unable to create a socket" << std::endl;
+		return false;
+	}
+	unlink(config.socketPath.c_str());
+	if (bind(listenFd, (sockaddr*)&address, sizeof(address)) != 0 ||
+		listen(listenFd, 64) != 0) {
+		std::cerr << "Unable to listen on " << config.socketPath << " : " <<
+			strerror(errno) << std::endl;
+		return false;
+	}
+
+	// the GLFW fallback can only create windows on the main thread, so the
+	// apps of all workers are set up before the first request
+	int nWorkers = std::max(1, config.workers);
+	if (config.threads <= 0)
+		config.threads = std::max(1, omp_get_max_threads() / nWorkers);
+	setupPool.reset(new WorkerPool(std::max(2, nWorkers)));
+	workers.resize(nWorkers);
+	for (Worker& worker : workers) {
+		worker.freeFloating.reset(new FreeFloatingApp(setupPool.get()));
+		worker.freeFloating->SetCacheSize(config.cacheSize);
+		worker.huang.reset(new HuangApp(setupPool.get()));
+		worker.huang->SetCacheSize(config.cacheSize);
+		worker.vanek.reset(new VanekApp);
+		worker.vanek->SetCacheSize(config.cacheSize);
+
+		Status status = worker.freeFloating->Prepare();
+		if (status.IsOk())
+			status = worker.huang->Prepare();
+		if (!status.IsOk()) {
+			std::cerr << status.Message() << std::endl;
+			return false;
+		}
+	}
+	pool.reset(new WorkerPool(nWorkers));
+	return true;
+}
+
+void SupportServer::Serve()
+{
+	std::cout << "Listening on " << config.socketPath << " with " <<
+		workers.size() << " workers x " << config.threads << " threads" <<
+		std::endl;
+
+	while (!stopping) {
+		int fd = accept(listenFd, 0, 0);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		std::lock_guard<std::mutex> lock(connectionMutex);
+		if (stopping) {
+			close(fd);
+			break;
+		}
+		connections.insert(fd);
+		std::thread(&SupportServer::HandleConnection, this, fd).detach();
+	}
+
+	std::unique_lock<std::mutex> lock(connectionMutex);
+	for (int fd : connections)
+		shutdown(fd, SHUT_RDWR);
+	connectionsClosed.wait(lock, [this] { return connections.empty(); });
+}
+
+void SupportServer::Stop()
+{
+	stopping = true;
+	if (listenFd >= 0)
+		shutdown(listenFd, SHUT_RDWR);
+}
+
+void SupportServer::HandleConnection(int fd)
+{
+	Connection connection(fd);
+	std::string line;
+	while (connection.ReadLine(line)) {
+		std::string command = line.substr(0, line.find(' '));
+		if (command == "QUIT")
+			break;
+		if (command == "SHUTDOWN") {
+			connection.Write("OK\n");
+			Stop();
+			break;
+		}
+		if (command == "STATS") {
+			connection.Write(Stats());
+			continue;
+		}
+		if (command != "RUN") {
+			connection.Write("ERROR unknown command " + command + "\n");
+			continue;
+		}
+
+		// a request that throws, e.g. out of memory, fails alone
+		bool alive;
+		try {
+			alive = HandleRequest(line, connection);
+		}
+		catch (const std::exception& e) {
+			alive = connection.Write(std::string("ERROR ") + e.what() + "\n");
+		}
+		if (!alive)
+			break;
+	}
+
+	close(fd);
+	std::lock_guard<std::mutex> lock(connectionMutex);
+	connections.erase(fd);
+	connectionsClosed.notify_all();
+}
+
+bool SupportServer::HandleRequest(const std::string& line,
+	Connection& connection)
+{
+	Request request;
+	std::string error;
+	bool inStep = true;
+	if (!ParseRequest(line, connection, request, error, inStep))
+		return connection.Write("ERROR " + error + "\n") && inStep;
+
+	std::chrono::steady_clock::time_point start =
+		std::chrono::steady_clock::now();
+	JobResult result;
+	bool cacheHit = false;
+	if (!Execute(request, result, cacheHit, error))
+		return connection.Write("ERROR " + error + "\n");
+	double ms = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+
+	std::ostringstream out;
+	out << std::setprecision(7);
+	out << "OK " << (cacheHit ? "hit" : "miss") << " " << ms << "\n";
+	bool written = true;
+	if (request.recipe == "FreeFloating")
+		written = WritePoints(connection, out, "POINTS",
+			result.supportPoints, 1);
+	else if (request.recipe == "Huang") {
+		out << "LAYERS " << result.anchorMaps.size() << "\n";
+		std::vector<cv::Point> pixels;
+		for (size_t i = 0; i < result.anchorMaps.size() && written; i++) {
+			cv::findNonZero(result.anchorMaps[i], pixels);
+			out << i << " " << pixels.size();
+			for (const cv::Point& p : pixels)
+				out << " " << p.x << " " << p.y;
+			out << "\n";
+			written = Section(connection, out);
+		}
+	}
+	else {
+		written = WritePoints(connection, out, "SAMPLES",
+			result.overhangSamples, 1) &&
+			WritePoints(connection, out, "SEGMENTS",
+				result.supportSegments, 2);
+	}
+	out << "END\n";
+	return written && connection.Write(out.str());
+}
+
+bool SupportServer::ParseRequest(const std::string& line,
+	Connection& connection, Request& request, std::string& error,
+	bool& inStep)
+{
+	std::istringstream stream(line);
+	std::string command, mesh, option;
+	stream >> command >> request.recipe >> std::quoted(mesh);
+	if (mesh.empty()) {
+		error = "expected RUN <recipe> <mesh> [options]";
+		return false;
+	}
+
+	// an inline payload is read before anything else can fail, so the
+	// connection stays in step with the client
+	if (mesh.compare(0, 7, "inline:") == 0) {
+		const char* digits = mesh.c_str() + 7;
+		char* last;
+		errno = 0;
+		unsigned long long size = strtoull(digits, &last, 10);
+		if (*digits < '0' || *digits > '9' || *last != '\0' || errno != 0) {
+			// the payload cannot be skipped without its size
+			error = "bad inline size " + mesh.substr(7);
+			inStep = false;
+			return false;
+		}
+		if (size > config.maxInlineBytes) {
+			if (!connection.SkipBytes(size))
+				error = "truncated mesh";
+			else {
+				std::ostringstream message;
+				message << "inline mesh of " << size << " bytes, at most " <<
+					config.maxInlineBytes << " are accepted";
+				error = message.str();
+			}
+			return false;
+		}
+		if (!connection.ReadBytes(request.data, size)) {
+			error = "truncated mesh";
+			return false;
+		}
+		std::ostringstream key;
+		key << "inline:" << std::hex << HashBytes(request.data) << ":" <<
+			std::dec << size;
+		request.key = key.str();
+	}
+	else {
+		struct stat st;
+		if (stat(mesh.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+			error = "unable to open " + mesh;
+			return false;
+		}
+		// a saved edit changes the size or the time, and with it the key
+		std::ostringstream key;
+		key << "path:" << mesh << ":" << st.st_size << ":" <<
+			st.st_mtim.tv_sec << "." << st.st_mtim.tv_nsec;
+		request.path = mesh;
+		request.key = key.str();
+	}
+
+	if (config.faultRecipe && request.recipe == "Fault")
+		request.params = Params();
+	else if (!RecipeDefaults(request.recipe, request.params)) {
+		error = "unknown recipe " + request.recipe;
+		return false;
+	}
+	while (stream >> option) {
+		if (!ParseOption(option, request.params)) {
+			error = "unknown option " + option;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SupportServer::Execute(const Request& request, JobResult& result,
+	bool& cacheHit, std::string& error)
+{
+	std::promise<Status> done;
+	std::future<Status> finished = done.get_future();
+	int home = std::hash<std::string>()(request.key) % workers.size();
+
+	// the key's warm app and mesh cache live on its home worker, so the
+	// task must not be stolen; what the job throws is handed back to the
+	// connection, a worker thread cannot let it escape
+	pool->SubmitPinned([&](int worker) {
+		try {
+			omp_set_num_threads(config.threads);
+
+			std::function<std::unique_ptr<Model3D>()> load = [&] {
+				if (!request.path.empty())
+					return Model3D::Load(request.path);
+				return Model3D::Parse(request.data.data(), request.data.size());
+			};
+
+			JobContext context(request.params);
+			Worker& apps = workers[worker];
+			Status status;
+			if (request.recipe == "FreeFloating")
+				status = apps.freeFloating->Run(context, request.key, load,
+					&result, &cacheHit);
+			else if (request.recipe == "Huang")
+				status = apps.huang->Run(context, request.key, load, &result,
+					&cacheHit);
+			else if (request.recipe == "Vanek")
+				status = apps.vanek->Run(context, request.key, load, &result,
+					&cacheHit);
+			else
+				throw std::runtime_error("fault recipe");
+			done.set_value(status);
+		}
+		catch (...) {
+			done.set_exception(std::current_exception());
+		}
+		}, home);
+
+	requests++;
+	// rethrows what the job threw, HandleConnection replies with it
+	Status status = finished.get();
+	if (!status.IsOk()) {
+		if (status.GetCode() == Status::IO_ERROR && request.path.empty())
+			error = "unable to read the mesh, only binary STL and PLY are "
+				"accepted inline";
+		else
+			error = status.Message();
+		return false;
+	}
+	if (cacheHit)
+		hits++;
+	return true;
+}
+
+std::string SupportServer::Stats() const
+{
+	std::ostringstream out;
+	out << "OK " << requests << " requests " << hits << " cache hits\n";
+	return out.str();
+}
\ No newline at end of file
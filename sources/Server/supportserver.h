@@ -0,0 +1,105 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <set>
+#include <condition_variable>
+#include <params.h>
+#include <jobresult.h>
+
+class FreeFloatingApp;
+class HuangApp;
+class VanekApp;
+class WorkerPool;
+class Connection;
+
+struct ServerConfig {
+	std::string socketPath;
+	int workers;
+	// OpenMP threads of each worker, zero splits the cores between them
+	int threads;
+	// meshes each app keeps, with their LDNI
+	int cacheSize;
+	// largest inline mesh accepted, in bytes
+	size_t maxInlineBytes;
+	// accept the Fault recipe, whose job throws on its worker, so tests
+	// can check that a failing job fails alone
+	bool faultRecipe;
+};
+
+// Long-running support generation over a Unix domain socket. Every worker
+// of the pool owns warm apps, so a request pays neither for the context
+// nor for the shaders, and the mesh caches of the apps make a repeated
+// mesh with new parameters skip loading and sampling. Requests for the
+// same mesh go to the same worker so they find its cache.
+//
+// The protocol is line based. A request is
+//   RUN <recipe> <path | inline:<bytes>> [recipe options]
+// followed, for inline meshes, by the binary STL or PLY image of at most
+// maxInlineBytes; a larger one is read and dropped. The reply
+// is ERROR <message>, or OK <cache hit|miss> <milliseconds> followed by
+// the sections of the recipe and END:
+//   POINTS <n>, one "x y z" line per support point
+//   LAYERS <n>, one "<layer> <pixels> x y x y ..." line per anchor map
+//   SAMPLES <n> and SEGMENTS <n>, "x y z" and "x y z x y z" lines
+// A job that throws, e.g. out of memory, gets ERROR with the exception's
+// message and the connection stays open. STATS replies with the cache
+// counters, QUIT closes the connection and SHUTDOWN stops the server.
+class SupportServer
+{
+public:
+	SupportServer(const ServerConfig& config_);
+	~SupportServer();
+
+	// binds the socket; false if it cannot
+	bool Listen();
+	// accepts connections until SHUTDOWN or Stop
+	void Serve();
+	// safe to call from a signal handler
+	void Stop();
+
+private:
+	struct Worker {
+		std::unique_ptr<FreeFloatingApp> freeFloating;
+		std::unique_ptr<HuangApp> huang;
+		std::unique_ptr<VanekApp> vanek;
+	};
+
+	struct Request {
+		std::string recipe;
+		Params params;
+		std::string path;
+		// inline mesh image, empty for a path
+		std::string data;
+		std::string key;
+	};
+
+	void HandleConnection(int fd);
+	// false once the connection cannot be kept in step with the client
+	bool HandleRequest(const std::string& line, Connection&);
+	// inStep is cleared if the rest of the request cannot be found
+	bool ParseRequest(const std::string& line, Connection&, Request&,
+		std::string& error, bool& inStep);
+	bool Execute(const Request&, JobResult&, bool& cacheHit, std::string& error);
+	std::string Stats() const;
+
+private:
+	ServerConfig config;
+	int listenFd;
+	std::atomic<bool> stopping;
+
+	// reads the meshes and shaders of the apps of all workers
+	std::unique_ptr<WorkerPool> setupPool;
+	std::vector<Worker> workers;
+	std::unique_ptr<WorkerPool> pool;
+
+	// connection threads are detached; shutting the sockets down ends them
+	std::mutex connectionMutex;
+	std::condition_variable connectionsClosed;
+	std::set<int> connections;
+
+	std::atomic<long long> requests, hits;
+};
@@ -0,0 +1,184 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <limits>
+using glm::vec3;
+
+static const int leafSize = 4;
+// support points lie on the surface, so hits this close to them are ignored
+static const float epsilon = 1e-3f;
+
+BVH::BVH(const MeshData* mesh_)
+	: mesh(mesh_)
+{
+	int nFaces = mesh->FaceCount();
+	faces.resize(nFaces);
+	std::vector<vec3> centroids(nFaces);
+	for (int f = 0; f < nFaces; f++) {
+		faces[f] = f;
+		centroids[f] = (mesh->Position(mesh->indices[f * 3]) +
+			mesh->Position(mesh->indices[f * 3 + 1]) +
+			mesh->Position(mesh->indices[f * 3 + 2])) / 3.0f;
+	}
+
+	nodes.reserve(nFaces > 0 ? 2 * nFaces / leafSize + 1 : 0);
+	if (nFaces > 0)
+		Build(centroids, 0, nFaces);
+}
+
+bool BVH::RayDown(const glm::vec3& origin, float& hitZ) const
+{
+	float t = std::numeric_limits<float>::max();
+	if (!Cast(origin, vec3(0, 0, -1), epsilon, t, false))
+		return false;
+
+	hitZ = origin.z - t;
+	return true;
+}
+
+bool BVH::Intersects(const glm::vec3& a, const glm::vec3& b) const
+{
+	vec3 d = b - a;
+	float len = glm::length(d);
+	if (len <= 2 * epsilon)
+		return false;
+
+	float t = len - epsilon;
+	return Cast(a, d / len, epsilon, t, true);
+}
+
+int BVH::Build(std::vector<glm::vec3>& centroids, int first, int last)
+{
+	int index = nodes.size();
+	nodes.push_back(Node());
+
+	vec3 lo(std::numeric_limits<float>::max());
+	vec3 hi(-std::numeric_limits<float>::max());
+	vec3 cLo = lo, cHi = hi;
+	for (int i = first; i < last; i++) {
+		for (int k = 0; k < 3; k++) {
+			vec3 p = mesh->Position(mesh->indices[faces[i] * 3 + k]);
+			lo = glm::min(lo, p);
+			hi = glm::max(hi, p);
+		}
+		cLo = glm::min(cLo, centroids[faces[i]]);
+		cHi = glm::max(cHi, centroids[faces[i]]);
+	}
+	nodes[index].lo = lo;
+	nodes[index].hi = hi;
+
+	if (last - first <= leafSize) {
+		nodes[index].first = first;
+		nodes[index].count = last - first;
+		return index;
+	}
+
+	vec3 extent = cHi - cLo;
+	int axis = 0;
+	if (extent.y > extent[axis])
+		axis = 1;
+	if (extent.z > extent[axis])
+		axis = 2;
+
+	int mid = (first + last) / 2;
+	std::nth_element(faces.begin() + first, faces.begin() + mid,
+		faces.begin() + last,
+		[&](GLuint a, GLuint b) {
+			return centroids[a][axis] < centroids[b][axis];
+		});
+
+	Build(centroids, first, mid);
+	int right = Build(centroids, mid, last);
+	nodes[index].first = right;
+	nodes[index].count = 0;
+	return index;
+}
+
+bool BVH::Cast(const glm::vec3& o, const glm::vec3& d,
+	float tMin, float& tMax, bool any) const
+{
+	if (nodes.empty())
+		return false;
+
+	vec3 inv;
+	for (int k = 0; k < 3; k++)
+		inv[k] = d[k] != 0.0f ? 1.0f / d[k] : 0.0f;
+
+	bool hit = false;
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+		if (!HitBox(node, o, inv, tMin, tMax))
+			continue;
+
+		if (node.count == 0) {
+			stack[top++] = node.first;
+			stack[top++] = &node - &nodes[0] + 1;
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; i++) {
+			float t;
+			if (HitTriangle(faces[i], o, d, tMin, t) && t < tMax) {
+				tMax = t;
+				hit = true;
+				if (any)
+					return true;
+			}
+		}
+	}
+
+	return hit;
+}
+
+bool BVH::HitBox(const Node& node, const glm::vec3& o,
+	const glm::vec3& inv, float tMin, float tMax) const
+{
+	for (int k = 0; k < 3; k++) {
+		if (inv[k] == 0.0f) {
+			if (o[k] < node.lo[k] || o[k] > node.hi[k])
+				return false;
+			continue;
+		}
+
+		float t0 = (node.lo[k] - o[k]) * inv[k];
+		float t1 = (node.hi[k] - o[k]) * inv[k];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		tMin = std::max(tMin, t0);
+		tMax = std::min(tMax, t1);
+		if (tMin > tMax)
+			return false;
+	}
+	return true;
+}
+
+bool BVH::HitTriangle(GLuint f, const glm::vec3& o, const glm::vec3& d,
+	float tMin, float& t) const
+{
+	// Moller-Trumbore
+	vec3 a = mesh->Position(mesh->indices[f * 3]);
+	vec3 e1 = mesh->Position(mesh->indices[f * 3 + 1]) - a;
+	vec3 e2 = mesh->Position(mesh->indices[f * 3 + 2]) - a;
+
+	vec3 p = glm::cross(d, e2);
+	float det = glm::dot(e1, p);
+	if (std::fabs(det) < 1e-12f)
+		return false;
+
+	float invDet = 1.0f / det;
+	vec3 s = o - a;
+	float u = glm::dot(s, p) * invDet;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+
+	vec3 q = glm::cross(s, e1);
+	float v = glm::dot(d, q) * invDet;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+
+	t = glm::dot(e2, q) * invDet;
+	return t > tMin;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <model3d.h>
+
+// Bounding volume hierarchy over the triangles of an indexed mesh, used
+// for the collision tests of the support tree. The mesh must outlive it.
+class BVH
+{
+private:
+	// interior nodes keep their left child right after themselves and the
+	// right child in first; leaves hold count triangles starting at first
+	struct Node {
+		glm::vec3 lo, hi;
+		int first, count;
+	};
+
+	const MeshData* mesh;
+	std::vector<Node> nodes;
+	std::vector<GLuint> faces;
+
+public:
+	BVH(const MeshData*);
+	~BVH() {}
+
+	// highest surface point straight below origin
+	bool RayDown(const glm::vec3& origin, float& hitZ) const;
+	// whether the segment between a and b, ends excluded, crosses the surface
+	bool Intersects(const glm::vec3& a, const glm::vec3& b) const;
+
+private:
+	int Build(std::vector<glm::vec3>& centroids, int first, int last);
+	bool Cast(const glm::vec3& o, const glm::vec3& d,
+		float tMin, float& tMax, bool any) const;
+	bool HitBox(const Node&, const glm::vec3& o, const glm::vec3& inv,
+		float tMin, float tMax) const;
+	bool HitTriangle(GLuint f, const glm::vec3& o, const glm::vec3& d,
+		float tMin, float& t) const;
+};
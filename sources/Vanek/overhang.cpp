@@ -1,131 +1,185 @@
-#include "overhang.h"
-#include "rasterizer.h"
-
-#include <params.h>
-#include <stopwatch.h>
-using glm::vec3;
-using std::chrono::nanoseconds;
-using std::cout;
-using std::endl;
-
-void OverhangDetector::Run(Model3D* model3D)
-{
-	target = model3D;
-
-	StopWatch::GetInstance().Hit();
-	DetectPointOverhangs();
-	nanoseconds t = StopWatch::GetInstance().Hit();
-	cout << "time for detecting point overhangs : " << t.count() << endl;
-	DetectEdgeOverhangs();
-	t = StopWatch::GetInstance().Hit();
-	cout << "time for detecting edge overhangs : " << t.count() << endl;
-	DetectFaceOverhangs();
-	t = StopWatch::GetInstance().Hit();
-	cout << "time for detecting face overhangs : " << t.count() << endl;
-}
-
-void OverhangDetector::DetectPointOverhangs()
-{
-	OpenMeshData& mesh = target->openMeshData;
-	for (OpenMeshData::VIter vit = mesh.vertices_begin();
-		vit != mesh.vertices_end();
-		vit++) {
-		OpenMeshData::Point p = mesh.point(*vit);
-		bool flag = false;
-		for (OpenMeshData::VVIter vvit = mesh.vv_begin(*vit);
-			vvit != mesh.vv_end(*vit);
-			vvit++) {
-			OpenMeshData::Point neighbor = mesh.point(*vvit);
-			if (p[2] >= neighbor[2])
-				flag = true;
-		}
-		if (!flag)
-			pointOverhang.push_back(vec3(p[0], p[1], p[2]));
-	}
-}
-
-void OverhangDetector::DetectEdgeOverhangs()
-{
-	OpenMeshData& mesh = target->openMeshData;
-
-	Params& params = Params::GetInstance();
-	for (OpenMeshData::HIter hit = mesh.halfedges_begin();
-		hit != mesh.halfedges_end();
-		hit++) {
-		OpenMeshData::Normal n = mesh.normal(*hit);
-		if (IsOverhang(n)) {
-			OpenMeshData::FHandle fh1 = mesh.face_handle(*hit);
-			OpenMeshData::FHandle fh2 = mesh.opposite_face_handle(*hit);
-			if (!fh2.is_valid())
-				continue;
-
-			OpenMeshData::Normal fn1 = mesh.normal(fh1);
-			OpenMeshData::Normal fn2 = mesh.normal(fh2);
-
-			if (IsOverhang(fn1) || IsOverhang(fn2))
-				continue;
-
-			OpenMeshData::VHandle fvh = mesh.from_vertex_handle(*hit);
-			OpenMeshData::VHandle tvh = mesh.to_vertex_handle(*hit);
-			OpenMeshData::Point fp = mesh.point(fvh);
-			OpenMeshData::Point tp = mesh.point(tvh);
-			float len = OpenMesh::norm(tp - fp);
-			float x = 0;
-			glm::vec3 s(fp[0], fp[1], fp[2]);
-			glm::vec3 d(tp[0], tp[1], tp[2]);
-			glm::vec3 dir = (d - s) / len;
-			while (x < len) {
-				glm::vec3 p = s + dir * x;
-				edgeOverhang.push_back(p);
-				x += params.samplingResolution;
-			}
-		}
-	}
-}
-
-void OverhangDetector::DetectFaceOverhangs()
-{
-	OpenMeshData& mesh = target->openMeshData;
-
-	std::vector<GLfloat> points;
-	Params& params = Params::GetInstance();
-
-	for (OpenMeshData::FIter fit = mesh.faces_begin();
-		fit != mesh.faces_end();
-		fit++) {
-		OpenMeshData::Normal n = mesh.normal(*fit);
-		float angle = std::acos(
-			OpenMesh::dot(n, OpenMeshData::Normal(0, 0, -1)));
-		if (angle < params.overhangAngle) {
-			for (OpenMeshData::FVIter fvit = mesh.fv_begin(*fit);
-				fvit != mesh.fv_end(*fit);
-				fvit++) {
-				OpenMeshData::Point p = mesh.point(*fvit);
-				points.push_back(p[0]);
-				points.push_back(p[1]);
-				points.push_back(p[2]);
-			}
-		}
-	}
-
-	Triangles3D triangles;
-	triangles.InitBuffers(points);
-	for (int i = 0; i < points.size(); i += 3) {
-		vec3 pt(points[i], points[i + 1], points[i + 2]);
-		triangles.aabb.Add(pt);
-	}
-
-	Rasterizer rasterizer(&triangles, params.samplingResolution);
-	rasterizer.Sample(faceOverhang);
-}
-
-bool OverhangDetector::IsOverhang(OpenMeshData::Normal n)
-{
-	Params& params = Params::GetInstance();
-	float angle =
-		std::acos(OpenMesh::dot(n, OpenMeshData::Normal(0, 0, -1)));
-	if (angle < params.overhangAngle)
-		return true;
-	else
-		return false;
+#include "overhang.h"
+#include "rasterizer.h"
+#include "trianglesampler.h"
+
+#include <pipelinestage.h>
+#include <metrics.h>
+#include <concatenate.h>
+#include <omp.h>
+using glm::vec3;
+using std::cout;
+using std::endl;
+
+Status OverhangDetector::Run(Model3D* model3D)
+{
+	target = model3D;
+
+	{
+		PIPELINE_STAGE("detect point overhangs");
+		DetectPointOverhangs();
+	}
+	{
+		PIPELINE_STAGE("detect edge overhangs");
+		DetectEdgeOverhangs();
+	}
+	{
+		PIPELINE_STAGE("detect face overhangs");
+		Status status = DetectFaceOverhangs();
+		if (!status.IsOk())
+			return status;
+	}
+	{
+		PIPELINE_STAGE("thin overhang samples");
+		cloud.Build(pointOverhang, edgeOverhang, faceOverhang,
+			context.params.samplingResolution);
+	}
+	Metrics& metrics = Metrics::GetInstance();
+	metrics.GetCounter("point overhang samples").Add(pointOverhang.size());
+	metrics.GetCounter("edge overhang samples").Add(edgeOverhang.size());
+	metrics.GetCounter("face overhang samples").Add(faceOverhang.size());
+	metrics.GetCounter("thinned overhang samples").Add(cloud.GetSamples().size());
+
+	MEMORY_TRACK("overhang samples", sizeof(vec3) *
+		(pointOverhang.size() + edgeOverhang.size() + faceOverhang.size()));
+	MEMORY_TRACK("sample cloud", sizeof(Sample) * cloud.GetSamples().size());
+	cout << "removed overhang samples : " << cloud.RemovedCount() <<
+		" of " << cloud.RemovedCount() + cloud.GetSamples().size() << endl;
+	return Status();
+}
+
+void OverhangDetector::GetSamples(std::vector<glm::vec3>& samples) const
+{
+	cloud.GetPositions(samples);
+}
+
+void OverhangDetector::DetectPointOverhangs()
+{
+	const OpenMeshData& mesh = target->mesh.HalfedgeMesh();
+	long long nVertices = mesh.n_vertices();
+
+	std::vector<std::vector<vec3>> local(omp_get_max_threads());
+#pragma omp parallel
+	{
+		WORKER_ZONE("point overhang worker");
+		std::vector<vec3>& out = local[omp_get_thread_num()];
+#pragma omp for schedule(static)
+		for (long long v = 0; v < nVertices; v++) {
+			OpenMeshData::VHandle vh = mesh.vertex_handle(v);
+			OpenMeshData::Point p = mesh.point(vh);
+			bool flag = false;
+			for (OpenMeshData::ConstVertexVertexIter vvit = mesh.cvv_begin(vh);
+				vvit != mesh.cvv_end(vh);
+				vvit++) {
+				OpenMeshData::Point neighbor = mesh.point(*vvit);
+				if (p[2] >= neighbor[2]) {
+					flag = true;
+					break;
+				}
+			}
+			if (!flag)
+				out.push_back(vec3(p[0], p[1], p[2]));
+		}
+	}
+
+	Concatenate(local, pointOverhang);
+}
+
+void OverhangDetector::DetectEdgeOverhangs()
+{
+	const OpenMeshData& mesh = target->mesh.HalfedgeMesh();
+	long long nEdges = mesh.n_edges();
+
+	float step = context.params.samplingResolution;
+
+	std::vector<std::vector<vec3>> local(omp_get_max_threads());
+#pragma omp parallel
+	{
+		WORKER_ZONE("edge overhang worker");
+		std::vector<vec3>& out = local[omp_get_thread_num()];
+#pragma omp for schedule(static)
+		for (long long e = 0; e < nEdges; e++) {
+			OpenMeshData::EHandle eh = mesh.edge_handle(e);
+			OpenMeshData::HHandle hh = mesh.halfedge_handle(eh, 0);
+			if (!IsOverhang(mesh.normal(hh))) {
+				hh = mesh.halfedge_handle(eh, 1);
+				if (!IsOverhang(mesh.normal(hh)))
+					continue;
+			}
+
+			OpenMeshData::FHandle fh1 = mesh.face_handle(hh);
+			OpenMeshData::FHandle fh2 = mesh.opposite_face_handle(hh);
+			if (!fh1.is_valid() || !fh2.is_valid())
+				continue;
+
+			if (IsOverhang(mesh.normal(fh1)) || IsOverhang(mesh.normal(fh2)))
+				continue;
+
+			OpenMeshData::Point fp = mesh.point(mesh.from_vertex_handle(hh));
+			OpenMeshData::Point tp = mesh.point(mesh.to_vertex_handle(hh));
+			float len = OpenMesh::norm(tp - fp);
+			float x = 0;
+			glm::vec3 s(fp[0], fp[1], fp[2]);
+			glm::vec3 d(tp[0], tp[1], tp[2]);
+			glm::vec3 dir = (d - s) / len;
+			while (x < len) {
+				out.push_back(s + dir * x);
+				x += step;
+			}
+		}
+	}
+
+	Concatenate(local, edgeOverhang);
+}
+
+Status OverhangDetector::DetectFaceOverhangs()
+{
+	MeshData& mesh = target->mesh;
+	const std::vector<GLfloat>& normals = mesh.FaceNormals();
+	long long nFaces = mesh.FaceCount();
+
+	const Params& params = context.params;
+	float cosOverhangAngle = context.cosOverhangAngle;
+
+	std::vector<std::vector<GLfloat>> local(omp_get_max_threads());
+#pragma omp parallel
+	{
+		WORKER_ZONE("face overhang worker");
+		std::vector<GLfloat>& out = local[omp_get_thread_num()];
+#pragma omp for schedule(static)
+		for (long long f = 0; f < nFaces; f++) {
+			if (-normals[f * 3 + 2] <= cosOverhangAngle)
+				continue;
+
+			for (int k = 0; k < 3; k++) {
+				GLuint v = mesh.indices[f * 3 + k];
+				out.insert(out.end(), &mesh.points[v * 3], &mesh.points[v * 3] + 3);
+			}
+		}
+	}
+
+	std::vector<GLfloat> points;
+	Concatenate(local, points);
+
+	if (params.faceSampler == FaceSamplerType::BARYCENTRIC) {
+		TriangleSampler sampler(params.samplingResolution);
+		sampler.Sample(points, faceOverhang);
+		return Status();
+	}
+
+	Triangles3D triangles;
+	triangles.InitBuffers(points);
+	for (int i = 0; i < points.size(); i += 3) {
+		vec3 pt(points[i], points[i + 1], points[i + 2]);
+		triangles.aabb.Add(pt);
+	}
+
+	Rasterizer rasterizer(context, &triangles, params.samplingResolution);
+	rasterizer.Sample(faceOverhang);
+	return rasterizer.GetStatus();
+}
+
+bool OverhangDetector::IsOverhang(OpenMeshData::Normal n)
+{
+	// acos(dot(n, -z)) < overhangAngle, without the acos
+	return -n[2] > context.cosOverhangAngle;
 }
\ No newline at end of file
@@ -1,27 +1,41 @@
-#pragma once
-
-#include <model3d.h>
-#include <glm/glm.hpp>
-
-class OverhangDetector
-{
-public:
-	OverhangDetector() {}
-	~OverhangDetector() {}
-
-	void Run(Model3D*);
-
-private:
-	void DetectPointOverhangs();
-	void DetectEdgeOverhangs();
-	void DetectFaceOverhangs();
-
-	bool IsOverhang(OpenMeshData::Normal);
-
-private:
-	Model3D* target;
-
-	std::vector<glm::vec3> pointOverhang;
-	std::vector<glm::vec3> edgeOverhang;
-	std::vector<glm::vec3> faceOverhang;
-};
+#pragma once
+
+#include <model3d.h>
+#include <jobcontext.h>
+#include <status.h>
+#include <glm/glm.hpp>
+
+#include "samplecloud.h"
+
+class OverhangDetector
+{
+	friend class KernelBench;
+	friend class Validator;
+
+public:
+	OverhangDetector(const JobContext& context_) : context(context_) {}
+	~OverhangDetector() {}
+
+	Status Run(Model3D*);
+	void GetSamples(std::vector<glm::vec3>&) const;
+	const SampleCloud& GetSampleCloud() const {
+		return cloud;
+	}
+
+private:
+	void DetectPointOverhangs();
+	void DetectEdgeOverhangs();
+	Status DetectFaceOverhangs();
+
+	bool IsOverhang(OpenMeshData::Normal);
+
+private:
+	const JobContext& context;
+	Model3D* target;
+
+	std::vector<glm::vec3> pointOverhang;
+	std::vector<glm::vec3> edgeOverhang;
+	std::vector<glm::vec3> faceOverhang;
+
+	SampleCloud cloud;
+};
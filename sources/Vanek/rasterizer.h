@@ -1,55 +1,64 @@
-#pragma once
-
-#include <vector>
-#include <glm/glm.hpp>
-#include <glad/glad.h>
-#include <glslprogram.h>
-#include <aabb.h>
-
-class Triangles3D
-{
-private:
-	GLuint vao;
-	GLuint verticesN;
-
-	std::vector<GLuint> buffers;
-
-public:
-	AABB aabb;
-
-private:
-	void DeleteBuffers();
-
-public:
-	Triangles3D();
-	~Triangles3D();
-
-	void InitBuffers(std::vector<GLfloat>& points);
-
-	void Render();
-};
-
-class Rasterizer
-{
-private:
-	Triangles3D* target;
-
-	GLSLProgram prog;
-	GLuint fboHandle;
-
-	int width, height;
-	glm::mat4 model, view, projection;
-
-	float resolution;
-
-private:
-	void Configure();
-	void SetupFBO();
-
-public:
-	Rasterizer() {}
-	Rasterizer(Triangles3D*, float);
-	~Rasterizer() {}
-
-	void Sample(std::vector<glm::vec3>&);
-};
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+#include <glcontext.h>
+#include <aabb.h>
+#include <jobcontext.h>
+#include <status.h>
+
+class Triangles3D
+{
+private:
+	GLuint vao;
+	GLuint verticesN;
+
+	std::vector<GLuint> buffers;
+
+public:
+	AABB aabb;
+
+private:
+	void DeleteBuffers();
+
+public:
+	Triangles3D();
+	~Triangles3D();
+
+	void InitBuffers(std::vector<GLfloat>& points);
+
+	void Render();
+};
+
+class Rasterizer
+{
+private:
+	Triangles3D* target;
+
+	GLSLProgram* prog;
+	GLuint fboHandle, dsTex;
+
+	int width, height;
+	glm::mat4 model, view, projection;
+
+	float resolution;
+	Status status;
+
+private:
+	Status Configure(const JobContext&);
+	void SetupFBO();
+	void DeleteFBO();
+
+public:
+	Rasterizer() : prog(0), fboHandle(0), dsTex(0) {}
+	Rasterizer(const JobContext&, Triangles3D*, float);
+	~Rasterizer();
+
+	// Sample adds nothing unless this is ok
+	const Status& GetStatus() const {
+		return status;
+	}
+
+	void Sample(std::vector<glm::vec3>&);
+};
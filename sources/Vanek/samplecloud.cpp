@@ -0,0 +1,127 @@
+#include "samplecloud.h"
+
+#include <shardsort.h>
+#include <concatenate.h>
+#include <omp.h>
+using glm::vec3;
+
+namespace
+{
+	const uint32_t EMPTY_SLOT = 0xffffffffu;
+
+	// 21 bits per axis, which is two million cells in every direction
+	inline uint64_t VoxelKey(const vec3& p, float cellSize)
+	{
+		uint64_t key = 0;
+		for (int k = 0; k < 3; k++) {
+			int64_t c = (int64_t)floor(p[k] / cellSize) + (1 << 20);
+			key = (key << 21) | ((uint64_t)c & 0x1fffff);
+		}
+		return key;
+	}
+
+	inline uint64_t HashKey(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return h;
+	}
+}
+
+void SampleCloud::Build(const std::vector<glm::vec3>& points,
+	const std::vector<glm::vec3>& edges,
+	const std::vector<glm::vec3>& faces,
+	float cellSize)
+{
+	std::vector<Sample> all;
+	Gather(points, edges, faces, all);
+
+	size_t nSamples = all.size();
+	std::vector<uint64_t> keys(nSamples);
+#pragma omp parallel for
+	for (long long i = 0; i < (long long)nSamples; i++)
+		keys[i] = VoxelKey(all[i].p, cellSize);
+
+	int nShards = omp_get_max_threads() * 4;
+
+	// bucket the samples by the shard their voxel hashes to, keeping the
+	// input order inside every shard, so each shard is thinned by one
+	// thread without locking
+	std::vector<uint32_t> order;
+	std::vector<size_t> shardBegin;
+	ShardSort(nSamples, nShards, [&keys, nShards](size_t i) {
+		return HashKey(keys[i]) % nShards;
+		}, order, shardBegin);
+
+	std::vector<uint8_t> keep(nSamples, 0);
+#pragma omp parallel for schedule(dynamic)
+	for (int s = 0; s < nShards; s++) {
+		size_t begin = shardBegin[s];
+		size_t end = shardBegin[s + 1];
+
+		size_t capacity = 16;
+		while (capacity < 2 * (end - begin))
+			capacity <<= 1;
+		std::vector<uint32_t> table(capacity, EMPTY_SLOT);
+
+		for (size_t k = begin; k < end; k++) {
+			uint32_t i = order[k];
+			size_t slot = (HashKey(keys[i]) >> 32) & (capacity - 1);
+			while (table[slot] != EMPTY_SLOT && keys[table[slot]] != keys[i])
+				slot = (slot + 1) & (capacity - 1);
+
+			if (table[slot] == EMPTY_SLOT)
+				table[slot] = i;
+			else if (all[i].source < all[table[slot]].source)
+				table[slot] = i;
+		}
+
+		for (size_t slot = 0; slot < capacity; slot++) {
+			if (table[slot] != EMPTY_SLOT)
+				keep[table[slot]] = 1;
+		}
+	}
+
+	std::vector<std::vector<Sample>> local(omp_get_max_threads());
+#pragma omp parallel
+	{
+		std::vector<Sample>& out = local[omp_get_thread_num()];
+#pragma omp for schedule(static)
+		for (long long i = 0; i < (long long)nSamples; i++) {
+			if (keep[i])
+				out.push_back(all[i]);
+		}
+	}
+
+	samples.clear();
+	Concatenate(local, samples);
+	removed = nSamples - samples.size();
+}
+
+void SampleCloud::GetPositions(std::vector<glm::vec3>& positions) const
+{
+	positions.resize(samples.size());
+#pragma omp parallel for
+	for (long long i = 0; i < (long long)samples.size(); i++)
+		positions[i] = samples[i].p;
+}
+
+void SampleCloud::Gather(const std::vector<glm::vec3>& points,
+	const std::vector<glm::vec3>& edges,
+	const std::vector<glm::vec3>& faces,
+	std::vector<Sample>& all)
+{
+	const std::vector<glm::vec3>* sets[3] = { &points, &edges, &faces };
+	const SampleSource sources[3] = {
+		SampleSource::POINT, SampleSource::EDGE, SampleSource::FACE
+	};
+
+	all.reserve(points.size() + edges.size() + faces.size());
+	for (int s = 0; s < 3; s++) {
+		for (const vec3& p : *sets[s])
+			all.push_back({ p, sources[s] });
+	}
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+enum class SampleSource : uint8_t {
+	POINT,
+	EDGE,
+	FACE
+};
+
+struct Sample {
+	glm::vec3 p;
+	SampleSource source;
+};
+
+// Merges the point, edge and face overhang samples into one cloud with at
+// most one sample per cubic voxel. Within a voxel the sample of the most
+// specific source wins, points before edges before faces, and ties go to
+// the sample seen first, so the result does not depend on thread count.
+class SampleCloud
+{
+public:
+	SampleCloud() : removed(0) {}
+	~SampleCloud() {}
+
+	void Build(const std::vector<glm::vec3>& points,
+		const std::vector<glm::vec3>& edges,
+		const std::vector<glm::vec3>& faces,
+		float cellSize);
+
+	const std::vector<Sample>& GetSamples() const {
+		return samples;
+	}
+	void GetPositions(std::vector<glm::vec3>&) const;
+	size_t RemovedCount() const {
+		return removed;
+	}
+
+private:
+	void Gather(const std::vector<glm::vec3>& points,
+		const std::vector<glm::vec3>& edges,
+		const std::vector<glm::vec3>& faces,
+		std::vector<Sample>& all);
+
+private:
+	std::vector<Sample> samples;
+	size_t removed;
+};
@@ -0,0 +1,217 @@
+#include "supporttree.h"
+
+#include <memorystats.h>
+#include <metrics.h>
+#include <algorithm>
+#include <omp.h>
+using glm::vec2;
+using glm::vec3;
+using std::cout;
+using std::endl;
+
+SupportTree::SupportTree(const JobContext& context_, Model3D* model3D)
+	: context(context_), target(model3D), modelContacts(0)
+{
+	Configure();
+}
+
+void SupportTree::Configure()
+{
+	tanAngle = context.tanSupportConeAngle;
+
+	bvh.reset(new BVH(&target->mesh));
+
+	vec3 lo = target->aabb.GetMin();
+	vec3 hi = target->aabb.GetMax();
+	plateZ = lo.z;
+
+	cellSize = context.params.samplingResolution;
+	origin = vec2(lo.x, lo.y);
+	nx = (int)((hi.x - lo.x) / cellSize) + 1;
+	ny = (int)((hi.y - lo.y) / cellSize) + 1;
+	cells.assign((size_t)nx * ny, std::vector<int>());
+}
+
+void SupportTree::Build(const std::vector<glm::vec3>& samples)
+{
+	AddNodes(samples);
+
+	while (!heap.empty()) {
+		int n = heap.top().second;
+		heap.pop();
+		if (!nodes[n].alive)
+			continue;
+		Close(n);
+
+		vec3 merge;
+		int partner = FindPartner(n, merge);
+		if (partner < 0) {
+			vec3 p = nodes[n].p;
+			AddSegment(p, vec3(p.x, p.y, nodes[n].zDown));
+			if (nodes[n].zDown > plateZ)
+				modelContacts++;
+			continue;
+		}
+
+		AddSegment(nodes[n].p, merge);
+		// a partner inside the cone of n is reached directly and stays open
+		if (merge == nodes[partner].p)
+			continue;
+
+		AddSegment(nodes[partner].p, merge);
+		Close(partner);
+		Open(AddNode(merge));
+	}
+
+	MEMORY_TRACK("support tree", nodes.size() * sizeof(Node) +
+		segments.size() * sizeof(Segment));
+	Metrics& metrics = Metrics::GetInstance();
+	metrics.GetCounter("support segments").Add(segments.size());
+	metrics.GetCounter("model contacts").Add(modelContacts);
+	cout << "number of support segments : " << segments.size() << endl;
+	cout << "number of model contacts : " << modelContacts << endl;
+}
+
+void SupportTree::AddNodes(const std::vector<glm::vec3>& samples)
+{
+	nodes.resize(samples.size());
+
+#pragma omp parallel for schedule(dynamic, 256)
+	for (long long i = 0; i < (long long)samples.size(); i++) {
+		Node& node = nodes[i];
+		node.p = samples[i];
+		node.alive = false;
+		if (!bvh->RayDown(node.p, node.zDown))
+			node.zDown = plateZ;
+	}
+
+	for (int i = 0; i < nodes.size(); i++)
+		Open(i);
+}
+
+int SupportTree::AddNode(const glm::vec3& p)
+{
+	Node node;
+	node.p = p;
+	node.alive = false;
+	if (!bvh->RayDown(p, node.zDown))
+		node.zDown = plateZ;
+
+	nodes.push_back(node);
+	return nodes.size() - 1;
+}
+
+void SupportTree::Open(int n)
+{
+	int cx, cy;
+	CellOf(nodes[n].p, cx, cy);
+	cells[CellIndex(cx, cy)].push_back(n);
+	nodes[n].alive = true;
+	heap.push(HeapEntry(nodes[n].p.z, n));
+}
+
+void SupportTree::Close(int n)
+{
+	int cx, cy;
+	CellOf(nodes[n].p, cx, cy);
+	std::vector<int>& cell = cells[CellIndex(cx, cy)];
+	cell.erase(std::find(cell.begin(), cell.end(), n));
+	nodes[n].alive = false;
+}
+
+int SupportTree::CellIndex(int cx, int cy) const
+{
+	return cy * nx + cx;
+}
+
+void SupportTree::CellOf(const glm::vec3& p, int& cx, int& cy) const
+{
+	cx = std::min(nx - 1, std::max(0, (int)((p.x - origin.x) / cellSize)));
+	cy = std::min(ny - 1, std::max(0, (int)((p.y - origin.y) / cellSize)));
+}
+
+int SupportTree::FindPartner(int n, glm::vec3& merge)
+{
+	const Node& p = nodes[n];
+	int cx, cy;
+	CellOf(p.p, cx, cy);
+
+	// n is the highest open node, so a partner at horizontal distance d
+	// can not merge above p.z - d / (2 tan) and the ring search stops once
+	// that bound falls below the best merge found or the way down
+	float best = p.zDown;
+	int partner = -1;
+
+	std::vector<Candidate> candidates;
+	int maxRing = std::max(nx, ny);
+	for (int r = 0; r <= maxRing; r++) {
+		float minDist = std::max(0, r - 1) * cellSize;
+		if (p.p.z - minDist / (2 * tanAngle) <= best)
+			break;
+
+		candidates.clear();
+		for (int y = cy - r; y <= cy + r; y++) {
+			if (y < 0 || y >= ny)
+				continue;
+			// only the border of the square is new in ring r
+			int step = (y == cy - r || y == cy + r) ? 1 : std::max(1, 2 * r);
+			for (int x = cx - r; x <= cx + r; x += step) {
+				if (x < 0 || x >= nx)
+					continue;
+				for (int q : cells[CellIndex(x, y)]) {
+					Candidate candidate;
+					candidate.node = q;
+					candidate.z = MergeHeight(p, nodes[q], candidate.merge);
+					if (candidate.z > best)
+						candidates.push_back(candidate);
+				}
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end(),
+			[](const Candidate& a, const Candidate& b) {
+				return a.z > b.z;
+			});
+
+		for (const Candidate& candidate : candidates) {
+			const vec3& q = nodes[candidate.node].p;
+			const vec3& m = candidate.merge;
+			if (bvh->Intersects(p.p, m))
+				continue;
+			if (m != q && bvh->Intersects(q, m))
+				continue;
+
+			best = candidate.z;
+			partner = candidate.node;
+			merge = m;
+			break;
+		}
+	}
+
+	return partner;
+}
+
+float SupportTree::MergeHeight(const Node& p, const Node& q,
+	glm::vec3& merge) const
+{
+	// the cones of p and q meet at (p.z + q.z - d / tan) / 2, or q lies
+	// inside the cone of p and is joined directly
+	vec2 dir = vec2(q.p.x - p.p.x, q.p.y - p.p.y);
+	float d = glm::length(dir);
+	float zm = std::min(q.p.z, (p.p.z + q.p.z - d / tanAngle) / 2.0f);
+	if (zm == q.p.z) {
+		merge = q.p;
+		return zm;
+	}
+
+	float r = (p.p.z - zm) * tanAngle;
+	vec2 xy = vec2(p.p.x, p.p.y) + dir * (r / d);
+	merge = vec3(xy.x, xy.y, zm);
+	return zm;
+}
+
+void SupportTree::AddSegment(const glm::vec3& a, const glm::vec3& b)
+{
+	if (a != b)
+		segments.push_back({ a, b });
+}
\ No newline at end of file
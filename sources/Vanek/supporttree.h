@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <glm/glm.hpp>
+#include <model3d.h>
+#include <jobcontext.h>
+
+#include "bvh.h"
+
+// Greedy cone-intersection support tree of Clever Support. The highest
+// open point is joined either to the nearest point its cone meets, or
+// straight down to the model or the build plate.
+class SupportTree
+{
+public:
+	struct Segment {
+		glm::vec3 a, b;
+	};
+
+private:
+	struct Node {
+		glm::vec3 p;
+		float zDown;
+		bool alive;
+	};
+	struct Candidate {
+		float z;
+		int node;
+		glm::vec3 merge;
+	};
+	typedef std::pair<float, int> HeapEntry;
+
+	const JobContext& context;
+	Model3D* target;
+	std::unique_ptr<BVH> bvh;
+
+	float tanAngle;
+	float plateZ;
+
+	// uniform XY grid over the open nodes
+	glm::vec2 origin;
+	float cellSize;
+	int nx, ny;
+	std::vector<std::vector<int>> cells;
+
+	std::vector<Node> nodes;
+	std::priority_queue<HeapEntry> heap;
+
+	std::vector<Segment> segments;
+	int modelContacts;
+
+public:
+	SupportTree(const JobContext&, Model3D*);
+	~SupportTree() {}
+
+	void Build(const std::vector<glm::vec3>& samples);
+
+	const std::vector<Segment>& GetSegments() const {
+		return segments;
+	}
+
+private:
+	void Configure();
+	void AddNodes(const std::vector<glm::vec3>& samples);
+	int AddNode(const glm::vec3& p);
+	void Open(int n);
+	void Close(int n);
+
+	int CellIndex(int cx, int cy) const;
+	void CellOf(const glm::vec3& p, int& cx, int& cy) const;
+
+	int FindPartner(int n, glm::vec3& merge);
+	float MergeHeight(const Node& p, const Node& q, glm::vec3& merge) const;
+
+	void AddSegment(const glm::vec3& a, const glm::vec3& b);
+};
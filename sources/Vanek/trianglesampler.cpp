@@ -0,0 +1,91 @@
+#include "trianglesampler.h"
+
+#include <concatenate.h>
+#include <omp.h>
+#include <cmath>
+#include <algorithm>
+using glm::vec2;
+using glm::vec3;
+
+namespace {
+	inline float Cross(vec2 a, vec2 b)
+	{
+		return a.x * b.y - a.y * b.x;
+	}
+
+	inline bool IsTopLeft(vec2 from, vec2 to)
+	{
+		vec2 d = to - from;
+		return d.y > 0 || (d.y == 0 && d.x < 0);
+	}
+
+	inline bool Covers(float w, bool topLeft)
+	{
+		return w > 0 || (w == 0 && topLeft);
+	}
+}
+
+void TriangleSampler::Sample(const std::vector<GLfloat>& triangles,
+	std::vector<glm::vec3>& points)
+{
+	long long nTriangles = triangles.size() / 9;
+
+	std::vector<std::vector<vec3>> local(omp_get_max_threads());
+#pragma omp parallel
+	{
+		std::vector<vec3>& out = local[omp_get_thread_num()];
+#pragma omp for schedule(static)
+		for (long long t = 0; t < nTriangles; t++) {
+			const GLfloat* p = &triangles[t * 9];
+			SampleTriangle(vec3(p[0], p[1], p[2]),
+				vec3(p[3], p[4], p[5]),
+				vec3(p[6], p[7], p[8]), out);
+		}
+	}
+
+	Concatenate(local, points);
+}
+
+void TriangleSampler::SampleTriangle(vec3 a, vec3 b, vec3 c,
+	std::vector<glm::vec3>& points)
+{
+	vec2 pa(a.x, a.y), pb(b.x, b.y), pc(c.x, c.y);
+	float area = Cross(pb - pa, pc - pa);
+	if (area == 0)
+		return;
+	if (area < 0) {
+		std::swap(b, c);
+		std::swap(pb, pc);
+		area = -area;
+	}
+
+	bool topLeftA = IsTopLeft(pb, pc);
+	bool topLeftB = IsTopLeft(pc, pa);
+	bool topLeftC = IsTopLeft(pa, pb);
+
+	float minX = std::min(pa.x, std::min(pb.x, pc.x));
+	float maxX = std::max(pa.x, std::max(pb.x, pc.x));
+	float minY = std::min(pa.y, std::min(pb.y, pc.y));
+	float maxY = std::max(pa.y, std::max(pb.y, pc.y));
+
+	long long firstI = ceil(minX / resolution - 0.5f);
+	long long lastI = floor(maxX / resolution - 0.5f);
+	long long firstJ = ceil(minY / resolution - 0.5f);
+	long long lastJ = floor(maxY / resolution - 0.5f);
+
+	for (long long j = firstJ; j <= lastJ; j++) {
+		float y = (j + 0.5f) * resolution;
+		for (long long i = firstI; i <= lastI; i++) {
+			vec2 p((i + 0.5f) * resolution, y);
+			float wa = Cross(pc - pb, p - pb);
+			float wb = Cross(pa - pc, p - pc);
+			float wc = Cross(pb - pa, p - pa);
+			if (!Covers(wa, topLeftA) || !Covers(wb, topLeftB) ||
+				!Covers(wc, topLeftC))
+				continue;
+
+			float z = (wa * a.z + wb * b.z + wc * c.z) / area;
+			points.push_back(vec3(p.x, p.y, z));
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+// CPU replacement for the depth-peeling Rasterizer: samples every triangle
+// on a regular XY grid and interpolates Z with barycentric coordinates.
+// Grid points sit at (i + 0.5, j + 0.5) * resolution in model space, and
+// a point on an edge shared by two triangles is taken by only one of them.
+class TriangleSampler
+{
+public:
+	TriangleSampler(float resolution_) : resolution(resolution_) {}
+	~TriangleSampler() {}
+
+	void Sample(const std::vector<GLfloat>& triangles,
+		std::vector<glm::vec3>& points);
+
+private:
+	void SampleTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c,
+		std::vector<glm::vec3>& points);
+
+	float resolution;
+};
@@ -1,65 +1,130 @@
-#include "vanekapp.h"
-#include "overhang.h"
-
-#include <params.h>
-#include <stopwatch.h>
-
-std::unique_ptr<VanekApp> VanekApp::instance;
-std::once_flag VanekApp::flag;
-
-VanekApp& VanekApp::GetInstance()
-{
-	std::call_once(flag, [] {instance.reset(new VanekApp); });
-	return *instance;
-}
-
-void VanekApp::Run(std::string path)
-{
-	model3D = Model3D::Load(path);
-	StopWatch::GetInstance().Start();
-	BuildSupportStructure();
-}
-
-VanekApp::VanekApp()
-{
-	SetParameters();
-
-	if (!glfwInit())
-		exit(EXIT_FAILURE);
-
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
-
-	offscreen = glfwCreateWindow(100, 100, "Vanek App", 0, 0);
-	if (!offscreen) {
-		glfwTerminate();
-		exit(EXIT_FAILURE);
-	}
-	glfwMakeContextCurrent(offscreen);
-
-	if (!gladLoadGL()) {
-		glfwTerminate();
-		exit(EXIT_FAILURE);
-	}
-}
-
-void VanekApp::SetParameters()
-{
-	Params& params = Params::GetInstance();
-
-	params.sliceThickness = 0.1f;
-	params.dpi = 600;
-	params.pixelWidth = 25.4 / params.dpi;
-	params.maxFBOSize = 4000;
-
-	params.samplingResolution = 5.0f;
-	params.overhangAngle = 45 * 3.141592 / 180.0;
-}
-
-void VanekApp::BuildSupportStructure()
-{
-	OverhangDetector detector;
-	detector.Run(model3D.get());
+#include "vanekapp.h"
+#include "overhang.h"
+#include "supporttree.h"
+
+#include <pipelinestage.h>
+
+VanekApp::VanekApp()
+	: gl("Vanek App")
+{
+}
+
+VanekApp::~VanekApp()
+{
+	// the cached meshes own buffers of this context
+	ContextScope current(gl);
+	cache.Clear();
+}
+
+void VanekApp::SetCacheSize(size_t entries)
+{
+	ContextScope current(gl);
+	cache.SetCapacity(entries);
+}
+
+Params VanekApp::DefaultParams()
+{
+	Params params;
+
+	params.sliceThickness = 0.1f;
+	params.dpi = 600;
+	params.pixelWidth = 25.4 / params.dpi;
+	params.maxFBOSize = 4000;
+
+	params.samplingResolution = 5.0f;
+	params.overhangAngle = 45 * 3.141592 / 180.0;
+	params.faceSampler = FaceSamplerType::BARYCENTRIC;
+	params.supportConeAngle = 45 * 3.141592 / 180.0;
+
+	return params;
+}
+
+Status VanekApp::Run(const JobContext& context, std::string path,
+	JobResult* result)
+{
+	ContextScope current(gl);
+
+	std::unique_ptr<Model3D> model3D;
+	{
+		PIPELINE_STAGE("load mesh");
+		model3D = Model3D::Load(path);
+		if (!model3D)
+			return Status(Status::IO_ERROR, "Unable to read " + path);
+		model3D->mesh.HalfedgeMesh();
+	}
+
+	PIPELINE_STAGE("build support structure");
+	return BuildSupportStructure(context, model3D.get(), result);
+}
+
+Status VanekApp::Run(const JobContext& context, std::unique_ptr<Model3D> model3D_,
+	JobResult* result)
+{
+	ContextScope current(gl);
+
+	std::unique_ptr<Model3D> model3D = std::move(model3D_);
+	{
+		PIPELINE_STAGE("build halfedge mesh");
+		model3D->mesh.HalfedgeMesh();
+	}
+
+	PIPELINE_STAGE("build support structure");
+	return BuildSupportStructure(context, model3D.get(), result);
+}
+
+Status VanekApp::Run(const JobContext& context, const std::string& key,
+	std::function<std::unique_ptr<Model3D>()> load, JobResult* result,
+	bool* cacheHit)
+{
+	ContextScope current(gl);
+
+	std::unique_ptr<Model3D>* entry = cache.Find(key);
+	if (cacheHit)
+		*cacheHit = entry != 0;
+	if (!entry) {
+		std::unique_ptr<Model3D> model3D;
+		{
+			PIPELINE_STAGE("load mesh");
+			model3D = load();
+			if (!model3D)
+				return Status(Status::IO_ERROR, "Unable to read " + key);
+			model3D->mesh.HalfedgeMesh();
+		}
+		entry = &cache.Insert(key, std::move(model3D));
+	}
+
+	Status status;
+	{
+		PIPELINE_STAGE("build support structure");
+		status = BuildSupportStructure(context, entry->get(), result);
+	}
+
+	if (cache.Capacity() == 0)
+		cache.Clear();
+	return status;
+}
+
+Status VanekApp::BuildSupportStructure(const JobContext& context,
+	Model3D* model3D, JobResult* result)
+{
+	OverhangDetector detector(context);
+	Status status = detector.Run(model3D);
+	if (!status.IsOk())
+		return status;
+
+	std::vector<glm::vec3> samples;
+	detector.GetSamples(samples);
+
+	PIPELINE_STAGE("build support tree");
+	SupportTree tree(context, model3D);
+	tree.Build(samples);
+
+	if (result) {
+		result->overhangSamples = std::move(samples);
+		for (const SupportTree::Segment& segment : tree.GetSegments()) {
+			result->supportSegments.push_back(segment.a);
+			result->supportSegments.push_back(segment.b);
+		}
+	}
+	return status;
 }
\ No newline at end of file
@@ -1,28 +1,41 @@
-#pragma once
-
-#include <model3d.h>
-#include <GLFW/glfw3.h>
-
-class VanekApp
-{
-public:
-	~VanekApp() {}
-
-	static VanekApp& GetInstance();
-
-	void Run(std::string);
-
-private:
-	VanekApp();
-
-	void SetParameters();
-	void BuildSupportStructure();
-
-private:
-	static std::unique_ptr<VanekApp> instance;
-	static std::once_flag flag;
-
-	GLFWwindow* offscreen;
-
-	std::unique_ptr<Model3D> model3D;
-};
+#pragma once
+
+#include <memory>
+#include <functional>
+#include <glcontext.h>
+#include <status.h>
+#include <jobcontext.h>
+#include <jobresult.h>
+#include <meshcache.h>
+#include <model3d.h>
+
+class VanekApp
+{
+public:
+	VanekApp();
+	~VanekApp();
+
+	// recipe defaults, adjusted by the caller before the job starts
+	static Params DefaultParams();
+
+	Status Run(const JobContext&, std::string, JobResult* = 0);
+	// runs on a mesh that is already in memory, e.g. a generated one
+	Status Run(const JobContext&, std::unique_ptr<Model3D>, JobResult* = 0);
+	// Runs on the mesh cached under key and calls load only on a miss; a
+	// hit skips loading and the halfedge mesh. Fails with IO_ERROR if load
+	// gave no mesh.
+	Status Run(const JobContext&, const std::string& key,
+		std::function<std::unique_ptr<Model3D>()> load,
+		JobResult* = 0, bool* cacheHit = 0);
+
+	// meshes kept for the keyed Run
+	void SetCacheSize(size_t entries);
+
+	// the recipe itself, on whatever GL context is current; the barycentric
+	// face sampler needs no context at all
+	static Status BuildSupportStructure(const JobContext&, Model3D*, JobResult*);
+
+private:
+	GLContext gl;
+	MeshCache<std::unique_ptr<Model3D>> cache;
+};
@@ -1,5 +1,5 @@
-#version 430
-
-void main() 
-{
-}
+#version 430
+
+void main() 
+{
+}
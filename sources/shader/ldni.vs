@@ -1,10 +1,10 @@
-#version 430
-
-layout (location = 0) in vec3 VertexPosition;
-
-uniform mat4 MVP;
-
-void main()
-{
-    gl_Position = MVP * vec4(VertexPosition,1.0);
-}
+#version 430
+
+layout (location = 0) in vec3 VertexPosition;
+
+uniform mat4 MVP;
+
+void main()
+{
+    gl_Position = MVP * vec4(VertexPosition,1.0);
+}
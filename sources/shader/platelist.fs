@@ -0,0 +1,36 @@
+#version 430
+
+struct NodeType {
+  float depth;
+  uint next;
+};
+
+layout( binding = 0, r32ui) uniform uimage2D headPointers;
+layout( binding = 0, offset = 0) uniform atomic_uint nextNodeCounter;
+layout( binding = 0, std430 ) buffer linkedLists {
+  NodeType nodes[];
+};
+// the part of each node, in its own buffer so that the lists of single
+// meshes keep their layout
+layout( binding = 1, std430 ) buffer partLists {
+  uint parts[];
+};
+uniform uint MaxNodes;
+uniform uint PartID;
+
+void CollectFragments()
+{
+  uint nodeIdx = atomicCounterIncrement(nextNodeCounter);
+
+  if( nodeIdx < MaxNodes ) {
+    uint prevHead = imageAtomicExchange(headPointers, ivec2(gl_FragCoord.xy), nodeIdx);
+
+    nodes[nodeIdx].depth = gl_FragCoord.z;
+    nodes[nodeIdx].next = prevHead;
+    parts[nodeIdx] = PartID;
+  }
+}
+
+void main() {
+  CollectFragments();
+}